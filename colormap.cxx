@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2014 Can Erkin Acar
+ * Copyright (C) 2014 Zeynep Akalin Acar
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include <GL/gl.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <math.h>
+#include <map>
+#include <vector>
+#include "colormap.h"
+
+#define FLIP_SUFFIX	"-flip"
+
+static map<string, ColorMap *> s_maps;
+
+//---------------------------------------------------------------------------
+ColorMap::ColorMap(const string &name) : m_name(name), m_refs(0),
+	m_kept(false)
+{
+}
+//---------------------------------------------------------------------------
+void
+ColorMap::unref(void)
+{
+	assert(m_refs > 0);
+	if (--m_refs > 0)
+		return;
+
+	map<string, ColorMap *>::iterator it = s_maps.find(m_name);
+	if (it != s_maps.end() && it->second == this)
+		s_maps.erase(it);
+	delete this;
+}
+//---------------------------------------------------------------------------
+// fills the RGBA8 copy of the table once the colors are set
+void
+ColorMap::finish(void)
+{
+	for (int n = 0; n < CMAP_SIZE; n++) {
+		m_color[n].A() = 1;
+		for (int k = 0; k < 4; k++) {
+			GLfloat c = m_color[n].color[k];
+			c = (c > 0) ? c : 0;
+			c = (c < 1) ? c : 1;
+			m_rgba8[4 * n + k] = (GLubyte) (c * 255 + 0.5f);
+		}
+	}
+}
+//---------------------------------------------------------------------------
+// adds the map to the registry, replacing any map of the same name. A
+// kept map holds a reference for the registry.
+void
+ColorMap::enter(bool keep)
+{
+	map<string, ColorMap *>::iterator it = s_maps.find(m_name);
+	if (it != s_maps.end()) {
+		ColorMap *old = it->second;
+		s_maps.erase(it);
+		if (old->m_kept)
+			old->unref();
+	}
+
+	s_maps[m_name] = this;
+	m_kept = keep;
+	if (keep)
+		ref();
+}
+//---------------------------------------------------------------------------
+ColorMap *
+ColorMap::makeDefault(void)
+{
+	ColorMap *cm = new ColorMap("default");
+
+	double val, r, g, b;
+	for (int n=0; n<CMAP_SIZE; n++) {
+		val=(double)n /(CMAP_SIZE-1);
+		r=b=0;
+		if (val<0.5) b=1-(2*val);
+		if (val>0.5) r=(2*val)-1;
+
+		g = 0.5 * (1 - (b+r));
+
+		if (b < g)
+			b = g;
+		if (r < g)
+			r = g;
+
+		cm->m_color[n]=GColor(r,g,b);
+	}
+	cm->finish();
+	cm->enter(true);
+	return cm;
+}
+//---------------------------------------------------------------------------
+ColorMap *
+ColorMap::makeGray(const string &name, int nq)
+{
+	ColorMap *cm = new ColorMap(name);
+
+	if (nq < 2)
+		nq = CMAP_SIZE;
+	double inc = 1 / (double)(nq - 1);
+	double val = 0;
+
+	int num = 0;
+
+	for (int n=0; n<CMAP_SIZE; n++) {
+		num += nq;
+		if (num >= CMAP_SIZE) {
+			val += inc;
+			num -= CMAP_SIZE;
+		}
+		if (val > 1)	// the last entry steps past the top
+			val = 1;
+		cm->m_color[n]=GColor(val,val,val);
+	}
+	cm->finish();
+	cm->enter(false);
+	return cm;
+}
+//---------------------------------------------------------------------------
+ColorMap *
+ColorMap::makeFlip(const string &name, const ColorMap &src)
+{
+	ColorMap *cm = new ColorMap(name);
+
+	for (int n = 0; n < CMAP_SIZE; n++)
+		cm->m_color[n] = src.m_color[CMAP_SIZE - 1 - n];
+	cm->finish();
+	cm->enter(false);
+	return cm;
+}
+//---------------------------------------------------------------------------
+static bool
+isFlip(const string &name)
+{
+	size_t ns = strlen(FLIP_SUFFIX);
+	return name.size() > ns &&
+		name.compare(name.size() - ns, ns, FLIP_SUFFIX) == 0;
+}
+//---------------------------------------------------------------------------
+string
+ColorMap::flipName(const char *name)
+{
+	string nm(name);
+	if (isFlip(nm))
+		nm.erase(nm.size() - strlen(FLIP_SUFFIX));
+	else
+		nm += FLIP_SUFFIX;
+	return nm;
+}
+//---------------------------------------------------------------------------
+ColorMap *
+ColorMap::get(const char *name)
+{
+	if (name == NULL)
+		return NULL;
+
+	string nm(name);
+	ColorMap *cm = NULL;
+
+	map<string, ColorMap *>::iterator it = s_maps.find(nm);
+	if (it != s_maps.end()) {
+		cm = it->second;
+	} else if (nm == "default") {
+		cm = makeDefault();
+	} else if (isFlip(nm)) {
+		ColorMap *src = get(flipName(name).c_str());
+		if (src) {
+			cm = makeFlip(nm, *src);
+			src->unref();
+		}
+	} else if (nm.compare(0, 4, "gray") == 0) {
+		const char *s = name + 4;
+		char *end;
+		long nq = strtol(s, &end, 10);
+		if (*s == 0)
+			cm = makeGray(nm, 0);
+		else if (*end == 0 && nq >= 2 && nq <= CMAP_SIZE)
+			cm = makeGray(nm, nq);
+	}
+
+	if (cm)
+		cm->ref();
+	return cm;
+}
+//---------------------------------------------------------------------------
+int
+ColorMap::load(const char *fn, const char *name)
+{
+	if (fn == NULL || name == NULL || *name == 0)
+		return 1;
+
+	FILE *f = fopen(fn, "r");
+	if (f == NULL) {
+		printf("Failed to open %s\n", fn);
+		return 1;
+	}
+
+	vector<GColor> ent;
+	double vmax = 0;
+	char buf[256];
+	while (fgets(buf, sizeof(buf), f)) {
+		double r, g, b;
+		if (buf[0] == '#')
+			continue;
+		if (sscanf(buf, "%lg %lg %lg", &r, &g, &b) != 3)
+			continue;
+		if (r < 0 || g < 0 || b < 0) {
+			printf("Negative color in %s\n", fn);
+			fclose(f);
+			return 1;
+		}
+		if (r > vmax) vmax = r;
+		if (g > vmax) vmax = g;
+		if (b > vmax) vmax = b;
+		ent.push_back(GColor(r, g, b));
+	}
+	fclose(f);
+
+	int ne = ent.size();
+	if (ne < 1) {
+		printf("No colors in %s\n", fn);
+		return 1;
+	}
+	double scale = (vmax > 1) ? 1 / 255.0 : 1;
+
+	// linear between the entries, the first and last at the ends
+	ColorMap *cm = new ColorMap(name);
+	for (int n = 0; n < CMAP_SIZE; n++) {
+		double x = (double) n * (ne - 1) / (CMAP_SIZE - 1);
+		int i = (int) floor(x);
+		if (i >= ne - 1)
+			i = (ne > 1) ? ne - 2 : 0;
+		int j = (ne > 1) ? i + 1 : i;
+		double t = x - i;
+		for (int k = 0; k < 3; k++)
+			cm->m_color[n].color[k] = scale *
+				((1 - t) * ent[i].color[k] +
+				 t * ent[j].color[k]);
+	}
+	cm->finish();
+	cm->enter(true);
+
+	printf("Colormap %s: %d colors\n", name, ne);
+	return 0;
+}
+//---------------------------------------------------------------------------
+void
+ColorMap::list(FILE *f)
+{
+	map<string, ColorMap *>::iterator it;
+	for (it = s_maps.begin(); it != s_maps.end(); ++it) {
+		ColorMap *cm = it->second;
+		fprintf(f, "%s: %d users\n", cm->getName(),
+			cm->m_refs - (cm->m_kept ? 1 : 0));
+	}
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2014 Can Erkin Acar
+ * Copyright (C) 2014 Zeynep Akalin Acar
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef _COLORMAP_H_
+#define _COLORMAP_H_
+
+#include <stdio.h>
+#include <string>
+
+using namespace std;
+
+#define CMAP_SIZE       16384
+
+struct GColor {
+	GColor(){}
+	GColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a = 1)
+        {color[0] = r; color[1] = g; color[2] = b; color[3] = a;}
+
+	inline GLfloat &R() {return color[0];}
+	inline GLfloat &G() {return color[1];}
+	inline GLfloat &B() {return color[2];}
+	inline GLfloat &A() {return color[3];}
+	inline void assign(GLfloat r, GLfloat g, GLfloat b, GLfloat a = 1)
+        { color[0]=r; color[1]=g; color[2]=b; color[3] = a; }
+	GLfloat color[4];
+};
+
+// A colormap table, shared by all the meshes showing it and never
+// changed once built. The colors are opaque, the renderer applies its
+// own alpha. Maps are found by name in a registry:
+//   default	blue to gray to red
+//   gray<n>	gray in n levels, "gray" for no quantization
+//   <name>-flip	any map reversed
+// or loaded from files under a new name. Built in and loaded maps stay
+// in the registry, the others are dropped with their last reference.
+class ColorMap {
+public:
+	// the map with a reference held, NULL if there is no such map
+	static ColorMap *get(const char *name);
+	// reads a text file of "r g b" lines (0 to 1, or 0 to 255), spread
+	// evenly over the map, and registers it. Returns 0 on success.
+	static int load(const char *fn, const char *name);
+	static void list(FILE *f);
+	// the name of the map reversed
+	static string flipName(const char *name);
+
+	inline void ref(void) {
+		m_refs++;
+	}
+	void unref(void);
+
+	inline const char *getName(void) const {
+		return m_name.c_str();
+	}
+	inline const GColor &getColor(int idx) const {
+		return m_color[idx];
+	}
+	// the map as RGBA8, 4 * CMAP_SIZE bytes
+	inline const GLubyte *getRGBA8(void) const {
+		return m_rgba8;
+	}
+
+private:
+	ColorMap(const string &name);
+	~ColorMap(void) {};
+	void finish(void);
+	void enter(bool keep);
+
+	static ColorMap *makeDefault(void);
+	static ColorMap *makeGray(const string &name, int nq);
+	static ColorMap *makeFlip(const string &name, const ColorMap &src);
+
+	GColor m_color[CMAP_SIZE];
+	GLubyte m_rgba8[4 * CMAP_SIZE];
+	string m_name;
+	int m_refs;
+	bool m_kept;		// referenced by the registry
+};
+
+#endif
@@ -53,13 +53,30 @@ int cmd_split(char *, int);
 int cmd_nfield (char *, int);
 int cmd_nfield_auto (char *, int);
 int cmd_nfield_load (char *, int);
+int cmd_nfield_transfer (char *, int);
+int cmd_nfield_smooth (char *, int);
 int cmd_nfield_background (char *, int);
 int cmd_nfield_background_load (char *, int);
 int cmd_nfield_background_alpha (char *, int);
 int cmd_nfield_range (char *, int);
+int cmd_nfield_colormap (char *, int);
+int cmd_colormap_use (char *, int);
+int cmd_colormap_flip (char *, int);
+int cmd_colormap_load (char *, int);
+int cmd_colormap_list (char *, int);
 int cmd_info (char *, int);
 int cmd_mark (char *, int);
 int cmd_fix(char *, int);
+int cmd_inside(char *, int);
+int cmd_snapshot(char *, int);
+int cmd_deviation(char *, int);
+int cmd_decimate(char *, int);
+int cmd_remesh(char *, int);
+int cmd_subdivide(char *, int);
+int cmd_quality(char *, int);
+int cmd_curvature(char *, int);
+int cmd_geodesic(char *, int);
+int cmd_dipoles(char *, int);
 
 int cmd_var_done = 0;
 int cmd_var_echo = 1;
@@ -98,6 +115,16 @@ struct comdef root[] = {{"show", cmd_show, 0},
 			{"info", cmd_info, 0},
 			{"mark", cmd_mark, 0},
 			{"unmark", cmd_mark, 1},
+			{"inside", cmd_inside, 0},
+			{"snapshot", cmd_snapshot, 0},
+			{"deviation", cmd_deviation, 0},
+			{"decimate", cmd_decimate, 0},
+			{"remesh", cmd_remesh, 0},
+			{"subdivide", cmd_subdivide, 0},
+			{"quality", cmd_quality, 0},
+			{"curvature", cmd_curvature, 0},
+			{"geodesic", cmd_geodesic, 0},
+			{"dipoles", cmd_dipoles, 0},
 			{0,0,0}};
 
 ShowMeshWindow *cmd_window = NULL;
@@ -299,18 +326,19 @@ cmd_show_mesh(char *arg, int sel)
         return 0;
 }
 
+// sets or clears a display flag on <mesh|all>
 int
-cmd_show_bound(char *arg, int sel)
+cmd_mesh_flag(char *arg, unsigned flag, int on)
 {
 	int nm = cmd_window->numMeshes();
 
 	skip_ws(&arg);
 	if (strncasecmp(arg, "all", 3) == 0) {
                 for (int n=0; n<nm; n++) {
-			if (sel)
-				cmd_window->clearFlag(n, MRF_BOUND);
+			if (on)
+				cmd_window->setFlag(n, flag);
 			else
-				cmd_window->setFlag(n, MRF_BOUND);
+				cmd_window->clearFlag(n, flag);
                 }
                 return 0;
         }
@@ -319,23 +347,50 @@ cmd_show_bound(char *arg, int sel)
                 printf ("invalid mesh number %d\n", n);
                 return 1;
         }
-	if (sel)
-		cmd_window->clearFlag(n, MRF_BOUND);
+	if (on)
+		cmd_window->setFlag(n, flag);
 	else
-		cmd_window->setFlag(n, MRF_BOUND);
+		cmd_window->clearFlag(n, flag);
 
         return 0;
 }
 
+int
+cmd_show_bound(char *arg, int sel)
+{
+	return cmd_mesh_flag(arg, MRF_BOUND, sel);
+}
+
+int
+cmd_show_nonmanifold(char *arg, int sel)
+{
+	return cmd_mesh_flag(arg, MRF_EDGE_NONMAN, sel);
+}
+
+int
+cmd_show_section(char *arg, int sel)
+{
+	return cmd_mesh_flag(arg, MRF_SECTION, sel);
+}
+
+int
+cmd_hide_sharp(char *arg, int sel)
+{
+	return cmd_mesh_flag(arg, MRF_EDGE_SHARP, 0);
+}
+
 int
 cmd_proc_sharp(char *arg, int sel)
 {
 	int nm = cmd_window->numMeshes();
+	double kfactor = 0;
 
+	// optional curvature factor for the sharp edge threshold
 	skip_ws(&arg);
 	if (strncasecmp(arg, "all", 3) == 0) {
+		sscanf(arg + 3, "%lg", &kfactor);
                 for (int n=0; n<nm; n++)
-			cmd_window->process_sharp_edges(n, sel);
+			cmd_window->process_sharp_edges(n, sel, kfactor);
                 return 0;
         }
 
@@ -344,8 +399,9 @@ cmd_proc_sharp(char *arg, int sel)
                 printf ("invalid mesh number %d\n", n);
                 return 1;
         }
+	sscanf(arg, "%*d %lg", &kfactor);
 
-	cmd_window->process_sharp_edges(n, sel);
+	cmd_window->process_sharp_edges(n, sel, kfactor);
 
         return 0;
 }
@@ -375,6 +431,8 @@ cmd_proc_intersect(char *arg, int sel)
 
 struct comdef cd_show[]={{"mesh", cmd_show_mesh, 1},
                          {"bound", cmd_show_bound, 1},
+                         {"nonmanifold", cmd_show_nonmanifold, 1},
+                         {"section", cmd_show_section, 1},
                          {"intersect", cmd_proc_intersect, 0},
                          {"sharp", cmd_proc_sharp, 0},
 			 {0,0,0}};
@@ -401,6 +459,9 @@ cmd_fix (char *arg, int sel)
 
 struct comdef cd_hide[]={{"mesh", cmd_show_mesh, 0},
                          {"bound", cmd_show_bound, 0},
+                         {"nonmanifold", cmd_show_nonmanifold, 0},
+                         {"section", cmd_show_section, 0},
+                         {"sharp", cmd_hide_sharp, 0},
 			 {0,0,0}};
 int
 cmd_hide (char *arg, int sel)
@@ -668,6 +729,26 @@ cmd_set_dscale (char *arg, int sel)
 	return 0;
 }
 
+// point field drawing: glyphs, points or by the number of points
+int
+cmd_set_pstyle (char *arg, int sel)
+{
+	assert (arg);
+	skip_ws(&arg);
+	strip_ws(arg);
+
+	if (strcasecmp(arg, "auto") == 0)
+		ui->showmesh_window->setPStyle(GS_AUTO);
+	else if (strcasecmp(arg, "glyph") == 0)
+		ui->showmesh_window->setPStyle(GS_GLYPH);
+	else if (strcasecmp(arg, "points") == 0)
+		ui->showmesh_window->setPStyle(GS_POINTS);
+	else
+		return 1;
+
+	return 0;
+}
+
 struct comdef cd_set[]={{"view", cmd_set_op3, 0},
 			{"eye", cmd_set_op3, 1},
 			{"move", cmd_set_op3, 2},
@@ -679,6 +760,7 @@ struct comdef cd_set[]={{"view", cmd_set_op3, 0},
 			{"protate", cmd_set_op3, 4},
 			{"pshift", cmd_set_op3, 5},
 			{"pscale", cmd_set_op3, 6},
+			{"pstyle", cmd_set_pstyle, 0},
 			{"dcolor", cmd_set_dcolor, 7},
 			{"dscale", cmd_set_dscale, 7},
 			{"light", cmd_set_bool, 0},
@@ -812,13 +894,98 @@ cmd_mark(char *arg, int sel)
 	return command(arg, sel ? cd_unmark : cd_mark);
 }
 
+// inside command
+
+int
+cmd_inside_check(char *arg, int sel)
+{
+	if (cmd_window->check_inside(sel)) {
+		printf("Error!\n");
+		return 1;
+	}
+	printf ("Done.\n");
+	return 0;
+}
+
+struct comdef cd_inside[]={{"dipoles", cmd_inside_check, 1},
+			   {"points", cmd_inside_check, 0},
+			   {0,0,0}};
+int
+cmd_inside(char *arg, int sel)
+{
+	return command(arg, cd_inside);
+}
+
+// dipoles command: a dipole set from a file
+
+int
+cmd_dipoles_load (char *arg, int sel)
+{
+	assert (arg);
+	skip_ws(&arg);
+	strip_ws(arg);
+
+	if (cmd_window->loadDipoleSet(arg)) {
+		printf("Error!\n");
+		return 1;
+	}
+	return 0;
+}
+
+int
+cmd_dipoles_op (char *arg, int sel)
+{
+	assert (arg);
+	double a;
+
+	switch (sel) {
+	case 0:
+		cmd_window->clearDipoleSet();
+		break;
+	case 1:
+		if (sscanf(arg, "%lg", &a) != 1 || floor(a) != a)
+			return 1;
+		return cmd_window->setDipoleFrame((int) a);
+	case 2:
+		if (sscanf(arg, "%lg", &a) != 1)
+			return 1;
+		cmd_window->setDipoleSetScale(a);
+		break;
+	case 3:
+		cmd_window->playDipoleSet(true);
+		break;
+	case 4:
+		cmd_window->playDipoleSet(false);
+		break;
+	default:
+		return 1;
+	}
+	return 0;
+}
+
+struct comdef cd_dipoles[]={{"load", cmd_dipoles_load, 0},
+			    {"clear", cmd_dipoles_op, 0},
+			    {"frame", cmd_dipoles_op, 1},
+			    {"scale", cmd_dipoles_op, 2},
+			    {"play", cmd_dipoles_op, 3},
+			    {"stop", cmd_dipoles_op, 4},
+			    {0,0,0}};
+int
+cmd_dipoles(char *arg, int sel)
+{
+	return command(arg, cd_dipoles);
+}
+
 // nfield command
 
 struct comdef cd_nfield[]={{"load", cmd_nfield_load, 0},
+			   {"transfer", cmd_nfield_transfer, 0},
+			   {"smooth", cmd_nfield_smooth, 0},
 			   {"range", cmd_nfield_range, 0},
 			   {"auto", cmd_nfield_auto, 0},
 			   {"zero", cmd_nfield_auto, 1},
 			   {"background", cmd_nfield_background, 0},
+			   {"colormap", cmd_nfield_colormap, 0},
 			   {0,0,0}};
 int
 cmd_nfield(char *arg, int sel)
@@ -842,6 +1009,58 @@ cmd_nfield_load (char *arg, int sel)
 	return 0;
 }
 
+int
+cmd_nfield_transfer (char *arg, int sel)
+{
+	vector<const char *> files;
+	int ma, mb, n;
+
+	assert (arg);
+	skip_ws(&arg);
+	strip_ws(arg);
+
+	if (sscanf(arg, "%d %d%n", &ma, &mb, &n) < 2) {
+		printf("Usage: nfield transfer <from> <to> [file ...]\n");
+		return 1;
+	}
+
+	for (char *tok = strtok(arg + n, " \t"); tok;
+	     tok = strtok(NULL, " \t"))
+		files.push_back(tok);
+
+	if (ui->showmesh_window->transfer_node_fn(ma, mb, files)) {
+		printf("Error!\n");
+		return 1;
+	}
+
+	printf ("Done.\n");
+	return 0;
+}
+
+int
+cmd_nfield_smooth (char *arg, int sel)
+{
+	int iter, mn = sel;
+	double lambda = 0.5;
+
+	assert (arg);
+	skip_ws(&arg);
+	strip_ws(arg);
+
+	if (sscanf(arg, "%d %lg %d", &iter, &lambda, &mn) < 1) {
+		printf("Usage: nfield smooth <iter> [lambda [mesh]]\n");
+		return 1;
+	}
+
+	if (ui->showmesh_window->smooth_node_fn(iter, lambda, mn)) {
+		printf("Error!\n");
+		return 1;
+	}
+
+	printf ("Done.\n");
+	return 0;
+}
+
 struct comdef cd_nfield_background[]={{"load", cmd_nfield_background_load, 0},
 				      {"on", cmd_nfield_background_alpha, 1},
 				      {"off", cmd_nfield_background_alpha, 0},
@@ -928,6 +1147,82 @@ cmd_nfield_auto (char *arg, int sel)
 	return 0;
 }
 
+struct comdef cd_nfield_colormap[]={{"use", cmd_colormap_use, 0},
+				    {"flip", cmd_colormap_flip, 0},
+				    {"load", cmd_colormap_load, 0},
+				    {"list", cmd_colormap_list, 0},
+				    {0,0,0}};
+
+int
+cmd_nfield_colormap(char *arg, int sel)
+{
+	return command(arg, cd_nfield_colormap);
+}
+
+int
+cmd_colormap_use (char *arg, int sel)
+{
+	assert (arg);
+	skip_ws(&arg);
+	strip_ws(arg);
+
+	if (*arg == 0) {
+		printf("Usage: nfield colormap use <name>\n");
+		return 1;
+	}
+
+	if (ui->showmesh_window->set_colormap(arg, 0)) {
+		printf("Error!\n");
+		return 1;
+	}
+
+	printf ("Done.\n");
+	return 0;
+}
+
+int
+cmd_colormap_flip (char *arg, int sel)
+{
+	if (ui->showmesh_window->flip_colormap(0)) {
+		printf("Error!\n");
+		return 1;
+	}
+
+	printf ("Done.\n");
+	return 0;
+}
+
+int
+cmd_colormap_load (char *arg, int sel)
+{
+	char name[MAX_TOKEN];
+
+	assert (arg);
+	skip_ws(&arg);
+	strip_ws(arg);
+
+	if (get_token(name, &arg) == 0) {
+		printf("Usage: nfield colormap load <name> <file>\n");
+		return 1;
+	}
+	skip_ws(&arg);
+
+	if (ColorMap::load(arg, name)) {
+		printf("Error!\n");
+		return 1;
+	}
+
+	printf ("Done.\n");
+	return 0;
+}
+
+int
+cmd_colormap_list (char *arg, int sel)
+{
+	ColorMap::list(stdout);
+	return 0;
+}
+
 // info command
 
 int
@@ -1203,6 +1498,232 @@ cmd_split(char *arg, int sel)
 }
 
 
+int
+cmd_snapshot(char *arg, int sel)
+{
+	int nm = cmd_window->numMeshes();
+
+	skip_ws(&arg);
+	if (strncasecmp(arg, "all", 3) == 0) {
+		for (int n = 0; n < nm; n++)
+			cmd_window->snapshot_mesh(n);
+		printf ("Done.\n");
+		return 0;
+	}
+
+	int n = atoi(arg);
+	if (n < 0 || n >= nm) {
+		printf ("invalid mesh number %d\n", n);
+		return 1;
+	}
+
+	if (cmd_window->snapshot_mesh(n)) {
+		printf("Error!\n");
+		return 1;
+	}
+	printf ("Done.\n");
+	return 0;
+}
+
+int
+cmd_deviation(char *arg, int sel)
+{
+	int m1, m2 = -1;
+
+	assert (arg);
+	skip_ws(&arg);
+	strip_ws(arg);
+
+	if (sscanf(arg, "%d %d", &m1, &m2) < 1) {
+		printf("Usage: deviation <mesh> [refmesh]\n");
+		return 1;
+	}
+
+	if (cmd_window->mesh_deviation(m1, m2)) {
+		printf("Error!\n");
+		return 1;
+	}
+	printf ("Done.\n");
+	return 0;
+}
+
+int
+cmd_decimate(char *arg, int sel)
+{
+	int mn, target, perclass = 0;
+	double clearance = 0, curvature = 0;
+
+	assert (arg);
+	skip_ws(&arg);
+	strip_ws(arg);
+
+	if (sscanf(arg, "%d %d %d %lg %lg", &mn, &target, &perclass,
+		   &clearance, &curvature) < 2) {
+		printf("Usage: decimate <mesh> <target> [perclass] "
+		       "[clearance] [curvature]\n");
+		return 1;
+	}
+
+	printf("Decimating mesh %d to %d elements\n", mn, target);
+	if (cmd_window->decimate_mesh(mn, target, perclass, clearance,
+				      curvature)) {
+		printf("Error!\n");
+		return 1;
+	}
+	printf ("Done.\n");
+	return 0;
+}
+
+int
+cmd_remesh(char *arg, int sel)
+{
+	int mn, iter = 5;
+	double len;
+
+	assert (arg);
+	skip_ws(&arg);
+	strip_ws(arg);
+
+	if (sscanf(arg, "%d %lg %d", &mn, &len, &iter) < 2 || len <= 0) {
+		printf("Usage: remesh <mesh> <length> [iterations]\n");
+		return 1;
+	}
+
+	printf("Remeshing mesh %d to edge length %g\n", mn, len);
+	if (cmd_window->remesh_mesh(mn, len, iter)) {
+		printf("Error!\n");
+		return 1;
+	}
+	printf ("Done.\n");
+	return 0;
+}
+
+int
+cmd_subdivide(char *arg, int sel)
+{
+	int mn, levels, scheme = SUBDIV_LOOP;
+	char name[32] = "loop";
+
+	assert (arg);
+	skip_ws(&arg);
+	strip_ws(arg);
+
+	if (sscanf(arg, "%d %d %31s", &mn, &levels, name) < 2 || levels < 0) {
+		printf("Usage: subdivide <mesh> <levels> "
+		       "[loop|sqrt3|midpoint]\n");
+		return 1;
+	}
+
+	if (strcmp(name, "sqrt3") == 0)
+		scheme = SUBDIV_SQRT3;
+	else if (strcmp(name, "midpoint") == 0)
+		scheme = SUBDIV_MIDPOINT;
+	else if (strcmp(name, "loop") != 0) {
+		printf("Unknown subdivision scheme: %s\n", name);
+		return 1;
+	}
+
+	printf("Subdividing mesh %d by %d %s levels\n", mn, levels, name);
+	if (cmd_window->subdivide_mesh(mn, levels, scheme)) {
+		printf("Error!\n");
+		return 1;
+	}
+	printf ("Done.\n");
+	return 0;
+}
+
+int
+cmd_quality(char *arg, int sel)
+{
+	int mn, nbins = 10;
+	char name[32] = "";
+
+	assert (arg);
+	skip_ws(&arg);
+	strip_ws(arg);
+
+	if (sscanf(arg, "%d %31s %d", &mn, name, &nbins) < 1) {
+		printf("Usage: quality <mesh> [metric] [bins]\n");
+		printf("  element metrics: aspect radius minangle maxangle "
+		       "area minedge maxedge dihedral\n");
+		printf("  node metrics: valence edgelen nodearea\n");
+		return 1;
+	}
+
+	if (cmd_window->mesh_quality(mn, name, nbins)) {
+		printf("Error!\n");
+		return 1;
+	}
+	printf ("Done.\n");
+	return 0;
+}
+
+int
+cmd_curvature(char *arg, int sel)
+{
+	int mn;
+	char name[32] = "";
+
+	assert (arg);
+	skip_ws(&arg);
+	strip_ws(arg);
+
+	if (sscanf(arg, "%d %31s", &mn, name) < 1) {
+		printf("Usage: curvature <mesh> [mean|gauss|k1|k2]\n");
+		return 1;
+	}
+
+	if (cmd_window->mesh_curvature(mn, name)) {
+		printf("Error!\n");
+		return 1;
+	}
+	printf ("Done.\n");
+	return 0;
+}
+
+int
+cmd_geodesic(char *arg, int sel)
+{
+	vector<unsigned int> src;
+	int mn, n, march = 0;
+	char *p;
+
+	assert (arg);
+	skip_ws(&arg);
+	strip_ws(arg);
+
+	mn = strtol(arg, &p, 10);
+	if (p == arg) {
+		printf("Usage: geodesic <mesh> [heat|fmm] [node ...]\n");
+		printf("  without nodes the point field is the source\n");
+		return 1;
+	}
+
+	arg = p;
+	skip_ws(&arg);
+	if (strncasecmp(arg, "fmm", 3) == 0) {
+		march = 1;
+		arg += 3;
+	} else if (strncasecmp(arg, "heat", 4) == 0)
+		arg += 4;
+
+	for (;;) {
+		n = strtol(arg, &p, 10);
+		if (p == arg || n < 0)
+			break;
+		src.push_back(n);
+		arg = p;
+	}
+
+	if (cmd_window->mesh_geodesic(mn, src, march)) {
+		printf("Error!\n");
+		return 1;
+	}
+	printf ("Done.\n");
+	return 0;
+}
+
+
 // command not implemented
 
 int
@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2014 Can Erkin Acar
+ * Copyright (C) 2014 Zeynep Akalin Acar
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include <GL/gl.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <string.h>
+#include <math.h>
+#include "dipoleset.h"
+
+//---------------------------------------------------------------------------
+DipoleSet::DipoleSet(void) : m_nframes(0), m_frame(0), m_max(0),
+	m_scale(1), m_valid(false), m_nodes(GS_NODE), m_arrows(GS_ARROW)
+{
+	// the set is small enough for glyphs, and arrows need them
+	m_nodes.setMode(GS_GLYPH);
+	m_arrows.setMode(GS_GLYPH);
+}
+//---------------------------------------------------------------------------
+void
+DipoleSet::clear(void)
+{
+	m_pos.clear();
+	m_mom.clear();
+	m_rgba.clear();
+	m_nframes = m_frame = 0;
+	m_max = 0;
+	m_nodes.clear();
+	m_arrows.clear();
+	m_valid = false;
+}
+//---------------------------------------------------------------------------
+// skips white space and comments, returns the next character (not read)
+static int
+skipSpace(FILE *f)
+{
+	int c;
+	while ((c = getc(f)) != EOF) {
+		if (c == '#') {
+			while ((c = getc(f)) != EOF && c != '\n')
+				;
+			continue;
+		}
+		if (!isspace(c))
+			break;
+	}
+	if (c != EOF)
+		ungetc(c, f);
+	return c;
+}
+//---------------------------------------------------------------------------
+static bool
+readNumber(FILE *f, double &x)
+{
+	if (skipSpace(f) == EOF)
+		return false;
+	return fscanf(f, "%lg", &x) == 1;
+}
+//---------------------------------------------------------------------------
+// limits on the header against corrupt files: the moments of all the
+// frames are kept in memory, 12 bytes each
+#define DS_MAX_DIPOLES	(1 << 24)
+#define DS_MAX_MOMENTS	(1 << 27)
+
+int
+DipoleSet::load(const char *fn, const Point3 &off)
+{
+	clear();
+
+	FILE *f = fopen(fn, "r");
+	if (f == NULL) {
+		printf("Failed to open %s\n", fn);
+		return 1;
+	}
+
+	double nd, nf;
+	if (!readNumber(f, nd) || !readNumber(f, nf) || nd < 1 || nf < 1 ||
+	    floor(nd) != nd || floor(nf) != nf ||
+	    nd > DS_MAX_DIPOLES || nd * nf > DS_MAX_MOMENTS) {
+		printf("%s: invalid header\n", fn);
+		fclose(f);
+		return 1;
+	}
+
+	bool color = false;
+	if (isalpha(skipSpace(f))) {
+		char word[16];
+		if (fscanf(f, "%15s", word) != 1 || strcmp(word, "color")) {
+			printf("%s: invalid header\n", fn);
+			fclose(f);
+			return 1;
+		}
+		color = true;
+	}
+
+	int np = nd;
+	m_nframes = nf;
+	m_pos.resize(np);
+	if (color)
+		m_rgba.resize(4 * np);
+	m_mom.resize(3 * (size_t) np * m_nframes);
+
+	bool ok = true;
+	for (int n = 0; ok && n < np; n++) {
+		double x = 0, y = 0, z = 0;
+		ok = readNumber(f, x) && readNumber(f, y) && readNumber(f, z);
+		m_pos[n] = Point3(x, y, z) - off;
+		for (int k = 0; ok && color && k < 3; k++) {
+			double c = 0;
+			ok = readNumber(f, c);
+			c = (c > 0) ? c : 0;
+			c = (c < 1) ? c : 1;
+			m_rgba[4 * n + k] = (GLubyte) (c * 255 + 0.5);
+		}
+		if (color)
+			m_rgba[4 * n + 3] = 255;
+	}
+
+	for (size_t i = 0; ok && i < m_mom.size(); i += 3) {
+		double p[3] = {0, 0, 0};
+		ok = readNumber(f, p[0]) && readNumber(f, p[1]) &&
+			readNumber(f, p[2]);
+		double l = sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+		if (l > m_max)
+			m_max = l;
+		for (int k = 0; k < 3; k++)
+			m_mom[i + k] = p[k];
+	}
+	fclose(f);
+
+	if (!ok) {
+		printf("%s: expected %d dipoles over %d frames\n", fn, np,
+		       m_nframes);
+		clear();
+		return 1;
+	}
+
+	printf("%d dipoles, %d frames\n", np, m_nframes);
+	return 0;
+}
+//---------------------------------------------------------------------------
+void
+DipoleSet::setFrame(int t)
+{
+	if (t < 0 || t >= m_nframes || t == m_frame)
+		return;
+	m_frame = t;
+	m_valid = false;
+}
+//---------------------------------------------------------------------------
+// the directions and sizes of the current frame for the glyphs
+void
+DipoleSet::update(void)
+{
+	if (m_valid)
+		return;
+
+	int np = m_pos.size();
+	vector<Point3> dir(np);
+	vector<float> size(np);
+	const float *mom = &m_mom[3 * (size_t) np * m_frame];
+
+#pragma omp parallel for schedule(static)
+	for (int n = 0; n < np; n++) {
+		Point3 j(mom[3 * n], mom[3 * n + 1], mom[3 * n + 2]);
+		double l = j.length();
+		if (l > 0) {
+			dir[n] = j / l;
+			size[n] = l / m_max;
+		} else {
+			dir[n] = Point3(0, 0, 1);
+			size[n] = 0;
+		}
+	}
+
+	m_nodes.set(m_pos, m_rgba, size);
+	m_arrows.set(m_pos, m_rgba, size, dir);
+	m_valid = true;
+}
+//---------------------------------------------------------------------------
+void
+DipoleSet::render(double d)
+{
+	if (m_pos.empty())
+		return;
+	update();
+
+	glColor4f(1, 1, 1, 1);
+	m_nodes.setRadius(2 * d * m_scale);
+	m_arrows.setRadius(d * m_scale);
+	m_nodes.render();
+	m_arrows.render();
+}
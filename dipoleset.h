@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2014 Can Erkin Acar
+ * Copyright (C) 2014 Zeynep Akalin Acar
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef _DIPOLESET_H_
+#define _DIPOLESET_H_
+
+#include "glyphset.h"
+
+// Dipoles at fixed positions with moments over one or more time frames,
+// as from a distributed source model. Each is drawn as a node with an
+// arrow along its moment, sized by the moment magnitude relative to the
+// largest of all frames, times the scale.
+//
+// The file is read as numbers, '#' starts a comment:
+//   <dipoles> <frames> [color]
+//   x y z [r g b]		one line per dipole, colors from 0 to 1
+//   px py pz			one line per dipole for each frame
+class DipoleSet {
+public:
+	DipoleSet(void);
+
+	// positions are moved by -off, as the meshes are. Returns 0 on
+	// success, the set is left empty on errors.
+	int load(const char *fn, const Point3 &off);
+	void clear(void);
+
+	inline int numDipoles(void) const {
+		return m_pos.size();
+	}
+	inline int numFrames(void) const {
+		return m_nframes;
+	}
+	inline int getFrame(void) const {
+		return m_frame;
+	}
+	void setFrame(int t);
+	inline void setScale(double s) {
+		m_scale = s;
+	}
+	inline double getScale(void) const {
+		return m_scale;
+	}
+	inline const vector<Point3> &getPositions(void) const {
+		return m_pos;
+	}
+
+	// d is the glyph size, as the window's m_delsc
+	void render(double d);
+
+private:
+	void update(void);
+
+	vector<Point3> m_pos;
+	vector<float> m_mom;	// 3 per dipole, one frame after the other
+	vector<GLubyte> m_rgba;
+	int m_nframes;
+	int m_frame;
+	double m_max;		// largest moment magnitude
+	double m_scale;
+	bool m_valid;
+
+	GlyphSet m_nodes;
+	GlyphSet m_arrows;
+};
+
+#endif
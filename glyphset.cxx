@@ -0,0 +1,375 @@
+/*
+ * Copyright (C) 2014 Can Erkin Acar
+ * Copyright (C) 2014 Zeynep Akalin Acar
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <string.h>
+#include <math.h>
+#include "meshrender.h"		// MR_USE_VBO
+#include "glyphset.h"
+
+// the octahedron: vertices along +x, +y, +z, -y, -z, -x with the
+// normals pointing the same way, and the faces of its two fans
+#define OCT_VERTS	6
+#define OCT_INDEX	24
+
+static const GLbyte s_oct_dir[OCT_VERTS][3] = {
+	{1, 0, 0}, {0, 1, 0}, {0, 0, 1}, {0, -1, 0}, {0, 0, -1}, {-1, 0, 0}
+};
+
+static const GLuint s_oct_idx[OCT_INDEX] = {
+	0, 1, 2,  0, 2, 3,  0, 3, 4,  0, 4, 1,
+	5, 1, 4,  5, 4, 3,  5, 3, 2,  5, 2, 1
+};
+
+// the arrow: a fan from the tip around four base corners, and the base
+// again with its own normal
+#define ARROW_VERTS	9
+#define ARROW_INDEX	18
+#define ARROW_LENGTH	6	// times the base radius
+
+static const GLuint s_arrow_idx[ARROW_INDEX] = {
+	0, 1, 2,  0, 2, 3,  0, 3, 4,  0, 4, 1,
+	5, 6, 7,  5, 7, 8
+};
+
+//---------------------------------------------------------------------------
+GlyphSet::GlyphSet(int shape) : m_count(0), m_radius(1), m_shape(shape),
+	m_mode(GS_AUTO), m_valid(false), m_points(false)
+{
+	for (int b = 0; b < GS_NUM_BUF; b++)
+		m_vbo[b] = 0;
+}
+//---------------------------------------------------------------------------
+GlyphSet::~GlyphSet(void)
+{
+#ifdef MR_USE_VBO
+	if (m_vbo[0])
+		glDeleteBuffers(GS_NUM_BUF, m_vbo);
+#endif
+}
+//---------------------------------------------------------------------------
+void
+GlyphSet::set(const vector<Point3> &pts, const vector<GLubyte> &rgba,
+	      const vector<float> &size, const vector<Point3> &dir)
+{
+	int np = pts.size();
+
+	m_pos.resize(3 * np);
+	for (int n = 0; n < np; n++) {
+		m_pos[3 * n] = pts[n].getX();
+		m_pos[3 * n + 1] = pts[n].getY();
+		m_pos[3 * n + 2] = pts[n].getZ();
+	}
+
+	if (rgba.size() == 4 * (unsigned) np)
+		m_rgba = rgba;
+	else
+		m_rgba.clear();
+
+	if (size.size() == (unsigned) np)
+		m_size = size;
+	else
+		m_size.clear();
+
+	if (dir.size() == (unsigned) np) {
+		m_dir.resize(3 * np);
+		for (int n = 0; n < np; n++) {
+			m_dir[3 * n] = dir[n].getX();
+			m_dir[3 * n + 1] = dir[n].getY();
+			m_dir[3 * n + 2] = dir[n].getZ();
+		}
+	} else
+		m_dir.clear();
+
+	m_valid = false;
+}
+//---------------------------------------------------------------------------
+void
+GlyphSet::clear(void)
+{
+	m_pos.clear();
+	m_rgba.clear();
+	m_size.clear();
+	m_dir.clear();
+	m_valid = false;
+}
+//---------------------------------------------------------------------------
+bool
+GlyphSet::usePoints(void) const
+{
+	if (m_mode == GS_AUTO)
+		return size() > GS_MAX_GLYPHS;
+	return m_mode == GS_POINTS;
+}
+//---------------------------------------------------------------------------
+void
+GlyphSet::update(void)
+{
+	if (m_valid)
+		return;
+
+	m_points = usePoints();
+	if (m_points)
+		buildPoints();
+	else
+		buildGlyphs();
+	upload();
+	m_valid = true;
+}
+//---------------------------------------------------------------------------
+// a copy of the glyph at each point, radius times its size
+void
+GlyphSet::buildGlyphs(void)
+{
+	int np = size();
+	bool col = !m_rgba.empty();
+	bool arrow = (m_shape == GS_ARROW);
+	int nv = arrow ? ARROW_VERTS : OCT_VERTS;
+	int ni = arrow ? ARROW_INDEX : OCT_INDEX;
+	const GLuint *gidx = arrow ? s_arrow_idx : s_oct_idx;
+
+	m_vpos.resize(3 * nv * np);
+	m_vnrm.resize(3 * nv * np);
+	m_vcol.resize(col ? 4 * nv * np : 0);
+	m_vidx.resize(ni * np);
+	m_first.clear();
+
+#pragma omp parallel for schedule(static)
+	for (int n = 0; n < np; n++) {
+		GLfloat r = m_radius * (m_size.empty() ? 1 : m_size[n]);
+		if (arrow)
+			buildArrow(n, r, &m_vpos[3 * nv * n], &m_vnrm[3 * nv * n]);
+		else
+			buildNode(n, r, &m_vpos[3 * nv * n], &m_vnrm[3 * nv * n]);
+
+		if (col)
+			for (int k = 0; k < nv; k++)
+				memcpy(&m_vcol[4 * (nv * n + k)],
+				       &m_rgba[4 * n], 4);
+
+		GLuint base = nv * n;
+		GLuint *idx = &m_vidx[ni * n];
+		for (int k = 0; k < ni; k++)
+			idx[k] = base + gidx[k];
+	}
+
+	m_count = m_vidx.size();
+}
+//---------------------------------------------------------------------------
+void
+GlyphSet::buildNode(int n, GLfloat r, GLfloat *v, GLbyte *nr) const
+{
+	const GLfloat *p = &m_pos[3 * n];
+
+	for (int k = 0; k < OCT_VERTS; k++)
+		for (int j = 0; j < 3; j++) {
+			v[3 * k + j] = p[j] + r * s_oct_dir[k][j];
+			nr[3 * k + j] = s_oct_dir[k][j] * 127;
+		}
+}
+//---------------------------------------------------------------------------
+static inline GLbyte
+normalByte(GLfloat x)
+{
+	return (GLbyte) floor(x * 127 + 0.5f);
+}
+//---------------------------------------------------------------------------
+// the tip is ARROW_LENGTH * r along the direction, the base corners r
+// away on two axes across it, as drawArrow used to place them
+void
+GlyphSet::buildArrow(int n, GLfloat r, GLfloat *v, GLbyte *nr) const
+{
+	const GLfloat *p = &m_pos[3 * n];
+	Point3 dn(0, 0, 1), dn1, dn2;
+	if (!m_dir.empty())
+		dn = Point3(m_dir[3 * n], m_dir[3 * n + 1], m_dir[3 * n + 2]);
+
+	if (fabs(dn.getZ()) > fabs(dn.getY())) {
+		if (fabs(dn.getZ()) > fabs(dn.getX()))
+			dn1 = Point3(dn.getZ(), 0, -dn.getX());
+		else
+			dn1 = Point3(-dn.getY(), dn.getX(), 0);
+	} else {
+		if (fabs(dn.getY()) > fabs(dn.getX()))
+			dn1 = Point3(dn.getY(), -dn.getX(), 0);
+		else
+			dn1 = Point3(-dn.getZ(), 0, dn.getX());
+	}
+	dn1.normalize();
+	dn2 = Cross(dn1, dn);
+	dn2.normalize();
+
+	// tip, the base corners and their normals, then the base
+	const Point3 off[5] = {dn * ARROW_LENGTH, dn1, -dn2, -dn1, dn2};
+	const Point3 nrm[5] = {dn, dn1, -dn2, -dn1, dn2};
+	static const int base[4] = {1, 4, 3, 2};
+
+	for (int k = 0; k < ARROW_VERTS; k++) {
+		int c = (k < 5) ? k : base[k - 5];
+		Point3 d = (k < 5) ? nrm[c] : -dn;
+		double o[3], dd[3];
+		off[c].getCoord(o[0], o[1], o[2]);
+		d.getCoord(dd[0], dd[1], dd[2]);
+		for (int j = 0; j < 3; j++) {
+			v[3 * k + j] = p[j] + r * o[j];
+			nr[3 * k + j] = normalByte(dd[j]);
+		}
+	}
+}
+//---------------------------------------------------------------------------
+// the points sorted by their size in pixels, so each size is one call
+void
+GlyphSet::buildPoints(void)
+{
+	int np = size();
+	bool col = !m_rgba.empty();
+
+	vector<unsigned char> ps(np, GS_POINT_SIZE);
+	if (!m_size.empty())
+		for (int n = 0; n < np; n++) {
+			int s = (int) floor(GS_POINT_SIZE * m_size[n] + 0.5);
+			s = (s > 1) ? s : 1;
+			ps[n] = (s < GS_MAX_POINT) ? s : GS_MAX_POINT;
+		}
+
+	m_first.assign(GS_MAX_POINT + 2, 0);
+	for (int n = 0; n < np; n++)
+		m_first[ps[n] + 1]++;
+	for (int s = 1; s <= GS_MAX_POINT + 1; s++)
+		m_first[s] += m_first[s - 1];
+
+	m_vpos.resize(3 * np);
+	m_vnrm.clear();
+	m_vcol.resize(col ? 4 * np : 0);
+	m_vidx.clear();
+
+	vector<int> next(m_first.begin(), m_first.end() - 1);
+	for (int n = 0; n < np; n++) {
+		int i = next[ps[n]]++;
+		memcpy(&m_vpos[3 * i], &m_pos[3 * n], 3 * sizeof(GLfloat));
+		if (col)
+			memcpy(&m_vcol[4 * i], &m_rgba[4 * n], 4);
+	}
+
+	m_count = np;
+}
+//---------------------------------------------------------------------------
+// moves the arrays into buffer objects, they are not needed after
+void
+GlyphSet::upload(void)
+{
+#ifdef MR_USE_VBO
+	if (m_vbo[0] == 0)
+		glGenBuffers(GS_NUM_BUF, m_vbo);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo[GS_BUF_POS]);
+	glBufferData(GL_ARRAY_BUFFER, m_vpos.size() * sizeof(GLfloat),
+		     m_vpos.empty() ? NULL : &m_vpos[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo[GS_BUF_NRM]);
+	glBufferData(GL_ARRAY_BUFFER, m_vnrm.size(),
+		     m_vnrm.empty() ? NULL : &m_vnrm[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo[GS_BUF_COL]);
+	glBufferData(GL_ARRAY_BUFFER, m_vcol.size(),
+		     m_vcol.empty() ? NULL : &m_vcol[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_vbo[GS_BUF_IDX]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_vidx.size() * sizeof(GLuint),
+		     m_vidx.empty() ? NULL : &m_vidx[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	vector<GLfloat>().swap(m_vpos);
+	vector<GLbyte>().swap(m_vnrm);
+	vector<GLubyte>().swap(m_vcol);
+	vector<GLuint>().swap(m_vidx);
+#endif
+}
+//---------------------------------------------------------------------------
+// the buffer object for the array if there is one, the data otherwise
+const GLvoid *
+GlyphSet::bindArray(int buf, const void *data)
+{
+#ifdef MR_USE_VBO
+	(void) data;
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo[buf]);
+	return NULL;
+#else
+	(void) buf;
+	return data;
+#endif
+}
+//---------------------------------------------------------------------------
+void
+GlyphSet::render(void)
+{
+	if (m_pos.empty())
+		return;
+	update();
+
+	glPushAttrib(GL_CURRENT_BIT | GL_ENABLE_BIT | GL_POINT_BIT |
+		     GL_COLOR_BUFFER_BIT);
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, bindArray(GS_BUF_POS,
+		m_vpos.empty() ? NULL : &m_vpos[0]));
+
+	if (m_rgba.empty())
+		glDisableClientState(GL_COLOR_ARRAY);
+	else {
+		glEnableClientState(GL_COLOR_ARRAY);
+		glColorPointer(4, GL_UNSIGNED_BYTE, 0, bindArray(GS_BUF_COL,
+			m_vcol.empty() ? NULL : &m_vcol[0]));
+	}
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+
+	if (m_points) {
+		glDisableClientState(GL_NORMAL_ARRAY);
+		glDisable(GL_LIGHTING);
+		glEnable(GL_POINT_SMOOTH);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		for (int s = 1; s <= GS_MAX_POINT; s++) {
+			int n = m_first[s + 1] - m_first[s];
+			if (n == 0)
+				continue;
+			glPointSize(s);
+			glDrawArrays(GL_POINTS, m_first[s], n);
+		}
+	} else {
+		glEnableClientState(GL_NORMAL_ARRAY);
+		glNormalPointer(GL_BYTE, 0, bindArray(GS_BUF_NRM,
+			m_vnrm.empty() ? NULL : &m_vnrm[0]));
+
+		const GLuint *idx;
+#ifdef MR_USE_VBO
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_vbo[GS_BUF_IDX]);
+		idx = NULL;
+#else
+		idx = &m_vidx[0];
+#endif
+		glDrawElements(GL_TRIANGLES, m_count, GL_UNSIGNED_INT, idx);
+	}
+
+#ifdef MR_USE_VBO
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+#endif
+	glPopClientAttrib();
+	glPopAttrib();
+}
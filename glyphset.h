@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2014 Can Erkin Acar
+ * Copyright (C) 2014 Zeynep Akalin Acar
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef _GLYPHSET_H_
+#define _GLYPHSET_H_
+
+#include <GL/gl.h>
+#include <vector>
+#include "point3.h"
+
+using namespace std;
+
+// glyph shapes
+#define GS_NODE		0	// octahedron around the point
+#define GS_ARROW	1	// pyramid from the point along its direction
+
+// how the points are drawn
+#define GS_AUTO		0	// glyphs up to GS_MAX_GLYPHS, then points
+#define GS_GLYPH	1
+#define GS_POINTS	2
+
+#define GS_MAX_GLYPHS	(1 << 17)
+#define GS_POINT_SIZE	4	// pixels at size 1
+#define GS_MAX_POINT	16
+
+// buffer objects
+#define GS_BUF_POS	0
+#define GS_BUF_NRM	1
+#define GS_BUF_COL	2
+#define GS_BUF_IDX	3
+#define GS_NUM_BUF	4
+
+// A glyph mesh placed at each of a set of points, with optional RGBA8
+// colors, relative sizes and (for arrows) directions per point. The
+// copies are expanded into one indexed array in buffer objects, drawn
+// with a single call and rebuilt only when the points or the glyph
+// radius change. Large sets are drawn as round GL points, one call per
+// pixel size.
+class GlyphSet {
+public:
+	GlyphSet(int shape = GS_NODE);
+	~GlyphSet(void);
+
+	// the points with their colors (4 bytes each), sizes and unit
+	// directions, any may be empty for the current color, size 1 and
+	// +z
+	void set(const vector<Point3> &pts, const vector<GLubyte> &rgba,
+		 const vector<float> &size,
+		 const vector<Point3> &dir = vector<Point3>());
+	void clear(void);
+
+	inline void setRadius(double r) {
+		if (r != m_radius) {
+			m_radius = r;
+			m_valid = false;
+		}
+	}
+	inline void setMode(int mode) {
+		if (mode != m_mode) {
+			m_mode = mode;
+			m_valid = false;
+		}
+	}
+	inline int getMode(void) const {
+		return m_mode;
+	}
+	inline int size(void) const {
+		return m_pos.size() / 3;
+	}
+
+	// in the current transform and color
+	void render(void);
+
+private:
+	bool usePoints(void) const;
+	void update(void);
+	void buildGlyphs(void);
+	void buildNode(int n, GLfloat r, GLfloat *v, GLbyte *nr) const;
+	void buildArrow(int n, GLfloat r, GLfloat *v, GLbyte *nr) const;
+	void buildPoints(void);
+	void upload(void);
+	const GLvoid *bindArray(int buf, const void *data);
+
+	// the points
+	vector<GLfloat> m_pos;
+	vector<GLubyte> m_rgba;
+	vector<float> m_size;
+	vector<GLfloat> m_dir;
+
+	// the arrays drawn
+	vector<GLfloat> m_vpos;
+	vector<GLbyte> m_vnrm;
+	vector<GLubyte> m_vcol;
+	vector<GLuint> m_vidx;
+	// GS_POINTS: first point of each pixel size, sorted by size
+	vector<int> m_first;
+
+	int m_count;		// indices or points drawn
+	double m_radius;
+	int m_shape;
+	int m_mode;
+	bool m_valid;
+	bool m_points;		// the arrays hold points, not glyphs
+	GLuint m_vbo[GS_NUM_BUF];	// unused without MR_USE_VBO
+};
+
+#endif
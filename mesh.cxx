@@ -18,14 +18,20 @@
  */
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <limits.h>
 #include <math.h>
+#include <float.h>
+#include <algorithm>
 #include "mesh.h"
+#include "meshbvh.h"
+#include "meshcurv.h"
 #include <string.h>
 //---------------------------------------------------------------------------
 TriMeshLin::TriMeshLin(void)
 {
 	m_numverts = m_numtris = m_numedges = m_nodeelem = 0;
+	m_version = m_topo_version = 0;
 
 //	float kPB = 0.1;
 	float kPB = 0.5;
@@ -192,7 +198,7 @@ TriMeshLin::set(const TriMeshLin &m)
 	m_nflags.clear();
 	m_norms.clear();
 
-	invalidateNormals();
+	invalidateTopology();
 	m_numverts = m.getNumVerts();
 	m_numtris = m.getNumTris();
 
@@ -209,6 +215,7 @@ TriMeshLin::set(const TriMeshLin &m)
 
 	m_nflags.resize(m_numverts);
 	m_norms.resize(m_numverts);
+	m_fsizes = m.m_fsizes;
 
 	calcLimits();
 
@@ -248,7 +255,7 @@ TriMeshLin::loadSmf(FILE *f)
 	m_nflags.clear();
 	m_norms.clear();
 
-	invalidateNormals();
+	invalidateTopology();
 
 	unsigned max = 0;
 	for (;;) {
@@ -315,7 +322,7 @@ TriMeshLin::loadTri(FILE *f)
 	m_verts.clear();
 	m_nflags.clear();
 	m_norms.clear();
-	invalidateNormals();
+	invalidateTopology();
 
 	for (;;) {
 		if ((buf = getLine(f)) == 0)
@@ -395,7 +402,7 @@ TriMeshLin::loadFS(FILE *f)
 	m_nflags.clear();
 	m_norms.clear();
 
-	invalidateNormals();
+	invalidateTopology();
 
 	if (fs.readI3(magic))
 		return 1;
@@ -1033,137 +1040,603 @@ TriMeshLin::stitch(void)
 	return 0;
 }
 //---------------------------------------------------------------------------
+// collect the boundary loops. The boundary edges are directed against
+// their element and indexed by their start node, so each loop is walked
+// with one lookup per node. The nodes of loop l are loops[start[l]] ..
+// loops[start[l + 1] - 1], elem[l] is an element on its boundary.
+// Adding the element (v[i - 1], v[i], v[i + 1]) keeps the orientation.
 int
-TriMeshLin::fillNextPair(elist_t &blist)
+TriMeshLin::boundaryLoops(vector<unsigned int> &loops,
+			  vector<unsigned int> &start,
+			  vector<unsigned int> &elem)
 {
-	elist_t::iterator e1, e2, en;
+	vector<unsigned int> from, to, hel;
 
-	Edge *ed1, *ed2, *ed3;
+	loops.clear();
+	start.assign(1, 0);
+	elem.clear();
 
-	ed1 = ed2 = ed3 = NULL;
+	for (EdgeIter it(*this); it.value(); it.next()) {
+		Edge *e = it.value();
+		if (e->nelem != 1)
+			continue;
 
-	for (e1 = blist.begin(); e1 != blist.end(); e1 = en) {
-		en = e1;
-		en++;
-		for (e2 = en; e2 != blist.end(); e2++) {
-			if (!isNeighborEdges(*e1, *e2))
-				continue;
-			ed1 = *e1;
-			ed2 = *e2;
-			break;
+		const unsigned int *u = &m_tris[3 * e->elem[0]];
+		int m;
+		for (m = 0; m < 3; m++)
+			if (u[m] == e->node1)
+				break;
+		if (u[(m + 1) % 3] == e->node2) {
+			from.push_back(e->node2);
+			to.push_back(e->node1);
+		} else {
+			from.push_back(e->node1);
+			to.push_back(e->node2);
 		}
-		if (e2 != blist.end())
-			break;
+		hel.push_back(e->elem[0]);
 	}
 
-	if (ed1 == NULL)
-		return -1;
+	unsigned int nh = from.size();
+	vector<unsigned int> off(m_numverts + 1, 0), out(nh);
+	vector<char> used(nh, 0);
 
-	unsigned int v0, v1, v2;
+	for (unsigned int h = 0; h < nh; h++)
+		off[from[h] + 1]++;
+	for (unsigned int v = 0; v < m_numverts; v++)
+		off[v + 1] += off[v];
+	for (unsigned int h = 0; h < nh; h++)
+		out[off[from[h]]++] = h;
+	for (unsigned int v = m_numverts; v > 0; v--)
+		off[v] = off[v - 1];
+	off[0] = 0;
+
+	// walk the edges keeping the current path. A node visited twice
+	// closes a simple loop which is split off, so pinched holes give
+	// one loop per lobe.
+	vector<int> pos(m_numverts, -1);
+	vector<unsigned int> path, pel;
+
+	for (unsigned int h0 = 0; h0 < nh; h0++) {
+		if (used[h0])
+			continue;
 
-	if (ed1->node1 == ed2->node1) {
-		v0 = ed1->node1;
-		v1 = ed1->node2;
-		v2 = ed2->node2;
-	} else if (ed1->node1 == ed2->node2) {
-		v0 = ed1->node1;
-		v1 = ed1->node2;
-		v2 = ed2->node1;
-	} else if (ed1->node2 == ed2->node1) {
-		v0 = ed1->node2;
-		v1 = ed1->node1;
-		v2 = ed2->node2;
-	} else if (ed1->node2 == ed2->node2) {
-		v0 = ed1->node2;
-		v1 = ed1->node1;
-		v2 = ed2->node1;
-	} else {
-		// should not happen
-		printf("Selected edges do not match!\n");
-		assert(0);
+		unsigned int h = h0;
+		path.assign(1, from[h0]);
+		pel.assign(1, hel[h0]);
+		pos[from[h0]] = 0;
+
+		for (;;) {
+			unsigned int v = to[h], k;
+			used[h] = 1;
+
+			if (pos[v] >= 0) {
+				unsigned int p = pos[v];
+				for (k = p; k < path.size(); k++) {
+					loops.push_back(path[k]);
+					pos[path[k]] = -1;
+				}
+				start.push_back(loops.size());
+				elem.push_back(pel[p]);
+				path.resize(p);
+				pel.resize(p);
+			}
+
+			for (k = off[v]; k < off[v + 1]; k++)
+				if (!used[out[k]])
+					break;
+			if (k == off[v + 1])
+				break;
+
+			h = out[k];
+			pos[v] = path.size();
+			path.push_back(v);
+			pel.push_back(hel[h]);
+		}
+
+		if (path.size())
+			MESH_LOG("Incomplete boundary at node %d\n", path[0]);
+		for (unsigned int k = 0; k < path.size(); k++)
+			pos[path[k]] = -1;
+	}
+
+	return elem.size();
+}
+//---------------------------------------------------------------------------
+// interior angle of the hole at loop node v[i] between v[p] and v[n].
+// Ears that would duplicate an existing edge are penalized
+double
+TriMeshLin::earAngle(const unsigned int *v, int p, int i, int n,
+		     const Point3 &nrm)
+{
+	Point3 a = m_verts[v[p]] - m_verts[v[i]];
+	Point3 b = m_verts[v[n]] - m_verts[v[i]];
+	double ang = atan2(Cross(b, a).dot(nrm), a.dot(b));
+
+	if (ang < 0)
+		ang += 2 * M_PI;
+	if (v[p] == v[n] || getEdge(v[p], v[n]) != NULL)
+		ang += 4 * M_PI;
+
+	return ang;
+}
+//---------------------------------------------------------------------------
+// fill the hole bounded by the loop v[0] .. v[n - 1] by clipping the
+// ear with the smallest interior angle first. A node is added at the
+// center if the remaining ears would all duplicate existing edges.
+// returns the number of elements added
+int
+TriMeshLin::fillHole(const unsigned int *v, int n)
+{
+	if (n < 3)
+		return 0;
+
+	// the normal of the hole (Newell)
+	Point3 nrm(0, 0, 0);
+	for (int i = 0; i < n; i++)
+		nrm += Cross(m_verts[v[i]], m_verts[v[(i + 1) % n]]);
+	if (nrm.length() > 0)
+		nrm.normalize();
+
+	vector<int> prev(n), next(n);
+	vector<unsigned int> stamp(n, 0);
+	cqueue_t q;
+
+	for (int i = 0; i < n; i++) {
+		prev[i] = (i + n - 1) % n;
+		next[i] = (i + 1) % n;
+
+		CollapseCand c;
+		c.score = earAngle(v, prev[i], i, next[i], nrm);
+		c.v[0] = i;
+		c.v[1] = 0;
+		q.push(c);
 	}
 
-	// try to maintain a good orientation
-	unsigned int el = ed1->elem[0];
-	int m;
-	for (m = 0; m < 3; m++) {
-		if (getElemInd(el, m) == v0)
+	int left = n, added = 0;
+	while (left > 3 && !q.empty()) {
+		CollapseCand c = q.top();
+		q.pop();
+
+		int i = c.v[0];
+		if (c.v[1] != stamp[i])
+			continue;
+
+		// only ears duplicating edges are left
+		if (c.score >= 4 * M_PI)
 			break;
+
+		int p = prev[i], nx = next[i];
+		addElem(v[p], v[i], v[nx]);
+		added++;
+		left--;
+
+		stamp[i] = UINT_MAX;
+		next[p] = nx;
+		prev[nx] = p;
+
+		int upd[2] = { p, nx };
+		for (int k = 0; k < 2; k++) {
+			int j = upd[k];
+			c.score = earAngle(v, prev[j], j, next[j], nrm);
+			c.v[0] = j;
+			c.v[1] = ++stamp[j];
+			q.push(c);
+		}
 	}
-	assert(m < 3);
-	m++;
-	if (m > 2)
-		m = 0;
 
-	if (getElemInd(el, m) == v1) {
-		unsigned t = v1;
-		v1 = v2;
-		v2 = t;
+	int i = 0;
+	while (stamp[i] == UINT_MAX)
+		i++;
+
+	if (left == 3) {
+		if (findElem(v[prev[i]], v[i], v[next[i]]) < 0) {
+			addElem(v[prev[i]], v[i], v[next[i]]);
+			added++;
+		}
+	} else if (left > 3) {
+		// every chord exists already, fan from a new center node. The
+		// center is a neighbor of all the nodes left, and each of them
+		// gains a neighbor and two elements.
+		if (left >= MAX_NEIGHBOR) {
+			MESH_LOG("Hole at node %d: %d nodes left, too many "
+				 "for a fan\n", v[i], left);
+			return added;
+		}
+		Point3 ctr(0, 0, 0);
+		int j = i;
+		do {
+			if (getNodeNbrs(v[j]).count() >= MAX_NEIGHBOR ||
+			    getFaceNbrs(v[j]).count() > MAX_NEIGHBOR - 2) {
+				MESH_LOG("Hole at node %d: no room for a "
+					 "fan\n", v[j]);
+				return added;
+			}
+			ctr += m_verts[v[j]];
+			j = next[j];
+		} while (j != i);
+
+		unsigned int cv = addVertex(ctr / left);
+		do {
+			addElem(v[j], v[next[j]], cv);
+			added++;
+			j = next[j];
+		} while (j != i);
 	}
 
-	printf("  Adding element %d %d %d\n", v0, v1, v2);
+	return added;
+}
+//---------------------------------------------------------------------------
+// fill all holes of the mesh. The new elements are added with their
+// adjacency and moved into the class of the surrounding elements.
+int
+TriMeshLin::fillHoles(void)
+{
+	vector<unsigned int> loops, start, elem;
+	vector<int> src;
+	unsigned int nt0 = m_numtris;
+
+	findEdges();
 
-	addElem(v0, v1, v2);
+	int ncls = getNumClasses();
+	vector<unsigned int> cstart(ncls + 1, 0);
+	for (int c = 0; c < ncls; c++)
+		cstart[c + 1] = cstart[c] + m_fsizes[c];
+	if (cstart[ncls] != m_numtris)
+		ncls = 0;
 
-	ed3 = getEdge(v1, v2);
-	assert(ed3);
+	int nl = boundaryLoops(loops, start, elem);
+	int nfilled = 0;
 
-	if (ed3->nelem == 1) {
-		printf("  Adding edge [%d %d] to boundary\n", v1, v2);
-		blist.push_front(ed3);
-	} else {
-		printf("  Removing edge [%d %d] from boundary\n", v1, v2);
-		blist.remove(ed3);
+	for (int l = 0; l < nl; l++) {
+		int na = fillHole(&loops[start[l]], start[l + 1] - start[l]);
+		if (na == 0)
+			continue;
+		nfilled++;
+		src.resize(m_numtris - nt0, elemClass(cstart, src, nt0,
+						      elem[l]));
 	}
 
-	// remove the three edges from the list
-	assert(ed1->nelem == 2);
-	assert(ed2->nelem == 2);
+	printf("Filled %d of %d holes with %d elements\n", nfilled, nl,
+	       m_numtris - nt0);
 
-	blist.remove(ed1);
-	blist.remove(ed2);
+	if (m_numtris == nt0)
+		return 0;
+
+	if (ncls > 0)
+		placeElems(nt0, src);
+	else
+		classifyFaces();
+
+	calcNormals();
 
 	return 0;
 }
 //---------------------------------------------------------------------------
+// union-find root with path halving
+static inline unsigned int
+weldRoot(vector<unsigned int> &parent, unsigned int v)
+{
+	while (parent[v] != v) {
+		parent[v] = parent[parent[v]];
+		v = parent[v];
+	}
+	return v;
+}
+//---------------------------------------------------------------------------
+// LSD radix sort of the 63 bit keys, idx is permuted along
+static void
+radixSort(vector<uint64_t> &key, vector<unsigned int> &idx)
+{
+	unsigned int n = key.size();
+	vector<uint64_t> k2(n);
+	vector<unsigned int> i2(n);
+	vector<unsigned int> cnt(1 << 16);
+
+	for (int s = 0; s < 64; s += 16) {
+		fill(cnt.begin(), cnt.end(), 0);
+		for (unsigned int i = 0; i < n; i++)
+			cnt[(key[i] >> s) & 0xffff]++;
+		unsigned int sum = 0;
+		for (int b = 0; b < (1 << 16); b++) {
+			unsigned int c = cnt[b];
+			cnt[b] = sum;
+			sum += c;
+		}
+		for (unsigned int i = 0; i < n; i++) {
+			unsigned int p = cnt[(key[i] >> s) & 0xffff]++;
+			k2[p] = key[i];
+			i2[p] = idx[i];
+		}
+		key.swap(k2);
+		idx.swap(i2);
+	}
+}
+//---------------------------------------------------------------------------
+// find the nodes closer than eps and set vmap to the lowest node of
+// each group. The nodes are sorted by their quantized coordinates and
+// only the same and the 13 following grid cells are compared.
+// returns the number of welded nodes
 int
-TriMeshLin::fillHoles(void)
+TriMeshLin::weldNodes(double eps, vector<unsigned int> &vmap)
 {
-	int filled = 0;
-	elist_t elist, blist;
+	unsigned int nv = m_numverts;
+	Point3 pmin = m_verts[0], pmax = m_verts[0];
+
+	vmap.resize(nv);
+	for (unsigned int v = 0; v < nv; v++) {
+		const Point3 &p = m_verts[v];
+		vmap[v] = v;
+		pmin = Point3(fmin(pmin.getX(), p.getX()),
+			      fmin(pmin.getY(), p.getY()),
+			      fmin(pmin.getZ(), p.getZ()));
+		pmax = Point3(fmax(pmax.getX(), p.getX()),
+			      fmax(pmax.getY(), p.getY()),
+			      fmax(pmax.getZ(), p.getZ()));
+	}
 
-	for (EdgeIter it(*this); it.value(); it.next()) {
-		Edge *ed = it.value();
-		if (ed->nelem != 1)
+	// 21 bits per axis
+	Point3 sz = pmax - pmin;
+	double ext = fmax(sz.getX(), fmax(sz.getY(), sz.getZ()));
+	double cell = fmax(eps, ext / ((1 << 21) - 2));
+	if (cell <= 0)
+		cell = 1;
+
+	vector<uint64_t> key(nv);
+	vector<unsigned int> idx(nv);
+
+#pragma omp parallel for schedule(static)
+	for (int v = 0; v < (int) nv; v++) {
+		Point3 q = (m_verts[v] - pmin) / cell;
+		key[v] = ((uint64_t) q.getX() << 42) |
+			((uint64_t) q.getY() << 21) | (uint64_t) q.getZ();
+		idx[v] = v;
+	}
+
+	radixSort(key, idx);
+
+	// first entry of each occupied cell
+	vector<unsigned int> runs;
+	for (unsigned int i = 0; i < nv; i++)
+		if (i == 0 || key[i] != key[i - 1])
+			runs.push_back(i);
+	runs.push_back(nv);
+
+	int nr = runs.size() - 1;
+	double eps2 = eps * eps;
+	vector<unsigned int> pairs;
+
+#pragma omp parallel
+	{
+		vector<unsigned int> tp;
+
+#pragma omp for schedule(dynamic, 256)
+		for (int r = 0; r < nr; r++) {
+			uint64_t k = key[runs[r]];
+			int cx = (k >> 42) & 0x1fffff, cy = (k >> 21) & 0x1fffff;
+			int cz = k & 0x1fffff;
+
+			for (int d = 13; d < 27; d++) {
+				int dx = d / 9 - 1, dy = (d / 3) % 3 - 1;
+				int dz = d % 3 - 1;
+				unsigned int s, e;
+
+				if (d == 13) {
+					s = runs[r];
+					e = runs[r + 1];
+				} else {
+					if (cx + dx < 0 || cy + dy < 0 ||
+					    cz + dz < 0)
+						continue;
+					uint64_t kn = ((uint64_t) (cx + dx) << 42) |
+						((uint64_t) (cy + dy) << 21) |
+						(uint64_t) (cz + dz);
+					s = lower_bound(key.begin(), key.end(),
+							kn) - key.begin();
+					for (e = s; e < nv && key[e] == kn; e++)
+						;
+				}
+
+				for (unsigned int i = runs[r]; i < runs[r + 1]; i++)
+					for (unsigned int j = (d == 13) ? i + 1 : s;
+					     j < e; j++) {
+						Point3 dp = m_verts[idx[i]] -
+							m_verts[idx[j]];
+						if (dp.length2() > eps2)
+							continue;
+						tp.push_back(idx[i]);
+						tp.push_back(idx[j]);
+					}
+			}
+		}
+
+#pragma omp critical
+		pairs.insert(pairs.end(), tp.begin(), tp.end());
+	}
+
+	int nw = 0;
+	for (unsigned int n = 0; n < pairs.size(); n += 2) {
+		unsigned int a = weldRoot(vmap, pairs[n]);
+		unsigned int b = weldRoot(vmap, pairs[n + 1]);
+		if (a == b)
 			continue;
-		elist.push_back(ed);
+		if (a < b)
+			vmap[b] = a;
+		else
+			vmap[a] = b;
+		nw++;
 	}
 
-	elist_t::iterator bi, ei;
+	for (unsigned int v = 0; v < nv; v++)
+		vmap[v] = weldRoot(vmap, v);
 
-	print_boundary("edges:", elist);
+	return nw;
+}
+//---------------------------------------------------------------------------
+// weld the nodes closer than eps (none if eps < 0, identical ones if
+// eps == 0) and remove the elements that become degenerate or that
+// repeat the nodes of an earlier element in either orientation.
+// Unused nodes are dropped and the arrays are compacted once, keeping
+// the order of the remaining elements. The classes are kept unless
+// welding changed the connectivity.
+// If dups is given, (*dups)[f] counts the removed copies of element f.
+// returns the number of elements removed
+int
+TriMeshLin::removeDuplicates(double eps, vector<int> *dups)
+{
+	unsigned int nv = m_numverts, nt = m_numtris;
+	vector<unsigned int> vmap;
+	int nw = 0;
 
-	while (!elist.empty()) {
-		generateBoundary(elist, blist);
-		print_boundary("\n Filling", blist);
+	if (nt == 0)
+		return 0;
 
-		while (!blist.empty()) {
-			if (fillNextPair(blist))
-				break;
-			filled++;
+	if (eps >= 0)
+		nw = weldNodes(eps, vmap);
+	else {
+		vmap.resize(nv);
+		for (unsigned int v = 0; v < nv; v++)
+			vmap[v] = v;
+	}
+
+	// elements by their lowest node, with the other two sorted
+	vector<unsigned int> off(nv + 1, 0), byn(nt);
+	vector<unsigned int> tri(3 * nt);
+	vector<char> keep(nt, 1);
+	vector<int> ndup(nt, 0);
+
+#pragma omp parallel for schedule(static)
+	for (int f = 0; f < (int) nt; f++) {
+		unsigned int *t = &tri[3 * f];
+		for (int m = 0; m < 3; m++)
+			t[m] = vmap[m_tris[3 * f + m]];
+		if (t[0] == t[1] || t[1] == t[2] || t[0] == t[2]) {
+			keep[f] = 0;
+			continue;
+		}
+		// sort the nodes, the orientation does not matter
+		while (t[0] > t[1] || t[0] > t[2]) {
+			unsigned int s = t[0];
+			t[0] = t[1];
+			t[1] = t[2];
+			t[2] = s;
+		}
+		if (t[1] > t[2]) {
+			unsigned int s = t[1];
+			t[1] = t[2];
+			t[2] = s;
 		}
 	}
 
-	if (filled) {
-		invalidateNormals();
-		clearEdges();
-		// and reclaculate them
-		calcNeighbors();
-		findEdges();
-		processVertices();
+	for (unsigned int f = 0; f < nt; f++)
+		if (keep[f])
+			off[tri[3 * f] + 1]++;
+	for (unsigned int v = 0; v < nv; v++)
+		off[v + 1] += off[v];
+	for (unsigned int f = 0; f < nt; f++)
+		if (keep[f])
+			byn[off[tri[3 * f]]++] = f;
+	for (unsigned int v = nv; v > 0; v--)
+		off[v] = off[v - 1];
+	off[0] = 0;
+
+#pragma omp parallel for schedule(dynamic, 1024)
+	for (int v = 0; v < (int) nv; v++) {
+		for (unsigned int i = off[v]; i < off[v + 1]; i++) {
+			unsigned int f = byn[i];
+			for (unsigned int j = i + 1; j < off[v + 1] && keep[f];
+			     j++) {
+				unsigned int g = byn[j];
+				if (!keep[g] || tri[3 * f + 1] != tri[3 * g + 1] ||
+				    tri[3 * f + 2] != tri[3 * g + 2])
+					continue;
+				keep[g] = 0;
+				ndup[f]++;
+			}
+		}
 	}
 
-	return 0;
+	// compact the nodes and elements
+	vector<int> vnew(nv, -1);
+	vector<unsigned int> fcls;
+	int ncls = getNumClasses();
+	unsigned int sum = 0;
+
+	for (int c = 0; c < ncls; c++)
+		for (unsigned int n = 0; n < m_fsizes[c]; n++, sum++)
+			if (sum < nt)
+				fcls.push_back(c);
+	if (sum != nt || nw > 0)
+		ncls = 0;
+
+	for (unsigned int f = 0; f < nt; f++)
+		if (keep[f])
+			for (int m = 0; m < 3; m++)
+				vnew[tri[3 * f + m]] = 0;
+
+	unsigned int nnv = 0;
+	for (unsigned int v = 0; v < nv; v++) {
+		if (vnew[v] < 0)
+			continue;
+		m_verts[nnv] = m_verts[v];
+		vnew[v] = nnv++;
+	}
+
+	// the origins used by cutting and stitching refer to nodes too
+	if (m_vorigin.size() == nv) {
+		unsigned int n = 0;
+		for (unsigned int v = 0; v < nv; v++) {
+			if (vnew[v] < 0)
+				continue;
+			unsigned int o = m_vorigin[v];
+			if (o != (unsigned int) -1)
+				o = (vnew[vmap[o]] < 0) ? -1 : vnew[vmap[o]];
+			m_vorigin[n++] = o;
+		}
+		m_vorigin.resize(nnv);
+	}
+
+	unsigned int nnt = 0;
+	if (dups)
+		dups->clear();
+	for (unsigned int f = 0; f < nt; f++) {
+		if (!keep[f]) {
+			if (ncls)
+				m_fsizes[fcls[f]]--;
+			continue;
+		}
+		for (int m = 0; m < 3; m++)
+			m_tris[3 * nnt + m] = vnew[vmap[m_tris[3 * f + m]]];
+		if (dups)
+			dups->push_back(ndup[f]);
+		nnt++;
+	}
+
+	MESH_LOG("Welded %d nodes, removed %d elements and %d nodes\n",
+		 nw, nt - nnt, nv - nnv);
+
+	if (nnt == nt && nnv == nv)
+		return 0;
+
+	clearEdges();
+
+	m_numverts = nnv;
+	m_numtris = nnt;
+	m_verts.resize(nnv);
+	m_norms.resize(nnv);
+	m_nflags.resize(nnv);
+	m_edges.resize(nnv);
+	m_tris.resize(3 * nnt);
+	m_fnorms.resize(nnt);
+
+	findEdges();
+	calcNeighbors();
+	invalidateTopology();
+
+	if (ncls == 0)
+		classifyFaces();
+	calcNormals();
+
+	return nt - nnt;
 }
 //---------------------------------------------------------------------------
 int
@@ -1369,7 +1842,7 @@ TriMeshLin::processBadVertex(unsigned vert)
 		}
 	}
 
-	invalidateNormals();
+	invalidateTopology();
 
 	// phew!
 	return 0;
@@ -1518,7 +1991,7 @@ TriMeshLin::orientElement(char *fflags, int elem)
 		setElemInd(elem, 0, getElemInd(elem, 1));
 		setElemInd(elem, 1, tmp);
 		MESH_LOG("element %d reversed\n", elem);
-		invalidateNormals();
+		invalidateTopology();
 	}
 
 	return 1;
@@ -1903,6 +2376,69 @@ TriMeshLin::calcNormals(void)
 	m_norms_valid = true;
 }
 //---------------------------------------------------------------------------
+// cotangent Laplacian in compressed rows over the node neighbors, the
+// diagonal first in each row: positive semidefinite, val = -(cot a +
+// cot b) / 2 off the diagonal. mass gets a third of the element areas.
+// the rows are independent and assembled in parallel.
+void
+TriMeshLin::cotanLaplacian(vector<unsigned int> &start,
+			   vector<unsigned int> &col, vector<double> &val,
+			   vector<double> *mass)
+{
+	int nn = m_numverts;
+
+	if (m_nface.empty())
+		calcNeighbors();
+
+	start.resize(nn + 1);
+	start[0] = 0;
+	for (int v = 0; v < nn; v++)
+		start[v + 1] = start[v] + 1 + getNodeNbrs(v).count();
+	col.resize(start[nn]);
+	val.assign(start[nn], 0.0);
+	if (mass)
+		mass->assign(nn, 0.0);
+
+#pragma omp parallel for schedule(static)
+	for (int v = 0; v < nn; v++) {
+		Neighbor &nb = getNodeNbrs(v);
+		Neighbor &nf = getFaceNbrs(v);
+		unsigned int r = start[v];
+		const Point3 &p = m_verts[v];
+		double area = 0;
+
+		col[r] = v;
+		for (int n = 0; n < nb.count(); n++)
+			col[r + 1 + n] = nb[n];
+
+		for (int k = 0; k < nf.count(); k++) {
+			const unsigned int *u = &m_tris[3 * nf[k]];
+			int m = (u[0] == (unsigned int) v) ? 0 :
+				(u[1] == (unsigned int) v) ? 1 : 2;
+			unsigned int j = u[(m + 1) % 3], l = u[(m + 2) % 3];
+			const Point3 &pj = m_verts[j], &pl = m_verts[l];
+			double s = Cross(pj - p, pl - p).length();
+
+			area += s / 6;
+			if (s == 0)
+				continue;
+
+			// the angle at l faces edge v - j, the one at j v - l
+			double wj = (p - pl).dot(pj - pl) / s / 2;
+			double wl = (p - pj).dot(pl - pj) / s / 2;
+			for (unsigned int q = r + 1; q < start[v + 1]; q++) {
+				if (col[q] == j)
+					val[q] -= wj;
+				else if (col[q] == l)
+					val[q] -= wl;
+			}
+			val[r] += wj + wl;
+		}
+		if (mass)
+			(*mass)[v] = area;
+	}
+}
+//---------------------------------------------------------------------------
 float
 TriMeshLin::calcPhi(int i, int j)
 {
@@ -2099,6 +2635,7 @@ TriMeshLin::classifyFaces(void)
 		histog[pos] = 0;
 		m_fsizes.push_back(max);
 	}
+	invalidateTopology();
 
 	clearEdges();
 	// and reclaculate them
@@ -2173,6 +2710,7 @@ TriMeshLin::moveMesh(double dx, double dy, double dz)
 		m_verts[n] += Point3(dx, dy, dz);
 
         calcLimits();
+	m_version++;
 }
 //---------------------------------------------------------------------------
 void
@@ -2195,21 +2733,29 @@ int
 TriMeshLin::removeSmallEdges(double etresh)
 {
 	unsigned int ns = m_numtris;
-	int modified;
-	unsigned int start = 0;
-
-	do {
-		modified = 0;
-		for (EdgeIter it(*this); it.value(); it.next()) {
-			Edge *e = it.value();
-			Point3 p(getVertex(e->node1));
-			p -= getVertex(e->node2);
-			if (p.length() < etresh)
-				modified += collapseEdge(e);
-			if (modified)
-				break;
-		}
-	} while(modified);
+	cqueue_t q;
+
+	for (EdgeIter it(*this); it.value(); it.next())
+		pushEdgeCand(q, it.value(), etresh);
+
+	while (!q.empty()) {
+		CollapseCand c = q.top();
+		q.pop();
+
+		Edge *e = getEdge(c.v[0], c.v[1]);
+		if (e == NULL || e->nelem == 0)
+			continue;
+		if ((m_verts[c.v[0]] - m_verts[c.v[1]]).length() != c.score)
+			continue;
+		if (!collapseEdge(e))
+			continue;
+
+		// node1 (lower index) survives the collapse
+		unsigned int v = c.v[0] < c.v[1] ? c.v[0] : c.v[1];
+		Neighbor &nb = getNodeNbrs(v);
+		for (int n = 0; n < nb.count(); n++)
+			pushEdgeCand(q, getEdge(v, nb[n]), etresh);
+	}
 
 	if (ns != m_numtris)
 		calcNormals();
@@ -2223,47 +2769,31 @@ int
 TriMeshLin::removeBadAspectElements(double atresh)
 {
 	unsigned int ns = m_numtris;
-	int modified;
-	unsigned int start = 0;
-
-	do {
-		modified = 0;
-		for (unsigned int n = start; n < m_numtris; n++) {
-			unsigned int *u = &m_tris[3 * n];
-			double d1 = (m_verts[u[0]] - m_verts[u[1]]).length();
-			double d2 = (m_verts[u[0]] - m_verts[u[2]]).length();
-			double d3 = (m_verts[u[1]] - m_verts[u[2]]).length();
-			double dmin, dmax;
-
-			if (d2 > d1) {
-				dmin = d1;
-				dmax = d2;
-			} else {
-				dmin = d2;
-				dmax = d1;
-			}
+	cqueue_t q;
+	int emin;
 
-			if (d3 > dmax)
-				dmax = d3;
-			else if (d3 < dmin)
-				dmin = d3;
+	for (unsigned int n = 0; n < m_numtris; n++)
+		pushElemCand(q, n, elemAspect(n, emin), atresh);
 
-			// correctly handles the 0/0 case
-			if (dmin > atresh * dmax)
-				continue;
+	while (!q.empty()) {
+		CollapseCand c = q.top();
+		q.pop();
 
-			if (dmin == d1)
-				modified += collapseEdge(u[0], u[1]);
-			else if (dmin == d2)
-				modified += collapseEdge(u[0], u[2]);
-			else
-				modified += collapseEdge(u[1], u[2]);
-			if (modified) {
-				start = (n > 10) ? n - 10 : 0;
-				break;
-			}
-		}
-	} while(modified);
+		int f = findElem(c.v[0], c.v[1], c.v[2]);
+		if (f < 0 || elemAspect(f, emin) != c.score)
+			continue;
+
+		// collapse the shortest edge, node1 survives
+		unsigned int *u = &m_tris[3 * f];
+		unsigned int v1 = u[emin], v2 = u[(emin + 1) % 3];
+		if (!collapseEdge(v1, v2))
+			continue;
+
+		unsigned int v = v1 < v2 ? v1 : v2;
+		Neighbor &nb = getFaceNbrs(v);
+		for (int n = 0; n < nb.count(); n++)
+			pushElemCand(q, nb[n], elemAspect(nb[n], emin), atresh);
+	}
 
 	if (ns != m_numtris)
 		calcNormals();
@@ -2277,75 +2807,1510 @@ int
 TriMeshLin::removeSmallElements(double size)
 {
 	unsigned int ns = m_numtris;
-	unsigned int start = 0;
-	int modified;
-
-	do {
-		modified = 0;
-		for (unsigned int n = start; n < m_numtris; n++) {
-			unsigned int *u = &m_tris[3 * n];
-			double d1 = (m_verts[u[0]] - m_verts[u[1]]).length();
-			double d2 = (m_verts[u[0]] - m_verts[u[2]]).length();
-			double d3 = (m_verts[u[1]] - m_verts[u[2]]).length();
-			double dmin, dmax;
-
-			dmax = (d2 > d1) ? d2 : d1;
-			dmax = (d3 > dmax) ? d3 : dmax;
-
-			dmin = (d2 > d1) ? d1 : d2;
-			dmin = (d3 > dmin) ? dmin : d3;
-
-			// correctly handles the 0/0 case
-			if ((dmax *dmin) > size * size)
-				continue;
+	cqueue_t q;
 
-			collapseElement(n);
-			modified++;
-			start = (n > 10) ? (n - 10) : 0;
-			break;
-		}
-	} while(modified);
+	for (unsigned int n = 0; n < m_numtris; n++)
+		pushElemCand(q, n, elemSize(n), size * size);
+
+	while (!q.empty()) {
+		CollapseCand c = q.top();
+		q.pop();
+
+		int f = findElem(c.v[0], c.v[1], c.v[2]);
+		if (f < 0 || elemSize(f) != c.score)
+			continue;
+
+		// the first vertex survives at the centroid
+		unsigned int v = m_tris[3 * f];
+		collapseElement(f);
+
+		Neighbor &nb = getFaceNbrs(v);
+		for (int n = 0; n < nb.count(); n++)
+			pushElemCand(q, nb[n], elemSize(nb[n]), size * size);
+	}
 
 	calcNormals();
 
 	return ns - m_numtris;
 }
 //---------------------------------------------------------------------------
-// remove the elements with bad aspect ratios (dmin / dmax < tresh)
-// return total number of elements removed
-int
-TriMeshLin::flipElements(void)
+// ratio of the shortest to the longest edge, emin is set to the index
+// of the first vertex of the shortest edge
+double
+TriMeshLin::elemAspect(unsigned int f, int &emin) const
 {
-	int flipped = 0;
-
-	// we need valid normal information
-	calcNormals();
+	const unsigned int *u = &m_tris[3 * f];
+	double d[3], dmin, dmax;
 
-	for (unsigned int n = 0; n < m_numverts; n++) {
-		Edge *en;
-		for (Edge *e = m_edges[n]; e != NULL; e = en) {
-			en = e->next;
-			flipped += checkFlipEdge(e);
+	for (int m = 0; m < 3; m++)
+		d[m] = (m_verts[u[m]] - m_verts[u[(m + 1) % 3]]).length();
+
+	emin = 0;
+	dmin = dmax = d[0];
+	for (int m = 1; m < 3; m++) {
+		if (d[m] < dmin) {
+			dmin = d[m];
+			emin = m;
 		}
+		if (d[m] > dmax)
+			dmax = d[m];
 	}
 
-	return flipped;
+	// correctly handles the 0/0 case
+	return (dmax > 0) ? dmin / dmax : 0;
 }
 //---------------------------------------------------------------------------
-void
-TriMeshLin::collapseElement(unsigned int elem)
+// product of the shortest and longest edge lengths
+double
+TriMeshLin::elemSize(unsigned int f) const
 {
-	unsigned int *eu = &m_tris[3 * elem];
-	unsigned int v[3];
+	const unsigned int *u = &m_tris[3 * f];
+	double d[3], dmin, dmax;
 
-	v[0] = eu[0];
-	v[1] = eu[1];
-	v[2] = eu[2];
+	for (int m = 0; m < 3; m++)
+		d[m] = (m_verts[u[m]] - m_verts[u[(m + 1) % 3]]).length();
+
+	dmin = dmax = d[0];
+	for (int m = 1; m < 3; m++) {
+		if (d[m] < dmin)
+			dmin = d[m];
+		if (d[m] > dmax)
+			dmax = d[m];
+	}
 
-	Edge *e;
+	return dmin * dmax;
+}
+//---------------------------------------------------------------------------
+// returns the element with vertices a, b and c, or -1
+int
+TriMeshLin::findElem(unsigned int a, unsigned int b, unsigned int c)
+{
+	Edge *e = getEdge(a, b);
+	if (e == NULL)
+		return -1;
 
-	MESH_LOG("Collapsing element %d\n", elem);
-	invalidateNormals();
+	for (int n = 0; n < e->nelem; n++) {
+		unsigned int *u = &m_tris[3 * e->elem[n]];
+		if (u[0] == c || u[1] == c || u[2] == c)
+			return e->elem[n];
+	}
+
+	return -1;
+}
+//---------------------------------------------------------------------------
+void
+TriMeshLin::pushElemCand(cqueue_t &q, unsigned int f, double score,
+			 double thresh)
+{
+	if (score > thresh)
+		return;
+
+	CollapseCand c;
+	c.score = score;
+	for (int m = 0; m < 3; m++)
+		c.v[m] = m_tris[3 * f + m];
+	q.push(c);
+}
+//---------------------------------------------------------------------------
+void
+TriMeshLin::pushEdgeCand(cqueue_t &q, Edge *e, double thresh)
+{
+	if (e == NULL || e->nelem == 0)
+		return;
+
+	double len = (m_verts[e->node1] - m_verts[e->node2]).length();
+	if (len >= thresh)
+		return;
+
+	CollapseCand c;
+	c.score = len;
+	c.v[0] = e->node1;
+	c.v[1] = e->node2;
+	c.v[2] = 0;
+	q.push(c);
+}
+//---------------------------------------------------------------------------
+#define QEM_MIN_COS 0.2		// cos of the largest element normal rotation
+#define QEM_BOUNDARY_WEIGHT 1000
+
+// quadrics are stored as the 10 unique coefficients of the symmetric
+// 4x4 matrix: aa ab ac ad bb bc bd cc cd dd
+static void
+addPlaneQuadric(double *q, const Point3 &n, double d, double w)
+{
+	double a = n.getX(), b = n.getY(), c = n.getZ();
+
+	q[0] += w * a * a;
+	q[1] += w * a * b;
+	q[2] += w * a * c;
+	q[3] += w * a * d;
+	q[4] += w * b * b;
+	q[5] += w * b * c;
+	q[6] += w * b * d;
+	q[7] += w * c * c;
+	q[8] += w * c * d;
+	q[9] += w * d * d;
+}
+//---------------------------------------------------------------------------
+static double
+evalQuadric(const double *q, const Point3 &p)
+{
+	double x = p.getX(), y = p.getY(), z = p.getZ();
+	double e = x * (q[0] * x + 2 * (q[1] * y + q[2] * z + q[3])) +
+		   y * (q[4] * y + 2 * (q[5] * z + q[6])) +
+		   z * (q[7] * z + 2 * q[8]) + q[9];
+
+	// rounding may produce small negative errors
+	return (e > 0) ? e : 0;
+}
+//---------------------------------------------------------------------------
+// cost of collapsing v1 -- v2, pos is set to the point minimizing the
+// combined quadric, or to the best of the end and mid points if the
+// quadric is singular (flat or cylindrical neighborhoods)
+double
+TriMeshLin::qemCost(const vector<double> &quad, unsigned int v1,
+		    unsigned int v2, Point3 &pos) const
+{
+	const double *q1 = &quad[10 * v1], *q2 = &quad[10 * v2];
+	double q[10];
+
+	for (int k = 0; k < 10; k++)
+		q[k] = q1[k] + q2[k];
+
+	const Point3 &p1 = m_verts[v1];
+	const Point3 &p2 = m_verts[v2];
+	Point3 mid = (p1 + p2) / 2;
+
+	// cofactors of the upper 3x3 block
+	double c00 = q[4] * q[7] - q[5] * q[5];
+	double c01 = q[2] * q[5] - q[1] * q[7];
+	double c02 = q[1] * q[5] - q[2] * q[4];
+	double det = q[0] * c00 + q[1] * c01 + q[2] * c02;
+	double tr = q[0] + q[4] + q[7];
+
+	if (fabs(det) > 1e-9 * tr * tr * tr) {
+		double c11 = q[0] * q[7] - q[2] * q[2];
+		double c12 = q[1] * q[2] - q[0] * q[5];
+		double c22 = q[0] * q[4] - q[1] * q[1];
+
+		pos.setCoord(-(c00 * q[3] + c01 * q[6] + c02 * q[8]) / det,
+			     -(c01 * q[3] + c11 * q[6] + c12 * q[8]) / det,
+			     -(c02 * q[3] + c12 * q[6] + c22 * q[8]) / det);
+
+		// nearly singular systems may place it far from the edge
+		if ((pos - mid).length2() <= (p1 - p2).length2())
+			return evalQuadric(q, pos);
+	}
+
+	double e1 = evalQuadric(q, p1);
+	double e2 = evalQuadric(q, p2);
+	double em = evalQuadric(q, mid);
+
+	if (em <= e1 && em <= e2) {
+		pos = mid;
+		return em;
+	}
+	if (e1 <= e2) {
+		pos = p1;
+		return e1;
+	}
+	pos = p2;
+	return e2;
+}
+//---------------------------------------------------------------------------
+// returns 1 if v1 -- v2 can be collapsed to pos: the link condition
+// holds, the merged neighbor lists fit and no element is flipped
+int
+TriMeshLin::checkCollapse(unsigned int v1, unsigned int v2, const Point3 &pos)
+{
+	Edge *e = getEdge(v1, v2);
+	if (e == NULL || e->nelem == 0 || e->nelem > 2)
+		return 0;
+
+	Neighbor &nb1 = getNodeNbrs(v1);
+	Neighbor &nb2 = getNodeNbrs(v2);
+	Neighbor &fb1 = getFaceNbrs(v1);
+	Neighbor &fb2 = getFaceNbrs(v2);
+
+	// do not collapse tetrahedra
+	if (nb1.count() <= 3 && nb2.count() <= 3)
+		return 0;
+
+	// an inner edge between two boundary nodes would pinch the surface
+	if (e->nelem == 2 && nb1.count() != fb1.count() &&
+	    nb2.count() != fb2.count())
+		return 0;
+
+	int nc = 0;
+	for (int n = 0; n < nb1.count(); n++)
+		if (nb2.contains(nb1[n]))
+			nc++;
+	if (nc != e->nelem)
+		return 0;
+
+	if (nb1.count() + nb2.count() - nc - 2 >= MAX_NEIGHBOR ||
+	    fb1.count() + fb2.count() - 2 * e->nelem >= MAX_NEIGHBOR)
+		return 0;
+
+	for (int k = 0; k < 2; k++) {
+		unsigned int v = k ? v2 : v1;
+		unsigned int vo = k ? v1 : v2;
+		Neighbor &fb = k ? fb2 : fb1;
+
+		for (int n = 0; n < fb.count(); n++) {
+			const unsigned int *u = &m_tris[3 * fb[n]];
+			if (u[0] == vo || u[1] == vo || u[2] == vo)
+				continue;	// removed by the collapse
+
+			Point3 p[3], n0, n1;
+			for (int m = 0; m < 3; m++)
+				p[m] = m_verts[u[m]];
+			n0.setCross(p[1] - p[0], p[2] - p[0]);
+
+			for (int m = 0; m < 3; m++)
+				if (u[m] == v)
+					p[m] = pos;
+			n1.setCross(p[1] - p[0], p[2] - p[0]);
+
+			double l0 = n0.length(), l1 = n1.length();
+			if (l1 == 0)
+				return 0;
+			if (l0 > 0 && n0.dot(n1) < QEM_MIN_COS * l0 * l1)
+				return 0;
+		}
+	}
+
+	return 1;
+}
+//---------------------------------------------------------------------------
+// scale of the collapse cost from the curvature terms of the nodes
+double
+TriMeshLin::curvWeight(const vector<double> &kw, unsigned int v1,
+		       unsigned int v2)
+{
+	if (kw.empty())
+		return 1;
+	return 1 + (kw[v1] > kw[v2] ? kw[v1] : kw[v2]);
+}
+//---------------------------------------------------------------------------
+void
+TriMeshLin::pushQemCand(cqueue_t &q, const vector<double> &quad,
+			const vector<double> &kw,
+			unsigned int v1, unsigned int v2)
+{
+	Point3 pos;
+	CollapseCand c;
+
+	c.score = qemCost(quad, v1, v2, pos) * curvWeight(kw, v1, v2);
+	c.v[0] = v1;
+	c.v[1] = v2;
+	c.v[2] = 0;
+	q.push(c);
+}
+//---------------------------------------------------------------------------
+// class of each node from the class face ranges. returns the number of
+// classes, or 0 (and class 0 for all nodes) if the ranges are stale
+int
+TriMeshLin::nodeClasses(vector<int> &vclass) const
+{
+	int ncls = getNumClasses();
+	unsigned int sum = 0;
+
+	vclass.assign(m_numverts, 0);
+
+	for (int c = 0; c < ncls; c++)
+		sum += m_fsizes[c];
+	if (ncls == 0 || sum != m_numtris)
+		return 0;
+
+	unsigned int f = 0;
+	for (int c = 0; c < ncls; c++) {
+		for (unsigned int n = 0; n < m_fsizes[c]; n++, f++)
+			for (int m = 0; m < 3; m++)
+				vclass[m_tris[3 * f + m]] = c;
+	}
+
+	return ncls;
+}
+//---------------------------------------------------------------------------
+// clean up after a batch of local edits: drop the unlinked nodes and
+// restore the class ranges from vclass (indexed by the node numbers
+// before the cleanup), keeping the class order. If ncls is 0 the
+// faces are classified again.
+void
+TriMeshLin::finishEdits(const vector<int> &vclass, int ncls)
+{
+	// element classes, before the nodes are renumbered
+	vector<int> fclass(m_numtris);
+	for (unsigned int f = 0; f < m_numtris; f++)
+		fclass[f] = vclass[m_tris[3 * f]];
+
+	processVertices();
+
+	if (ncls > 0) {
+		vector<unsigned int> start(ncls, 0), tris(3 * m_numtris);
+		m_fsizes.assign(ncls, 0);
+		for (unsigned int f = 0; f < m_numtris; f++)
+			m_fsizes[fclass[f]]++;
+		for (int c = 1; c < ncls; c++)
+			start[c] = start[c - 1] + m_fsizes[c - 1];
+		for (unsigned int f = 0; f < m_numtris; f++) {
+			unsigned int d = start[fclass[f]]++;
+			for (int m = 0; m < 3; m++)
+				tris[3 * d + m] = m_tris[3 * f + m];
+		}
+		m_tris.swap(tris);
+
+		clearEdges();
+		calcNeighbors();
+		findEdges();
+	} else {
+		clearEdges();
+		findEdges();
+		classifyFaces();
+	}
+
+	invalidateTopology();
+	calcNormals();
+}
+//---------------------------------------------------------------------------
+// (re)build one tree per class from the current elements
+void
+TriMeshLin::buildClassTrees(vector<MeshBVH *> &bvh, const vector<int> &vclass,
+			    int ncls)
+{
+	vector<vector<unsigned> > elems(ncls);
+
+	for (unsigned int f = 0; f < m_numtris; f++)
+		elems[vclass[m_tris[3 * f]]].push_back(f);
+
+	for (unsigned int k = 0; k < bvh.size(); k++)
+		delete bvh[k];
+	bvh.resize(ncls);
+	for (int c = 0; c < ncls; c++)
+		bvh[c] = new MeshBVH(*this, elems[c]);
+}
+//---------------------------------------------------------------------------
+// returns 1 if the elements around pos after collapsing v1 -- v2 are
+// at least clearance away from the other classes
+int
+TriMeshLin::checkClearance(const vector<MeshBVH *> &bvh, int cls,
+			   unsigned int v1, unsigned int v2,
+			   const Point3 &pos, double clearance)
+{
+	for (int k = 0; k < 2; k++) {
+		unsigned int v = k ? v2 : v1;
+		unsigned int vo = k ? v1 : v2;
+		Neighbor &fb = getFaceNbrs(v);
+
+		for (int n = 0; n < fb.count(); n++) {
+			const unsigned int *u = &m_tris[3 * fb[n]];
+			if (u[0] == vo || u[1] == vo || u[2] == vo)
+				continue;
+
+			const Point3 &a = (u[0] == v) ? pos : m_verts[u[0]];
+			const Point3 &b = (u[1] == v) ? pos : m_verts[u[1]];
+			const Point3 &c = (u[2] == v) ? pos : m_verts[u[2]];
+
+			for (unsigned int m = 0; m < bvh.size(); m++)
+				if ((int) m != cls &&
+				    bvh[m]->nearTriangle(a, b, c, clearance))
+					return 0;
+		}
+	}
+
+	return 1;
+}
+//---------------------------------------------------------------------------
+// quadric error metric simplification (Garland & Heckbert) down to
+// target elements, collapsing the cheapest edges first. With perclass
+// each class is reduced in proportion to its size. A positive clearance
+// rejects collapses that bring the modified elements closer than
+// clearance to the surface of another class.
+// return total number of elements removed
+int
+TriMeshLin::decimate(unsigned int target, int perclass, double clearance,
+		     double curvature)
+{
+	unsigned int ns = m_numtris;
+
+	if (target >= m_numtris)
+		return 0;
+
+	vector<int> vclass;
+	int ncls = nodeClasses(vclass);
+	bool classified = (ncls > 0);
+	if (!classified)
+		ncls = 1;
+
+	vector<unsigned int> ccount(ncls), ctarget(ncls, 0);
+	if (classified) {
+		for (int c = 0; c < ncls; c++)
+			ccount[c] = m_fsizes[c];
+	} else
+		ccount[0] = m_numtris;
+
+	if (perclass) {
+		for (int c = 0; c < ncls; c++) {
+			ctarget[c] = (unsigned int) ((double) target *
+					ccount[c] / m_numtris + 0.5);
+			if (ctarget[c] < 4)
+				ctarget[c] = 4;
+		}
+	}
+
+	// trees of the class surfaces for the clearance check. They are
+	// rebuilt as the mesh shrinks, so each layer sees the others as
+	// of the last rebuild.
+	vector<MeshBVH *> bvh;
+	unsigned int nbuilt = m_numtris;
+	if (clearance > 0 && ncls > 1)
+		buildClassTrees(bvh, vclass, ncls);
+
+	// area weighted plane quadrics, plus planes perpendicular to the
+	// boundary edges to keep the boundary in place
+	vector<double> quad(10 * m_numverts, 0.0);
+	for (unsigned int f = 0; f < m_numtris; f++) {
+		const unsigned int *u = &m_tris[3 * f];
+		const Point3 &a = m_verts[u[0]];
+		Point3 n;
+
+		n.setCross(m_verts[u[1]] - a, m_verts[u[2]] - a);
+		double area = n.length() / 2;
+		if (area == 0)
+			continue;
+		n /= 2 * area;
+
+		double fq[10] = {0};
+		addPlaneQuadric(fq, n, -n.dot(a), area);
+		for (int m = 0; m < 3; m++)
+			for (int k = 0; k < 10; k++)
+				quad[10 * u[m] + k] += fq[k];
+
+		for (int m = 0; m < 3; m++) {
+			unsigned int p1 = u[m], p2 = u[(m + 1) % 3];
+			Edge *e = getEdge(p1, p2);
+			if (e == NULL || e->nelem != 1)
+				continue;
+
+			Point3 bn;
+			bn.setCross(m_verts[p2] - m_verts[p1], n);
+			double l2 = bn.length2();
+			if (l2 == 0)
+				continue;
+			bn /= sqrt(l2);
+			addPlaneQuadric(&quad[10 * p1], bn,
+					-bn.dot(m_verts[p1]),
+					QEM_BOUNDARY_WEIGHT * l2);
+			addPlaneQuadric(&quad[10 * p2], bn,
+					-bn.dot(m_verts[p1]),
+					QEM_BOUNDARY_WEIGHT * l2);
+		}
+	}
+
+	// optional cost term: the largest principal curvature times the
+	// average edge length, so curved regions keep more elements
+	vector<double> kw;
+	if (curvature > 0) {
+		MeshCurvature mc(*this);
+		mc.update();
+
+		double len = 0;
+		unsigned int ne = 0;
+		for (EdgeIter it(*this); it.value(); it.next(), ne++)
+			len += (m_verts[it.value()->node1] -
+				m_verts[it.value()->node2]).length();
+		if (ne)
+			len /= ne;
+
+		kw.resize(m_numverts);
+		for (unsigned int v = 0; v < m_numverts; v++)
+			kw[v] = curvature * mc.maxAbs(v) * len;
+	}
+
+	cqueue_t q;
+	for (EdgeIter it(*this); it.value(); it.next())
+		pushQemCand(q, quad, kw, it.value()->node1,
+			    it.value()->node2);
+
+	int ncollapse = 0;
+	while (!q.empty()) {
+		if (!perclass && m_numtris <= target)
+			break;
+
+		CollapseCand c = q.top();
+		q.pop();
+
+		unsigned int v1 = c.v[0], v2 = c.v[1];
+		int cls = vclass[v1];
+		if (perclass && ccount[cls] <= ctarget[cls])
+			continue;
+
+		Edge *e = getEdge(v1, v2);
+		if (e == NULL || e->nelem == 0)
+			continue;
+
+		Point3 pos;
+		if (qemCost(quad, v1, v2, pos) * curvWeight(kw, v1, v2) !=
+		    c.score)
+			continue;
+		if (!checkCollapse(v1, v2, pos))
+			continue;
+
+		if (bvh.size()) {
+			if (m_numtris < nbuilt - nbuilt / 16) {
+				buildClassTrees(bvh, vclass, ncls);
+				nbuilt = m_numtris;
+			}
+			if (!checkClearance(bvh, cls, v1, v2, pos, clearance))
+				continue;
+		}
+
+		unsigned int ne = e->nelem;
+		if (!collapseEdge(e, &pos))
+			continue;
+		ccount[cls] -= ne;
+		ncollapse++;
+
+		// node1 (lower index) survives the collapse
+		unsigned int v = v1 < v2 ? v1 : v2;
+		unsigned int vd = v1 < v2 ? v2 : v1;
+		for (int k = 0; k < 10; k++)
+			quad[10 * v + k] += quad[10 * vd + k];
+		if (kw.size() && kw[vd] > kw[v])
+			kw[v] = kw[vd];
+
+		Neighbor &nb = getNodeNbrs(v);
+		for (int n = 0; n < nb.count(); n++)
+			pushQemCand(q, quad, kw, v, nb[n]);
+	}
+
+	for (unsigned int k = 0; k < bvh.size(); k++)
+		delete bvh[k];
+
+	MESH_LOG("Decimation: %d edges collapsed, %d -> %d elements\n",
+		 ncollapse, ns, m_numtris);
+
+	if (ns == m_numtris)
+		return 0;
+
+	finishEdits(vclass, classified ? ncls : 0);
+
+	return ns - m_numtris;
+}
+//---------------------------------------------------------------------------
+// exchange the slots of elements p and q, updating their adjacency
+void
+TriMeshLin::swapElems(unsigned int p, unsigned int q)
+{
+	if (p == q)
+		return;
+
+	unsigned int *up = &m_tris[3 * p], *uq = &m_tris[3 * q];
+	unsigned int nodes[6];
+	int nn = 0;
+
+	// the nodes and edges of both elements, each visited once
+	for (int m = 0; m < 6; m++) {
+		unsigned int v = (m < 3) ? up[m] : uq[m - 3];
+		int k;
+		for (k = 0; k < nn; k++)
+			if (nodes[k] == v)
+				break;
+		if (k == nn)
+			nodes[nn++] = v;
+	}
+
+	for (int k = 0; k < nn; k++) {
+		Neighbor &fb = getFaceNbrs(nodes[k]);
+		for (int n = 0; n < fb.count(); n++) {
+			if (fb[n] == (int) p)
+				fb[n] = q;
+			else if (fb[n] == (int) q)
+				fb[n] = p;
+		}
+
+		for (int j = k + 1; j < nn; j++) {
+			Edge *e = getEdge(nodes[k], nodes[j]);
+			if (e == NULL)
+				continue;
+			for (int n = 0; n < e->nelem; n++) {
+				if (e->elem[n] == p)
+					e->elem[n] = q;
+				else if (e->elem[n] == q)
+					e->elem[n] = p;
+			}
+		}
+	}
+
+	for (int m = 0; m < 3; m++) {
+		unsigned int t = up[m];
+		up[m] = uq[m];
+		uq[m] = t;
+	}
+
+	if (m_fnorms_valid) {
+		Point3 t = m_fnorms[p];
+		m_fnorms[p] = m_fnorms[q];
+		m_fnorms[q] = t;
+	}
+}
+//---------------------------------------------------------------------------
+// move the elements appended after nt0 into the range of their class,
+// src[t - nt0] for element t. The class ranges of the first nt0
+// elements must be valid. Each element shifts the ranges of the
+// following classes by one swap per class.
+void
+TriMeshLin::placeElems(unsigned int nt0, const vector<int> &src)
+{
+	int ncls = getNumClasses();
+	vector<unsigned int> start(ncls + 1, 0);
+
+	for (int c = 0; c < ncls; c++)
+		start[c + 1] = start[c] + m_fsizes[c];
+
+	for (unsigned int t = nt0; t < m_numtris && ncls > 0; t++) {
+		int c = src[t - nt0];
+		unsigned int p = t;
+		for (int k = ncls - 1; k > c; k--) {
+			swapElems(p, start[k]);
+			p = start[k]++;
+		}
+		start[ncls]++;
+		m_fsizes[c]++;
+	}
+}
+//---------------------------------------------------------------------------
+// class of element f during splitEdges: elements below nt0 are in the
+// class ranges given by start, the rest are looked up in src
+int
+TriMeshLin::elemClass(const vector<unsigned int> &start,
+		      const vector<int> &src, unsigned int nt0, unsigned int f)
+{
+	if (f >= nt0)
+		return src[f - nt0];
+
+	int c = 0;
+	while (c < (int) start.size() - 2 && f >= start[c + 1])
+		c++;
+	return c;
+}
+//---------------------------------------------------------------------------
+// split the edges nodes[2i] -- nodes[2i+1] at pos[i]. Each split reuses
+// the slots of the elements on the edge and appends their second
+// halves. Edges that share no elements are split in parallel, taking
+// the new nodes and elements from atomic counters. The adjacency is
+// then patched for the split elements only. Edges sharing elements
+// with an edge split in the same round wait for the next round.
+//
+// Afterwards, new edges joining an old node to a new one are flipped
+// if that connects two new nodes, so that elements with all edges split
+// are divided into four similar elements. If the class ranges are
+// valid, the new elements are moved into the range of their class.
+//
+// vnew[i] is set to the new node of edge i, or -1 if it was not split.
+// returns the number of edges split
+int
+TriMeshLin::splitEdges(const vector<unsigned int> &nodes,
+		       const vector<Point3> &pos, vector<int> *vnew)
+{
+	int ne = pos.size();
+	unsigned int nv0 = m_numverts, nt0 = m_numtris;
+	vector<char> pending(ne, 1);
+	vector<unsigned int> flips;	// new edges to check for flipping
+	vector<int> src;		// class of the appended elements
+	vector<char> used;		// elements split in this round
+	vector<int> grow;		// neighbors gained in this round
+	vector<unsigned int> touched;
+	vector<unsigned int> start;	// first element of each class
+	int nsplit = 0;
+
+	if (vnew)
+		vnew->assign(ne, -1);
+
+	int ncls = getNumClasses();
+	unsigned int sum = 0;
+	for (int c = 0; c < ncls; c++)
+		sum += m_fsizes[c];
+	if (sum != m_numtris)
+		ncls = 0;
+
+	start.assign(ncls + 1, 0);
+	for (int c = 0; c < ncls; c++)
+		start[c + 1] = start[c] + m_fsizes[c];
+
+	for (;;) {
+		vector<int> sel;
+		unsigned int nused = 0;
+
+		used.resize(m_numtris, 0);
+		grow.resize(m_numverts, 0);
+		for (unsigned int n = 0; n < touched.size(); n++)
+			grow[touched[n]] = 0;
+		touched.clear();
+
+		for (int i = 0; i < ne; i++) {
+			if (!pending[i])
+				continue;
+
+			Edge *e = getEdge(nodes[2 * i], nodes[2 * i + 1]);
+			if (e == NULL || e->nelem == 0) {
+				pending[i] = 0;
+				continue;
+			}
+
+			int n, avail = 1, room = 1;
+			for (n = 0; n < e->nelem && avail; n++)
+				avail = !used[e->elem[n]];
+			if (!avail)
+				continue;
+
+			// the opposite nodes gain a neighbor per split
+			for (n = 0; n < e->nelem && room; n++) {
+				const unsigned int *u = &m_tris[3 * e->elem[n]];
+				for (int m = 0; m < 3; m++) {
+					if (u[m] == e->node1 || u[m] == e->node2)
+						continue;
+					int g = grow[u[m]] + 1;
+					if (getNodeNbrs(u[m]).count() + g >
+					    MAX_NEIGHBOR ||
+					    getFaceNbrs(u[m]).count() + g >
+					    MAX_NEIGHBOR)
+						room = 0;
+				}
+			}
+			if (!room) {
+				pending[i] = 0;
+				continue;
+			}
+
+			for (n = 0; n < e->nelem; n++) {
+				const unsigned int *u = &m_tris[3 * e->elem[n]];
+				used[e->elem[n]] = 1;
+				nused++;
+				for (int m = 0; m < 3; m++)
+					if (u[m] != e->node1 && u[m] != e->node2 &&
+					    grow[u[m]]++ == 0)
+						touched.push_back(u[m]);
+			}
+			sel.push_back(i);
+			pending[i] = 0;
+		}
+
+		if (sel.empty())
+			break;
+
+		int nsel = sel.size();
+		unsigned int nv = m_numverts, nt = m_numtris;
+
+		m_numverts += nsel;
+		m_verts.resize(m_numverts);
+		m_norms.resize(m_numverts);
+		m_nflags.resize(m_numverts);
+		m_edges.resize(m_numverts);
+		m_nnode.resize(m_numverts);
+		m_nface.resize(m_numverts);
+		m_tris.resize(3 * (nt + nused));
+		src.resize(nt + nused - nt0);
+
+		// per split: new node, then (f, g, a, b, o) per element
+		vector<unsigned int> rec(nsel * (1 + 5 * MAX_EDGE_ELEM));
+		vector<int> recn(nsel);
+		unsigned int vcnt = 0, tcnt = 0;
+
+#pragma omp parallel for schedule(dynamic, 64)
+		for (int k = 0; k < nsel; k++) {
+			int i = sel[k];
+			unsigned int *r = &rec[k * (1 + 5 * MAX_EDGE_ELEM)];
+			unsigned int v, t;
+			const Edge *e = getEdge(nodes[2 * i], nodes[2 * i + 1]);
+
+#pragma omp atomic capture
+			v = vcnt++;
+			v += nv;
+			m_verts[v] = pos[i];
+			r[0] = v;
+			recn[k] = e->nelem;
+
+			for (int n = 0; n < e->nelem; n++) {
+				unsigned int f = e->elem[n];
+				unsigned int *u = &m_tris[3 * f];
+				int j;
+
+				for (j = 0; j < 3; j++)
+					if (u[(j + 2) % 3] != e->node1 &&
+					    u[(j + 2) % 3] != e->node2)
+						break;
+				unsigned int a = u[j], b = u[(j + 1) % 3];
+				unsigned int o = u[(j + 2) % 3];
+
+#pragma omp atomic capture
+				t = tcnt++;
+				t += nt;
+
+				u[0] = a;
+				u[1] = v;
+				u[2] = o;
+				m_tris[3 * t] = v;
+				m_tris[3 * t + 1] = b;
+				m_tris[3 * t + 2] = o;
+				src[t - nt0] = elemClass(start, src, nt0, f);
+
+				unsigned int *s = &r[1 + 5 * n];
+				s[0] = f;
+				s[1] = t;
+				s[2] = a;
+				s[3] = b;
+				s[4] = o;
+			}
+		}
+
+		m_numtris += tcnt;
+
+		// patch the adjacency of the split elements
+		for (int k = 0; k < nsel; k++) {
+			unsigned int *r = &rec[k * (1 + 5 * MAX_EDGE_ELEM)];
+			unsigned int v = r[0];
+			int i = sel[k];
+			unsigned int n1 = nodes[2 * i], n2 = nodes[2 * i + 1];
+
+			delEdge(n1, n2);
+			getNodeNbrs(n1).del(n2);
+			getNodeNbrs(n2).del(n1);
+
+			for (int n = 0; n < recn[k]; n++) {
+				const unsigned int *s = &r[1 + 5 * n];
+				unsigned int f = s[0], g = s[1];
+				unsigned int a = s[2], b = s[3], o = s[4];
+
+				used[f] = 0;
+				delEdgeElem(b, o, f);
+				addEdge(b, o, g);
+				addEdge(a, v, f);
+				addEdge(v, o, f);
+				addEdge(v, o, g);
+				addEdge(v, b, g);
+
+				getFaceNbrs(b).del(f);
+				getFaceNbrs(b).add(g);
+				getFaceNbrs(o).add(g);
+				getFaceNbrs(v).add(f);
+				getFaceNbrs(v).add(g);
+
+				getNodeNbrs(v).add(a);
+				getNodeNbrs(v).add(b);
+				getNodeNbrs(v).add(o);
+				getNodeNbrs(a).add(v);
+				getNodeNbrs(b).add(v);
+				getNodeNbrs(o).add(v);
+
+				if (o < nv0) {
+					flips.push_back(v);
+					flips.push_back(o);
+				}
+			}
+
+			if (vnew)
+				(*vnew)[i] = v;
+		}
+
+		nsplit += nsel;
+	}
+
+	if (nsplit == 0)
+		return 0;
+
+	m_fnorms.resize(m_numtris);
+	invalidateTopology();
+
+	for (unsigned int n = 0; n < flips.size(); n += 2) {
+		Edge *e = getEdge(flips[n], flips[n + 1]);
+		if (e == NULL || e->nelem != 2)
+			continue;
+		if (elemClass(start, src, nt0, e->elem[0]) !=
+		    elemClass(start, src, nt0, e->elem[1]))
+			continue;
+
+		int nnew = 0;
+		for (int k = 0; k < 2; k++) {
+			const unsigned int *u = &m_tris[3 * e->elem[k]];
+			for (int m = 0; m < 3; m++)
+				if (u[m] != e->node1 && u[m] != e->node2 &&
+				    u[m] >= nv0)
+					nnew++;
+		}
+		if (nnew == 2)
+			flipEdge(e);
+	}
+
+	if (ncls > 0)
+		placeElems(nt0, src);
+
+	return nsplit;
+}
+//---------------------------------------------------------------------------
+// stencil of the even (old) node v in a subdivision step. Fills idx and
+// w when they are not NULL and returns the number of entries. Boundary
+// nodes use the cubic B-spline rule of the boundary curve (Loop) or
+// stay fixed (sqrt3), nodes on non-manifold edges always stay fixed.
+int
+TriMeshLin::evenStencil(unsigned int v, int scheme,
+			unsigned int *idx, double *w)
+{
+	Neighbor &nb = getNodeNbrs(v);
+	unsigned int bnd[2];
+	int n = 0, nbnd = 0, fixed = (scheme == SUBDIV_MIDPOINT);
+
+	for (int k = 0; k < nb.count() && !fixed; k++) {
+		Edge *e = getEdge(v, nb[k]);
+		if (e == NULL || e->nelem == 0)
+			continue;
+		n++;
+		if (e->nelem > 2)
+			fixed = 1;
+		else if (e->nelem == 1 && nbnd++ < 2)
+			bnd[nbnd - 1] = nb[k];
+	}
+
+	if (n == 0 || (nbnd != 0 && nbnd != 2) ||
+	    (nbnd == 2 && scheme != SUBDIV_LOOP))
+		fixed = 1;
+
+	if (fixed) {
+		if (idx) {
+			idx[0] = v;
+			w[0] = 1;
+		}
+		return 1;
+	}
+
+	if (nbnd == 2) {
+		if (idx) {
+			idx[0] = v;
+			w[0] = 0.75;
+			idx[1] = bnd[0];
+			w[1] = 0.125;
+			idx[2] = bnd[1];
+			w[2] = 0.125;
+		}
+		return 3;
+	}
+
+	if (idx == NULL)
+		return n + 1;
+
+	// Warren's weights for Loop, Kobbelt's smoothing for sqrt3
+	double b;
+	if (scheme == SUBDIV_LOOP)
+		b = (n == 3) ? 3.0 / 16 : 3.0 / (8.0 * n);
+	else
+		b = (4 - 2 * cos(2 * M_PI / n)) / (9.0 * n);
+
+	idx[0] = v;
+	w[0] = 1 - n * b;
+	int m = 1;
+	for (int k = 0; k < nb.count(); k++) {
+		Edge *e = getEdge(v, nb[k]);
+		if (e == NULL || e->nelem == 0)
+			continue;
+		idx[m] = nb[k];
+		w[m++] = b;
+	}
+
+	return m;
+}
+//---------------------------------------------------------------------------
+// one level of subdivision. The stencils of all nodes of the refined
+// mesh are collected in compressed rows (soff, sidx, sw) and applied in
+// parallel. The elements of element f are written to 4f .. 4f+3
+// (3f .. 3f+2 for sqrt3) so the class ranges are only scaled.
+void
+TriMeshLin::subdivideLevel(int scheme)
+{
+	unsigned int nv = m_numverts, nt = m_numtris;
+	vector<Edge *> elist;
+
+	// number the edges, their new node is nv + store
+	for (unsigned int v = 0; v < nv; v++) {
+		for (Edge *e = m_edges[v]; e != NULL; e = e->next) {
+			if (e->nelem == 0) {
+				e->store = UINT_MAX;
+				continue;
+			}
+			e->store = elist.size();
+			elist.push_back(e);
+		}
+	}
+
+	int sqrt3 = (scheme == SUBDIV_SQRT3);
+	unsigned int ne = elist.size();
+	unsigned int nnv = nv + (sqrt3 ? nt : ne);
+	unsigned int nnt = (sqrt3 ? 3 : 4) * nt;
+	vector<unsigned int> soff(nnv + 1);
+
+#pragma omp parallel for schedule(dynamic, 1024)
+	for (int i = 0; i < (int) nnv; i++) {
+		if (i < (int) nv)
+			soff[i + 1] = evenStencil(i, scheme, NULL, NULL);
+		else if (sqrt3)
+			soff[i + 1] = 3;
+		else if (scheme == SUBDIV_LOOP && elist[i - nv]->nelem == 2)
+			soff[i + 1] = 4;
+		else
+			soff[i + 1] = 2;
+	}
+
+	soff[0] = 0;
+	for (unsigned int i = 0; i < nnv; i++)
+		soff[i + 1] += soff[i];
+
+	vector<unsigned int> sidx(soff[nnv]);
+	vector<double> sw(soff[nnv]);
+
+#pragma omp parallel for schedule(dynamic, 1024)
+	for (int i = 0; i < (int) nnv; i++) {
+		unsigned int *idx = &sidx[soff[i]];
+		double *w = &sw[soff[i]];
+
+		if (i < (int) nv) {
+			evenStencil(i, scheme, idx, w);
+		} else if (sqrt3) {
+			for (int m = 0; m < 3; m++) {
+				idx[m] = m_tris[3 * (i - nv) + m];
+				w[m] = 1.0 / 3;
+			}
+		} else {
+			const Edge *e = elist[i - nv];
+			int k = soff[i + 1] - soff[i];
+			idx[0] = e->node1;
+			idx[1] = e->node2;
+			w[0] = w[1] = (k == 4) ? 0.375 : 0.5;
+			for (int n = 0; n < e->nelem && k == 4; n++) {
+				const unsigned int *u = &m_tris[3 * e->elem[n]];
+				for (int m = 0; m < 3; m++) {
+					if (u[m] == e->node1 || u[m] == e->node2)
+						continue;
+					idx[2 + n] = u[m];
+					w[2 + n] = 0.125;
+				}
+			}
+		}
+	}
+
+	vector<Point3> pos(nnv);
+
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < (int) nnv; i++) {
+		Point3 p(0, 0, 0);
+		for (unsigned int k = soff[i]; k < soff[i + 1]; k++)
+			p += sw[k] * m_verts[sidx[k]];
+		pos[i] = p;
+	}
+
+	vector<unsigned int> tris(m_tris.begin(), m_tris.begin() + 3 * nt);
+	capacity(nnt, nnv);
+
+#pragma omp parallel for schedule(static)
+	for (int f = 0; f < (int) nt; f++) {
+		const unsigned int *u = &tris[3 * f];
+		unsigned int c[3];
+
+		if (sqrt3) {
+			// the old edges are flipped to join the face nodes
+			unsigned int *t = &m_tris[9 * f];
+			for (int m = 0; m < 3; m++, t += 3) {
+				unsigned int a = u[m], b = u[(m + 1) % 3];
+				const Edge *e = getEdge(a, b);
+				t[0] = a;
+				if (e->nelem == 2) {
+					unsigned int g = e->elem[0] == (unsigned) f ?
+						e->elem[1] : e->elem[0];
+					t[1] = nv + g;
+				} else
+					t[1] = b;
+				t[2] = nv + f;
+			}
+			continue;
+		}
+
+		for (int m = 0; m < 3; m++)
+			c[m] = nv + getEdge(u[m], u[(m + 1) % 3])->store;
+
+		unsigned int *t = &m_tris[12 * f];
+		t[0] = u[0]; t[1] = c[0]; t[2] = c[2];
+		t[3] = c[0]; t[4] = u[1]; t[5] = c[1];
+		t[6] = c[2]; t[7] = c[1]; t[8] = u[2];
+		t[9] = c[0]; t[10] = c[1]; t[11] = c[2];
+	}
+
+	clearEdges();
+
+	m_numverts = nnv;
+	m_numtris = nnt;
+	m_verts.swap(pos);
+	m_norms.resize(nnv);
+	m_nflags.resize(nnv);
+	m_edges.resize(nnv);
+	for (unsigned int c = 0; c < m_fsizes.size(); c++)
+		m_fsizes[c] *= (sqrt3 ? 3 : 4);
+
+	findEdges();
+	calcNeighbors();
+	invalidateTopology();
+}
+//---------------------------------------------------------------------------
+// refine the mesh by the given number of subdivision levels. Each Loop
+// or midpoint level splits every element into four, each sqrt3 level
+// into three. The class grouping of the elements is kept.
+// returns the number of elements
+int
+TriMeshLin::subdivide(int levels, int scheme)
+{
+	if (levels < 0 || scheme < SUBDIV_MIDPOINT || scheme > SUBDIV_SQRT3)
+		return -1;
+
+	unsigned int sum = 0;
+	for (unsigned int c = 0; c < m_fsizes.size(); c++)
+		sum += m_fsizes[c];
+	int valid = (sum == m_numtris);
+
+	findEdges();
+	for (int n = 0; n < levels; n++) {
+		subdivideLevel(scheme);
+		MESH_LOG("Subdivision level %d: %d elements, %d nodes\n",
+			 n + 1, m_numtris, m_numverts);
+	}
+
+	// the ranges were stale before, find the classes again
+	if (!valid)
+		classifyFaces();
+
+	calcNormals();
+
+	return m_numtris;
+}
+//---------------------------------------------------------------------------
+// collects the edges with min <= length < max
+void
+TriMeshLin::edgesByLength(vector<CollapseCand> &cand, double min, double max)
+{
+	cand.clear();
+
+#pragma omp parallel
+	{
+		vector<CollapseCand> local;
+
+#pragma omp for schedule(static) nowait
+		for (int n = 0; n < (int) m_numverts; n++) {
+			for (Edge *e = m_edges[n]; e != NULL; e = e->next) {
+				if (e->nelem == 0)
+					continue;
+				double l = (m_verts[e->node1] -
+					    m_verts[e->node2]).length();
+				if (l < min || l >= max)
+					continue;
+				CollapseCand c;
+				c.score = l;
+				c.v[0] = e->node1;
+				c.v[1] = e->node2;
+				c.v[2] = 0;
+				local.push_back(c);
+			}
+		}
+#pragma omp critical
+		cand.insert(cand.end(), local.begin(), local.end());
+	}
+}
+//---------------------------------------------------------------------------
+// split the edges longer than hi at their midpoints, longest first,
+// until none is left. vclass is extended for the new nodes.
+int
+TriMeshLin::remeshSplit(vector<int> &vclass, double hi)
+{
+	int nsplit = 0;
+
+	for (;;) {
+		vector<CollapseCand> cand;
+		int ns = nsplit;
+
+		edgesByLength(cand, hi, DBL_MAX);
+		// decreasing length, also makes the order deterministic
+		sort(cand.begin(), cand.end());
+
+		vector<unsigned int> nodes(2 * cand.size());
+		vector<Point3> mid(cand.size());
+		vector<int> vnew;
+
+		for (unsigned int n = 0; n < cand.size(); n++) {
+			nodes[2 * n] = cand[n].v[0];
+			nodes[2 * n + 1] = cand[n].v[1];
+			mid[n] = (m_verts[cand[n].v[0]] + m_verts[cand[n].v[1]]) / 2;
+		}
+
+		nsplit += splitEdges(nodes, mid, &vnew);
+		if (nsplit == ns)
+			break;
+
+		vclass.resize(m_numverts);
+		for (unsigned int n = 0; n < cand.size(); n++)
+			if (vnew[n] >= 0)
+				vclass[vnew[n]] = vclass[cand[n].v[0]];
+	}
+
+	return nsplit;
+}
+//---------------------------------------------------------------------------
+// collapse the edges shorter than lo into their midpoints, shortest
+// first, unless that would create edges longer than hi
+int
+TriMeshLin::remeshCollapse(double lo, double hi)
+{
+	vector<CollapseCand> cand;
+	int ncollapse = 0;
+
+	edgesByLength(cand, 0, lo);
+	cqueue_t q(cand.begin(), cand.end());
+
+	while (!q.empty()) {
+		CollapseCand c = q.top();
+		q.pop();
+
+		unsigned int v1 = c.v[0], v2 = c.v[1];
+		Edge *e = getEdge(v1, v2);
+		if (e == NULL || e->nelem == 0)
+			continue;
+		if ((m_verts[v1] - m_verts[v2]).length() != c.score)
+			continue;
+
+		Point3 pos = (m_verts[v1] + m_verts[v2]) / 2;
+		int ok = 1;
+		for (int k = 0; k < 2 && ok; k++) {
+			Neighbor &nb = getNodeNbrs(k ? v2 : v1);
+			for (int n = 0; n < nb.count() && ok; n++)
+				if ((m_verts[nb[n]] - pos).length() > hi)
+					ok = 0;
+		}
+		if (!ok || !checkCollapse(v1, v2, pos))
+			continue;
+		if (!collapseEdge(e, &pos))
+			continue;
+		ncollapse++;
+
+		// node1 (lower index) survives the collapse
+		unsigned int v = v1 < v2 ? v1 : v2;
+		Neighbor &nb = getNodeNbrs(v);
+		for (int n = 0; n < nb.count(); n++)
+			pushEdgeCand(q, getEdge(v, nb[n]), lo);
+	}
+
+	return ncollapse;
+}
+//---------------------------------------------------------------------------
+// returns 1 if flipping e brings the valences of the four nodes closer
+// to the regular valence (6 inside, 4 on the boundary) without folding
+// the elements
+int
+TriMeshLin::checkValenceFlip(Edge *e)
+{
+	if (e->nelem != 2)
+		return 0;
+
+	unsigned int e1 = e->elem[0], e2 = e->elem[1];
+	unsigned int v[4], p1 = 0, p2 = 0;
+	const unsigned int *l1 = &m_tris[3 * e1], *l2 = &m_tris[3 * e2];
+
+	for (int m = 0; m < 3; m++) {
+		if (l1[m] != e->node1 && l1[m] != e->node2)
+			p1 = l1[m];
+		if (l2[m] != e->node1 && l2[m] != e->node2)
+			p2 = l2[m];
+	}
+	if (p1 == p2 || getEdge(p1, p2) != NULL)
+		return 0;
+
+	v[0] = e->node1;
+	v[1] = e->node2;
+	v[2] = p1;
+	v[3] = p2;
+
+	int before = 0, after = 0;
+	for (int k = 0; k < 4; k++) {
+		int val = getNodeNbrs(v[k]).count();
+		int reg = (val == getFaceNbrs(v[k]).count()) ? 6 : 4;
+		int nval = (k < 2) ? val - 1 : val + 1;
+
+		if (nval < 3 || nval >= MAX_NEIGHBOR ||
+		    getFaceNbrs(v[k]).count() >= MAX_NEIGHBOR - 1)
+			return 0;
+		before += abs(val - reg);
+		after += abs(nval - reg);
+	}
+	if (after >= before)
+		return 0;
+
+	// normals of the elements after the flip, see flipEdge
+	Point3 n1, n2, o1, o2, t[3];
+	for (int m = 0; m < 3; m++)
+		t[m] = m_verts[l1[m] == v[1] ? p2 : l1[m]];
+	n1.setCross(t[1] - t[0], t[2] - t[0]);
+	for (int m = 0; m < 3; m++)
+		t[m] = m_verts[l2[m] == v[0] ? p1 : l2[m]];
+	n2.setCross(t[1] - t[0], t[2] - t[0]);
+
+	o1.setCross(m_verts[l1[1]] - m_verts[l1[0]],
+		    m_verts[l1[2]] - m_verts[l1[0]]);
+	o2.setCross(m_verts[l2[1]] - m_verts[l2[0]],
+		    m_verts[l2[2]] - m_verts[l2[0]]);
+	Point3 o = o1 + o2;
+
+	double ln1 = n1.length(), ln2 = n2.length(), lo = o.length();
+	if (ln1 == 0 || ln2 == 0 || lo == 0)
+		return 0;
+	if (n1.dot(o) < QEM_MIN_COS * ln1 * lo ||
+	    n2.dot(o) < QEM_MIN_COS * ln2 * lo)
+		return 0;
+
+	return 1;
+}
+//---------------------------------------------------------------------------
+int
+TriMeshLin::remeshFlip(void)
+{
+	vector<CollapseCand> cand;
+	int nflip = 0;
+
+	edgesByLength(cand, 0, DBL_MAX);
+	sort(cand.begin(), cand.end());
+
+	for (unsigned int n = 0; n < cand.size(); n++) {
+		Edge *e = getEdge(cand[n].v[0], cand[n].v[1]);
+		if (e == NULL || !checkValenceFlip(e))
+			continue;
+		if (flipEdge(e) == 0)
+			nflip++;
+	}
+
+	return nflip;
+}
+//---------------------------------------------------------------------------
+// move the nodes towards the centroid of their neighbors within the
+// tangent plane, then back onto the reference surface of their class.
+// boundary nodes are kept in place.
+void
+TriMeshLin::remeshRelax(const vector<int> &vclass,
+			const vector<MeshBVH *> &ref)
+{
+	int nv = m_numverts;
+	vector<Point3> pos(m_verts);
+
+	invalidateNormals();
+	calcNormals();
+
+#pragma omp parallel for schedule(dynamic, 256)
+	for (int v = 0; v < nv; v++) {
+		Neighbor &nb = getNodeNbrs(v);
+		int nn = nb.count();
+
+		if (nn == 0 || nn != getFaceNbrs(v).count())
+			continue;
+
+		Point3 c(0, 0, 0);
+		for (int n = 0; n < nn; n++)
+			c += m_verts[nb[n]];
+		c /= nn;
+
+		const Point3 &p = m_verts[v];
+		const Point3 &vn = m_norms[v];
+		Point3 q = c + vn * vn.dot(p - c);
+
+		int cls = ((int) ref.size() > 1) ? vclass[v] : 0;
+		Point3 pi;
+		ref[cls]->nearest(q, -1, &pi);
+		pos[v] = pi;
+	}
+
+	m_verts.swap(pos);
+	invalidateNormals();
+}
+//---------------------------------------------------------------------------
+#define REMESH_HIGH (4.0 / 3.0)
+#define REMESH_LOW (4.0 / 5.0)
+
+// isotropic remeshing (Botsch & Kobbelt) towards the edge length len.
+// Each iteration splits the long edges, collapses the short ones, flips
+// edges to equalize the valences and relaxes the nodes tangentially.
+// The topology is only changed locally and the mesh is cleaned up once
+// at the end.
+int
+TriMeshLin::remesh(double len, int iter)
+{
+	if (len <= 0 || m_numtris == 0)
+		return -1;
+
+	vector<int> vclass;
+	int ncls = nodeClasses(vclass);
+
+	// the input surface of each class, used for projection
+	vector<MeshBVH *> ref;
+	if (ncls > 1) {
+		for (int c = 0; c < ncls; c++)
+			ref.push_back(new MeshBVH(*this, c));
+	} else
+		ref.push_back(new MeshBVH(*this));
+
+	for (int it = 0; it < iter; it++) {
+		int ns = remeshSplit(vclass, len * REMESH_HIGH);
+		int nc = remeshCollapse(len * REMESH_LOW, len * REMESH_HIGH);
+		int nf = remeshFlip();
+		remeshRelax(vclass, ref);
+
+		MESH_LOG("Remesh iteration %d: %d splits, %d collapses, "
+			 "%d flips\n", it + 1, ns, nc, nf);
+	}
+
+	for (unsigned int c = 0; c < ref.size(); c++)
+		delete ref[c];
+
+	finishEdits(vclass, ncls);
+
+	return 0;
+}
+//---------------------------------------------------------------------------
+// remove the elements with bad aspect ratios (dmin / dmax < tresh)
+// return total number of elements removed
+int
+TriMeshLin::flipElements(void)
+{
+	int flipped = 0;
+
+	// we need valid normal information
+	calcNormals();
+
+	for (unsigned int n = 0; n < m_numverts; n++) {
+		Edge *en;
+		for (Edge *e = m_edges[n]; e != NULL; e = en) {
+			en = e->next;
+			flipped += checkFlipEdge(e);
+		}
+	}
+
+	return flipped;
+}
+//---------------------------------------------------------------------------
+void
+TriMeshLin::collapseElement(unsigned int elem)
+{
+	unsigned int *eu = &m_tris[3 * elem];
+	unsigned int v[3];
+
+	v[0] = eu[0];
+	v[1] = eu[1];
+	v[2] = eu[2];
+
+	Edge *e;
+
+	MESH_DEBUG("Collapsing element %d\n", elem);
+	invalidateTopology();
 
 	// first delete neighboring elements
 	e = getEdge(v[0], v[1]);
@@ -2428,17 +4393,18 @@ TriMeshLin::collapseElement(unsigned int elem)
 	// remove nodes v2 and v3
 	unlinkVertex(v[1]);
 	unlinkVertex(v[2]);
-	MESH_LOG("Collapsed one element\n");
+	MESH_DEBUG("Collapsed one element\n");
 }
 //---------------------------------------------------------------------------
+// collapse the edge into node1, which is moved to pos (or the midpoint)
 int
-TriMeshLin::collapseEdge(Edge *e)
+TriMeshLin::collapseEdge(Edge *e, const Point3 *pos)
 {
 	assert(e != NULL);
 	unsigned int v1 = e->node1;
 	unsigned int v2 = e->node2;
 
-	MESH_LOG("Collapsing edge %d -- %d\n", v1, v2);
+	MESH_DEBUG("Collapsing edge %d -- %d\n", v1, v2);
 
 	int nc = 0;
 	for (int n = 0; n < MAX_NEIGHBOR; n++) {
@@ -2457,17 +4423,20 @@ TriMeshLin::collapseEdge(Edge *e)
 	}
 
 	if (nc != e->nelem) {
-		MESH_LOG("Not collapsing edge!\n");
+		MESH_DEBUG("Not collapsing edge!\n");
 		return 0;
 	}
-	invalidateNormals();
+	invalidateTopology();
 
 	// first delete neighboring elements
 	while (e->nelem > 0)
 		delElem(e->elem[0]);
 
 	// move one vertex to mid point of edge
-	m_verts[v1] = (m_verts[v1] + m_verts[v2]) / 2;
+	if (pos)
+		m_verts[v1] = *pos;
+	else
+		m_verts[v1] = (m_verts[v1] + m_verts[v2]) / 2;
 	e = NULL; // will be invalid
 
 	// delete all edges belonging to v1
@@ -2521,7 +4490,7 @@ TriMeshLin::collapseEdge(Edge *e)
 
 	// remove node v2
 	unlinkVertex(v2);
-	MESH_LOG("Collapsed one edge\n");
+	MESH_DEBUG("Collapsed one edge\n");
 
 	return 1;
 }
@@ -2533,9 +4502,9 @@ TriMeshLin::delVertex(unsigned int v)
 	assert(getNodeNbrs(v)[0] == -1);
 
 	unsigned int last = m_numverts - 1;
-	MESH_LOG("Deleting vertex %d, total %d\n", v, last);
+	MESH_DEBUG("Deleting vertex %d, total %d\n", v, last);
 
-	invalidateNormals();
+	invalidateTopology();
 
 	if (v < last) {
 		m_verts[v] = m_verts[last];
@@ -2649,6 +4618,7 @@ TriMeshLin::setElem(unsigned int e, unsigned int i,
 
 	updateFaceNormal(e);
 	invalidateVertexNormals();
+	m_topo_version++;
 }
 //---------------------------------------------------------------------------
 unsigned int
@@ -2685,7 +4655,7 @@ TriMeshLin::changeElem(unsigned int e, unsigned int i,
 	unsigned int last = m_numtris - 1;
 	unsigned int *u = &m_tris[3 * e];
 
-	MESH_LOG("Changing element %d\n", e);
+	MESH_DEBUG("Changing element %d\n", e);
 
 	if (delEdgeElem(u[0], u[1], e) == 0) {
 		getNodeNbrs(u[0]).del(u[1]);
@@ -2741,7 +4711,7 @@ TriMeshLin::delElem(unsigned int e)
 	unsigned int last = m_numtris - 1;
 	// XXX class bacomes bad, need re-classify!
 
-	MESH_LOG("Deleting element %d\n", e);
+	MESH_DEBUG("Deleting element %d\n", e);
 
 	unsigned int *u = &m_tris[3 * e];
 
@@ -2767,12 +4737,39 @@ TriMeshLin::delElem(unsigned int e)
 		addEdge(l[0], l[1], e);
 		addEdge(l[0], l[2], e);
 		addEdge(l[1], l[2], e);
+
+		// the face normals of the remaining elements stay valid
+		if (m_fnorms_valid)
+			m_fnorms[e] = m_fnorms[last];
 	}
 
 	m_numtris--;
 	m_tris.resize(m_numtris * 3);
+	if (m_fnorms.size() > m_numtris)
+		m_fnorms.resize(m_numtris);
 
-	invalidateNormals();
+	invalidateVertexNormals();
+	m_topo_version++;
+}
+//---------------------------------------------------------------------------
+// delete the edges of v that no longer belong to any element
+void
+TriMeshLin::pruneEdges(unsigned int v)
+{
+	Neighbor &nb = getNodeNbrs(v);
+
+	for (int n = 0; n < nb.count(); ) {
+		unsigned int vn = nb[n];
+		Edge *e = getEdge(v, vn);
+		if (e != NULL && e->nelem > 0) {
+			n++;
+			continue;
+		}
+		if (e != NULL)
+			delEdge(v, vn);
+		nb.del(vn);
+		getNodeNbrs(vn).del(v);
+	}
 }
 //---------------------------------------------------------------------------
 int
@@ -2814,11 +4811,11 @@ TriMeshLin::flipEdge(Edge *e)
 	assert (p1 != UINT_MAX && p2 != UINT_MAX);
 
 	if (p1 == p2 || getEdge(p1, p2) != NULL) {
-		MESH_LOG("Not Flipping: %d -- %d\n", n1, n2);
+		MESH_DEBUG("Not Flipping: %d -- %d\n", n1, n2);
 		return (1);
 	}
 
-	MESH_LOG("Flipping: %d -- %d\n", n1, n2);
+	MESH_DEBUG("Flipping: %d -- %d\n", n1, n2);
 
 	// flip element neighbors for p & n
 	getFaceNbrs(n1).del(e2);
@@ -2852,6 +4849,7 @@ TriMeshLin::flipEdge(Edge *e)
 	updateFaceNormal(e1);
 	updateFaceNormal(e2);
 	invalidateVertexNormals();
+	m_topo_version++;
 
 	// replace the edge
 	delEdge(n1, n2);
@@ -2990,7 +4988,7 @@ TriMeshLin::replaceElements(const vector<unsigned> &faces)
 
 	printf("Final number of elements: %d\n", m_numtris);
 
-	invalidateNormals();
+	invalidateTopology();
 
 	clearEdges();
 	findEdges();
@@ -21,6 +21,7 @@
 #ifndef _MESH_H_
 #define _MESH_H_
 #include <list>
+#include <queue>
 #include <vector>
 #include <assert.h>
 #include <stdio.h>
@@ -29,6 +30,13 @@
 
 using namespace std;
 
+class MeshBVH;
+
+// subdivision schemes
+#define SUBDIV_MIDPOINT	0
+#define SUBDIV_LOOP	1
+#define SUBDIV_SQRT3	2
+
 class TriMeshLin {
  public:
 	TriMeshLin();
@@ -46,6 +54,10 @@ class TriMeshLin {
 	int removeSmallElements(double size);
 	int removeSmallEdges(double size);
 	int flipElements(void);
+	int decimate(unsigned int target, int perclass = 0,
+		     double clearance = 0, double curvature = 0);
+	int remesh(double len, int iter = 5);
+	int subdivide(int levels, int scheme = SUBDIV_LOOP);
 
 	void moveMesh(double dx, double dy, double dz);
 	void scaleMesh(double sx, double sy, double sz);
@@ -56,6 +68,13 @@ class TriMeshLin {
 	inline const Point3 &getVertexNormal(int idx)
 	{ if (!m_norms_valid) calcNormals(); return m_norms[idx]; }
 
+	// cached data derived from the mesh is stale if this changed
+	inline unsigned int getVersion(void) const
+		{ return m_version; }
+	// as above, but only for data that depends on the elements
+	inline unsigned int getTopoVersion(void) const
+		{ return m_topo_version; }
+
 	inline const Point3 &getFaceNormal(int idx)
 	{ if (!m_fnorms_valid) calcFaceNorm(); return m_fnorms[idx]; }
 
@@ -147,6 +166,9 @@ class TriMeshLin {
 
 	void calcFaceNorm(void);
 	void calcNormals(void);
+	void cotanLaplacian(vector<unsigned int> &start,
+			    vector<unsigned int> &col, vector<double> &val,
+			    vector<double> *mass = NULL);
 
 	TriMeshLin &set(const TriMeshLin &m);
 
@@ -165,7 +187,14 @@ class TriMeshLin {
 	void replaceElements(const vector<unsigned> &faces);
 
 	int fillHoles(void);
+	int removeDuplicates(double eps, vector<int> *dups = NULL);
 	void delElem(unsigned int e);
+	int findElem(unsigned int a, unsigned int b, unsigned int c);
+	void pruneEdges(unsigned int v);
+	int splitEdges(const vector<unsigned int> &nodes,
+		       const vector<Point3> &pos, vector<int> *vnew = NULL);
+	void swapElems(unsigned int p, unsigned int q);
+	void placeElems(unsigned int nt0, const vector<int> &src);
 	void recalculateEdges(void) {
 		processVertices();
 		clearEdges();
@@ -222,11 +251,56 @@ class TriMeshLin {
 	void unlinkVertex(unsigned int v);
 	int collapseEdge(unsigned int v1, unsigned int v2)
 		{ return collapseEdge(getEdge(v1, v2));}
-	int collapseEdge(Edge *e);
+	int collapseEdge(Edge *e, const Point3 *pos = NULL);
 	void collapseElement(unsigned int elem);
 	int delEdgeElem(unsigned int v1, unsigned int v2, unsigned int elem);
 	int flipEdge(Edge *e);
 	int checkFlipEdge(Edge *e);
+
+	// collapse candidate, ordered by increasing score in cqueue_t.
+	// candidates refer to vertices which stay valid during collapses
+	// (unlike element indices) and are validated when popped.
+	struct CollapseCand {
+		double score;
+		unsigned int v[3];
+		bool operator<(const CollapseCand &c) const
+			{ return score > c.score; }
+	};
+	typedef priority_queue<CollapseCand> cqueue_t;
+
+	double elemAspect(unsigned int f, int &emin) const;
+	double elemSize(unsigned int f) const;
+	void pushElemCand(cqueue_t &q, unsigned int f, double score,
+			  double thresh);
+	void pushEdgeCand(cqueue_t &q, Edge *e, double thresh);
+	double qemCost(const vector<double> &quad, unsigned int v1,
+		       unsigned int v2, Point3 &pos) const;
+	int checkCollapse(unsigned int v1, unsigned int v2, const Point3 &pos);
+	static double curvWeight(const vector<double> &kw, unsigned int v1,
+				 unsigned int v2);
+	void pushQemCand(cqueue_t &q, const vector<double> &quad,
+			 const vector<double> &kw,
+			 unsigned int v1, unsigned int v2);
+	int evenStencil(unsigned int v, int scheme,
+			unsigned int *idx, double *w);
+	void subdivideLevel(int scheme);
+	int nodeClasses(vector<int> &vclass) const;
+	static int elemClass(const vector<unsigned int> &start,
+			     const vector<int> &src, unsigned int nt0,
+			     unsigned int f);
+	void finishEdits(const vector<int> &vclass, int ncls);
+	void edgesByLength(vector<CollapseCand> &cand, double min, double max);
+	int remeshSplit(vector<int> &vclass, double hi);
+	int remeshCollapse(double lo, double hi);
+	int checkValenceFlip(Edge *e);
+	int remeshFlip(void);
+	void remeshRelax(const vector<int> &vclass,
+			 const vector<MeshBVH *> &ref);
+	void buildClassTrees(vector<MeshBVH *> &bvh, const vector<int> &vclass,
+			     int ncls);
+	int checkClearance(const vector<MeshBVH *> &bvh, int cls,
+			   unsigned int v1, unsigned int v2,
+			   const Point3 &pos, double clearance);
 	double nodeAngle(unsigned int n1, unsigned int n2, unsigned int n3);
 
 	void setElem(unsigned int e,
@@ -235,18 +309,30 @@ class TriMeshLin {
 	inline void invalidateNormals(void) {
 		m_fnorms_valid = false;
 		m_norms_valid = false;
+		m_version++;
 	}
 	inline void invalidateVertexNormals(void) {
 		m_norms_valid = false;
+		m_version++;
+	}
+	inline void invalidateTopology(void) {
+		invalidateNormals();
+		m_topo_version++;
 	}
 
 	int generateBoundary(elist_t &elist, elist_t &blist);
 	int isNeighborEdges(Edge *e1, Edge *e2);
 	int isStitchable(Edge *e1, Edge *e2);
 
-	int fillNextPair(elist_t &blist);
 	int stitchNextPair(elist_t &blist, int pv);
 	int stitch(void);
+	int boundaryLoops(vector<unsigned int> &loops,
+			  vector<unsigned int> &start,
+			  vector<unsigned int> &elem);
+	double earAngle(const unsigned int *v, int p, int i, int n,
+			const Point3 &nrm);
+	int fillHole(const unsigned int *v, int n);
+	int weldNodes(double eps, vector<unsigned int> &vmap);
 
 	void print_boundary(const char *hdr, const TriMeshLin::elist_t &blist);
 
@@ -273,6 +359,8 @@ class TriMeshLin {
 	double m_lambda, m_mu;
 	bool m_fnorms_valid;
 	bool m_norms_valid;
+	unsigned int m_version;	// changes with the nodes or elements
+	unsigned int m_topo_version;	// changes with the elements
 
 	friend class EdgeIter;
 };
@@ -30,6 +30,13 @@
 #define MESH_LOG(...) fprintf(stderr, __VA_ARGS__)
 #define MESH_LOG_ADD(...) fprintf(stderr, __VA_ARGS__)
 
+// per-operation tracing, too verbose for bulk edits
+#ifdef MESH_VERBOSE
+#define MESH_DEBUG(...) fprintf(stderr, __VA_ARGS__)
+#else
+#define MESH_DEBUG(...) do { } while (0)
+#endif
+
 
 #define MAX_NEIGHBOR 30
 using namespace std;
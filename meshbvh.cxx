@@ -0,0 +1,717 @@
+/*
+ * Copyright (C) 2014 Can Erkin Acar
+ * Copyright (C) 2014 Zeynep Akalin Acar
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include "meshbvh.h"
+
+#define BVH_LEAF	4
+#define BVH_STACK	64
+#define BVH_EPS		1e-9
+
+// ray directions used by the parity test, chosen to avoid
+// being parallel to the axis aligned parts of typical meshes
+static const double bvh_dirs[][3] = {
+	{ 0.5773502692,  0.5773502692,  0.5773502692},
+	{-0.2672612419,  0.5345224838,  0.8017837257},
+	{ 0.8728715609, -0.2182178902,  0.4364357805},
+	{-0.6246950476, -0.7808688094,  0.0000000000},
+	{ 0.1825741858, -0.3651483717, -0.9128709292}};
+
+#define BVH_NDIRS (sizeof(bvh_dirs) / sizeof(bvh_dirs[0]))
+
+struct BVHCentroidCmp {
+	BVHCentroidCmp(const vector<double> &c, int a) : cent(c), axis(a) {}
+	bool operator()(unsigned a, unsigned b) const {
+		return cent[3 * a + axis] < cent[3 * b + axis];
+	}
+	const vector<double> &cent;
+	int axis;
+};
+
+//---------------------------------------------------------------------------
+MeshBVH::MeshBVH(const TriMeshLin &msh, int cls)
+{
+	int start = 0, count = msh.getNumTris();
+
+	if (cls >= 0) {
+		for (int n = 0; n < cls && n < msh.getNumClasses(); n++)
+			start += msh.getNumTris(n);
+		count = msh.getNumTris(cls);
+	}
+
+	if (count <= 0)
+		return;
+
+	vector<unsigned> elems(count);
+	for (int n = 0; n < count; n++)
+		elems[n] = start + n;
+
+	init(msh, elems);
+}
+//---------------------------------------------------------------------------
+MeshBVH::MeshBVH(const TriMeshLin &msh, const vector<unsigned> &elems)
+{
+	if (!elems.empty())
+		init(msh, elems);
+}
+//---------------------------------------------------------------------------
+void
+MeshBVH::init(const TriMeshLin &msh, const vector<unsigned> &elems)
+{
+	int count = elems.size();
+	vector<double> tris(9 * count), cent(3 * count);
+	vector<unsigned> order(count);
+
+	for (int n = 0; n < count; n++) {
+		order[n] = n;
+		for (int i = 0; i < 3; i++) {
+			const Point3 &p = msh.getElemVert(elems[n], i);
+			tris[9 * n + 3 * i] = p.getX();
+			tris[9 * n + 3 * i + 1] = p.getY();
+			tris[9 * n + 3 * i + 2] = p.getZ();
+		}
+		for (int k = 0; k < 3; k++)
+			cent[3 * n + k] = (tris[9 * n + k] +
+					   tris[9 * n + 3 + k] +
+					   tris[9 * n + 6 + k]) / 3;
+	}
+
+	m_nodes.reserve(2 * count / BVH_LEAF + 1);
+	build(&order[0], 0, count, tris, cent);
+
+	// store the triangles in leaf order
+	m_tris.resize(9 * count);
+	m_elem.resize(count);
+	for (int n = 0; n < count; n++) {
+		unsigned o = order[n];
+		copy(&tris[9 * o], &tris[9 * o] + 9, &m_tris[9 * n]);
+		m_elem[n] = elems[o];
+	}
+}
+//---------------------------------------------------------------------------
+// builds the subtree for triangles order[start .. start + count - 1],
+// the order is rearranged so that each leaf refers to a contiguous range
+int
+MeshBVH::build(unsigned *order, int start, int count,
+	       const vector<double> &tris, const vector<double> &cent)
+{
+	int idx = m_nodes.size();
+	m_nodes.resize(idx + 1);
+
+	Node nd;
+	double cmin[3], cmax[3];
+
+	for (int k = 0; k < 3; k++) {
+		nd.bmin[k] = cmin[k] = DBL_MAX;
+		nd.bmax[k] = cmax[k] = -DBL_MAX;
+	}
+
+	for (int n = start; n < start + count; n++) {
+		const double *t = &tris[9 * order[n]];
+		const double *c = &cent[3 * order[n]];
+		for (int k = 0; k < 3; k++) {
+			for (int i = 0; i < 3; i++) {
+				double v = t[3 * i + k];
+				if (v < nd.bmin[k]) nd.bmin[k] = v;
+				if (v > nd.bmax[k]) nd.bmax[k] = v;
+			}
+			if (c[k] < cmin[k]) cmin[k] = c[k];
+			if (c[k] > cmax[k]) cmax[k] = c[k];
+		}
+	}
+
+	int axis = 0;
+	for (int k = 1; k < 3; k++)
+		if (cmax[k] - cmin[k] > cmax[axis] - cmin[axis])
+			axis = k;
+
+	if (count <= BVH_LEAF || cmax[axis] <= cmin[axis]) {
+		nd.start = start;
+		nd.count = count;
+		m_nodes[idx] = nd;
+		return idx;
+	}
+
+	// median split on the longest centroid axis
+	int mid = count / 2;
+	nth_element(order + start, order + start + mid, order + start + count,
+		    BVHCentroidCmp(cent, axis));
+
+	build(order, start, mid, tris, cent);
+	nd.start = build(order, start + mid, count - mid, tris, cent);
+	nd.count = 0;
+	m_nodes[idx] = nd;
+
+	return idx;
+}
+//---------------------------------------------------------------------------
+int
+MeshBVH::rayBox(const Node &nd, const double *o, const double *inv)
+{
+	double tmin = 0, tmax = DBL_MAX;
+
+	for (int k = 0; k < 3; k++) {
+		double t0 = (nd.bmin[k] - o[k]) * inv[k];
+		double t1 = (nd.bmax[k] - o[k]) * inv[k];
+		if (t0 > t1) {
+			double t = t0;
+			t0 = t1;
+			t1 = t;
+		}
+		if (t0 > tmin) tmin = t0;
+		if (t1 < tmax) tmax = t1;
+		if (tmin > tmax)
+			return 0;
+	}
+
+	return 1;
+}
+//---------------------------------------------------------------------------
+// counts the crossings of the ray o + t * d, t > 0 with the surface.
+// returns the parity of the crossings, or -1 if the ray hits an edge,
+// a vertex, is nearly parallel to a triangle it crosses, or starts on
+// the surface.
+int
+MeshBVH::rayParity(const double *o, const double *d, int &hits) const
+{
+	int stack[BVH_STACK];
+	int sp = 0;
+	double inv[3];
+
+	hits = 0;
+	if (m_nodes.empty())
+		return 0;
+
+	for (int k = 0; k < 3; k++)
+		inv[k] = (d[k] != 0) ? 1 / d[k] : DBL_MAX;
+
+	stack[sp++] = 0;
+	while (sp) {
+		const Node &nd = m_nodes[stack[--sp]];
+
+		if (!rayBox(nd, o, inv))
+			continue;
+
+		if (nd.count == 0) {
+			if (sp + 2 > BVH_STACK)
+				return -1;
+			stack[sp++] = nd.start;
+			stack[sp++] = &nd - &m_nodes[0] + 1;
+			continue;
+		}
+
+		for (int n = nd.start; n < nd.start + nd.count; n++) {
+			const double *a = &m_tris[9 * n];
+			double e1[3], e2[3], s[3], p[3], q[3];
+
+			for (int k = 0; k < 3; k++) {
+				e1[k] = a[3 + k] - a[k];
+				e2[k] = a[6 + k] - a[k];
+				s[k] = o[k] - a[k];
+			}
+
+			p[0] = d[1] * e2[2] - d[2] * e2[1];
+			p[1] = d[2] * e2[0] - d[0] * e2[2];
+			p[2] = d[0] * e2[1] - d[1] * e2[0];
+
+			double det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+			double scale = sqrt((e1[0] * e1[0] + e1[1] * e1[1] +
+					     e1[2] * e1[2]) *
+					    (e2[0] * e2[0] + e2[1] * e2[1] +
+					     e2[2] * e2[2]));
+
+			double u = s[0] * p[0] + s[1] * p[1] + s[2] * p[2];
+
+			q[0] = s[1] * e1[2] - s[2] * e1[1];
+			q[1] = s[2] * e1[0] - s[0] * e1[2];
+			q[2] = s[0] * e1[1] - s[1] * e1[0];
+
+			double v = d[0] * q[0] + d[1] * q[1] + d[2] * q[2];
+			double t = e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2];
+
+			if (fabs(det) <= BVH_EPS * scale) {
+				// parallel: only a problem if the ray
+				// lies in the plane of the triangle
+				double n0 = e1[1] * e2[2] - e1[2] * e2[1];
+				double n1 = e1[2] * e2[0] - e1[0] * e2[2];
+				double n2 = e1[0] * e2[1] - e1[1] * e2[0];
+				double h = s[0] * n0 + s[1] * n1 + s[2] * n2;
+				if (fabs(h) <= BVH_EPS * scale * sqrt(scale))
+					return -1;
+				continue;
+			}
+
+			u /= det;
+			v /= det;
+			t /= det;
+
+			if (u < -BVH_EPS || v < -BVH_EPS ||
+			    u + v > 1 + BVH_EPS)
+				continue;
+
+			if (t < -BVH_EPS)
+				continue;
+
+			// on the surface, or crossing an edge/vertex
+			if (t <= BVH_EPS || u <= BVH_EPS || v <= BVH_EPS ||
+			    u + v >= 1 - BVH_EPS)
+				return -1;
+
+			hits++;
+		}
+	}
+
+	return hits & 1;
+}
+//---------------------------------------------------------------------------
+int
+MeshBVH::inside(const Point3 &p) const
+{
+	double o[3] = {p.getX(), p.getY(), p.getZ()};
+	int hits;
+
+	if (m_nodes.empty())
+		return 0;
+
+	const Node &root = m_nodes[0];
+	for (int k = 0; k < 3; k++)
+		if (o[k] < root.bmin[k] || o[k] > root.bmax[k])
+			return 0;
+
+	for (unsigned n = 0; n < BVH_NDIRS; n++) {
+		int r = rayParity(o, bvh_dirs[n], hits);
+		if (r >= 0)
+			return r;
+	}
+
+	// every ray was degenerate, fall back to the winding number
+	return fabs(winding(p)) > 0.5;
+}
+//---------------------------------------------------------------------------
+// solid angle sum, Van Oosterom & Strackee (1983)
+double
+MeshBVH::winding(const Point3 &p) const
+{
+	double o[3] = {p.getX(), p.getY(), p.getZ()};
+	double sum = 0;
+
+	for (unsigned n = 0; n < m_elem.size(); n++) {
+		const double *t = &m_tris[9 * n];
+		double a[3], b[3], c[3];
+
+		for (int k = 0; k < 3; k++) {
+			a[k] = t[k] - o[k];
+			b[k] = t[3 + k] - o[k];
+			c[k] = t[6 + k] - o[k];
+		}
+
+		double la = sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+		double lb = sqrt(b[0] * b[0] + b[1] * b[1] + b[2] * b[2]);
+		double lc = sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+
+		double det = a[0] * (b[1] * c[2] - b[2] * c[1]) +
+			a[1] * (b[2] * c[0] - b[0] * c[2]) +
+			a[2] * (b[0] * c[1] - b[1] * c[0]);
+
+		double div = la * lb * lc +
+			(a[0] * b[0] + a[1] * b[1] + a[2] * b[2]) * lc +
+			(b[0] * c[0] + b[1] * c[1] + b[2] * c[2]) * la +
+			(c[0] * a[0] + c[1] * a[1] + c[2] * a[2]) * lb;
+
+		sum += 2 * atan2(det, div);
+	}
+
+	return sum / (4 * M_PI);
+}
+//---------------------------------------------------------------------------
+void
+MeshBVH::classify(const Point3 *pts, int np, char *res) const
+{
+#pragma omp parallel for schedule(dynamic, 64)
+	for (int n = 0; n < np; n++)
+		res[n] = inside(pts[n]);
+}
+//---------------------------------------------------------------------------
+double
+MeshBVH::volume(void) const
+{
+	double vol = 0;
+
+	for (unsigned n = 0; n < m_elem.size(); n++) {
+		const double *a = &m_tris[9 * n];
+		const double *b = a + 3;
+		const double *c = a + 6;
+		vol += a[0] * (b[1] * c[2] - b[2] * c[1]) +
+			a[1] * (b[2] * c[0] - b[0] * c[2]) +
+			a[2] * (b[0] * c[1] - b[1] * c[0]);
+	}
+
+	return vol / 6;
+}
+//---------------------------------------------------------------------------
+double
+MeshBVH::boxDist2(const Node &nd, const double *o)
+{
+	double d = 0;
+
+	for (int k = 0; k < 3; k++) {
+		double v = 0;
+		if (o[k] < nd.bmin[k])
+			v = nd.bmin[k] - o[k];
+		else if (o[k] > nd.bmax[k])
+			v = o[k] - nd.bmax[k];
+		d += v * v;
+	}
+
+	return d;
+}
+//---------------------------------------------------------------------------
+// closest point q on triangle t to point o, returns the squared distance
+// ref: C. Ericson, Real-Time Collision Detection, 5.1.5
+double
+MeshBVH::triDist2(const double *t, const double *o, double *q)
+{
+	const double *a = t, *b = t + 3, *c = t + 6;
+	double ab[3], ac[3], ap[3], bp[3], cp[3];
+
+	for (int k = 0; k < 3; k++) {
+		ab[k] = b[k] - a[k];
+		ac[k] = c[k] - a[k];
+		ap[k] = o[k] - a[k];
+		bp[k] = o[k] - b[k];
+		cp[k] = o[k] - c[k];
+	}
+
+#define BVH_DOT(x, y) (x[0] * y[0] + x[1] * y[1] + x[2] * y[2])
+	double d1 = BVH_DOT(ab, ap), d2 = BVH_DOT(ac, ap);
+	double d3 = BVH_DOT(ab, bp), d4 = BVH_DOT(ac, bp);
+	double d5 = BVH_DOT(ab, cp), d6 = BVH_DOT(ac, cp);
+#undef BVH_DOT
+	double v, w;
+
+	if (d1 <= 0 && d2 <= 0) {
+		v = w = 0;
+	} else if (d3 >= 0 && d4 <= d3) {
+		v = 1;
+		w = 0;
+	} else if (d6 >= 0 && d5 <= d6) {
+		v = 0;
+		w = 1;
+	} else {
+		double vc = d1 * d4 - d3 * d2;
+		double vb = d5 * d2 - d1 * d6;
+		double va = d3 * d6 - d5 * d4;
+
+		if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+			v = d1 / (d1 - d3);
+			w = 0;
+		} else if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+			v = 0;
+			w = d2 / (d2 - d6);
+		} else if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+			w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+			v = 1 - w;
+		} else {
+			double den = 1 / (va + vb + vc);
+			v = vb * den;
+			w = vc * den;
+		}
+	}
+
+	double d = 0;
+	for (int k = 0; k < 3; k++) {
+		q[k] = a[k] + ab[k] * v + ac[k] * w;
+		d += (o[k] - q[k]) * (o[k] - q[k]);
+	}
+
+	return d;
+}
+//---------------------------------------------------------------------------
+double
+MeshBVH::nearest(const Point3 &p, double bound, Point3 *pi, int *elem,
+		 double stop) const
+{
+	double o[3] = {p.getX(), p.getY(), p.getZ()};
+	double best = (bound < 0) ? DBL_MAX : bound * bound;
+	double q[3], bq[3] = {0, 0, 0};
+	int stack[BVH_STACK];
+	int sp = 0, bt = -1;
+
+	stop *= stop;
+
+	if (elem)
+		*elem = -1;
+
+	if (m_nodes.empty())
+		return bound;
+
+	if (boxDist2(m_nodes[0], o) < best)
+		stack[sp++] = 0;
+
+	while (sp) {
+		int idx = stack[--sp];
+		const Node &nd = m_nodes[idx];
+
+		if (boxDist2(nd, o) >= best)
+			continue;
+
+		if (nd.count == 0) {
+			int l = idx + 1, r = nd.start;
+			double dl = boxDist2(m_nodes[l], o);
+			double dr = boxDist2(m_nodes[r], o);
+
+			// visit the closer child first
+			if (dl < dr) {
+				int t = l;
+				l = r;
+				r = t;
+				double d = dl;
+				dl = dr;
+				dr = d;
+			}
+			if (dl < best && sp < BVH_STACK)
+				stack[sp++] = l;
+			if (dr < best && sp < BVH_STACK)
+				stack[sp++] = r;
+			continue;
+		}
+
+		for (int n = nd.start; n < nd.start + nd.count; n++) {
+			double d = triDist2(&m_tris[9 * n], o, q);
+			if (d >= best)
+				continue;
+			best = d;
+			bt = n;
+			bq[0] = q[0];
+			bq[1] = q[1];
+			bq[2] = q[2];
+			if (best <= stop)
+				break;
+		}
+		if (best <= stop)
+			break;
+	}
+
+	if (bt < 0)
+		return bound;
+
+	if (pi)
+		pi->setCoord(bq[0], bq[1], bq[2]);
+	if (elem)
+		*elem = m_elem[bt];
+
+	return sqrt(best);
+}
+//---------------------------------------------------------------------------
+// squared distance between the segments p0 - p1 and q0 - q1
+double
+MeshBVH::segDist2(const double *p0, const double *p1,
+		  const double *q0, const double *q1)
+{
+	double d1[3], d2[3], r[3];
+
+	for (int k = 0; k < 3; k++) {
+		d1[k] = p1[k] - p0[k];
+		d2[k] = q1[k] - q0[k];
+		r[k] = p0[k] - q0[k];
+	}
+
+#define BVH_DOT(x, y) (x[0] * y[0] + x[1] * y[1] + x[2] * y[2])
+	double a = BVH_DOT(d1, d1), e = BVH_DOT(d2, d2);
+	double f = BVH_DOT(d2, r), c = BVH_DOT(d1, r), b = BVH_DOT(d1, d2);
+#undef BVH_DOT
+	double s = 0, t = 0;
+
+	if (a <= 0 && e > 0) {
+		t = f / e;
+	} else if (a > 0 && e <= 0) {
+		s = -c / a;
+	} else if (a > 0) {
+		double den = a * e - b * b;
+		if (den > 0)
+			s = min(max((b * f - c * e) / den, 0.0), 1.0);
+		t = (b * s + f) / e;
+		if (t < 0) {
+			t = 0;
+			s = -c / a;
+		} else if (t > 1) {
+			t = 1;
+			s = (b - c) / a;
+		}
+	}
+	s = min(max(s, 0.0), 1.0);
+	t = min(max(t, 0.0), 1.0);
+
+	double d = 0;
+	for (int k = 0; k < 3; k++) {
+		double v = r[k] + d1[k] * s - d2[k] * t;
+		d += v * v;
+	}
+
+	return d;
+}
+//---------------------------------------------------------------------------
+// squared distance between the triangles s and t
+double
+MeshBVH::triTriDist2(const double *s, const double *t)
+{
+	double q[3], d = DBL_MAX;
+
+	for (int i = 0; i < 3; i++) {
+		d = min(d, triDist2(t, s + 3 * i, q));
+		d = min(d, triDist2(s, t + 3 * i, q));
+		for (int j = 0; j < 3; j++)
+			d = min(d, segDist2(s + 3 * i, s + 3 * ((i + 1) % 3),
+					    t + 3 * j, t + 3 * ((j + 1) % 3)));
+	}
+
+	// edges crossing the plane of the other triangle,
+	// this covers intersecting triangles
+	for (int m = 0; m < 2; m++) {
+		const double *a = m ? t : s, *b = m ? s : t;
+		double e1[3], e2[3], n[3];
+
+		for (int k = 0; k < 3; k++) {
+			e1[k] = b[3 + k] - b[k];
+			e2[k] = b[6 + k] - b[k];
+		}
+		n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+
+		for (int i = 0; i < 3; i++) {
+			const double *p0 = a + 3 * i;
+			const double *p1 = a + 3 * ((i + 1) % 3);
+			double h0 = 0, h1 = 0, x[3];
+
+			for (int k = 0; k < 3; k++) {
+				h0 += n[k] * (p0[k] - b[k]);
+				h1 += n[k] * (p1[k] - b[k]);
+			}
+			if ((h0 > 0) == (h1 > 0) || h0 == h1)
+				continue;
+			for (int k = 0; k < 3; k++)
+				x[k] = p0[k] + (p1[k] - p0[k]) * h0 / (h0 - h1);
+			d = min(d, triDist2(b, x, q));
+		}
+	}
+
+	return d;
+}
+//---------------------------------------------------------------------------
+int
+MeshBVH::nearTriangle(const Point3 &a, const Point3 &b, const Point3 &c,
+		      double dist) const
+{
+	double t[9], bmin[3], bmax[3];
+	int stack[BVH_STACK];
+	int sp = 0;
+
+	if (m_nodes.empty())
+		return 0;
+
+	a.getCoord(t[0], t[1], t[2]);
+	b.getCoord(t[3], t[4], t[5]);
+	c.getCoord(t[6], t[7], t[8]);
+	for (int k = 0; k < 3; k++) {
+		bmin[k] = min(t[k], min(t[3 + k], t[6 + k])) - dist;
+		bmax[k] = max(t[k], max(t[3 + k], t[6 + k])) + dist;
+	}
+
+	stack[sp++] = 0;
+	while (sp) {
+		int idx = stack[--sp];
+		const Node &nd = m_nodes[idx];
+		int k;
+
+		for (k = 0; k < 3; k++)
+			if (nd.bmin[k] > bmax[k] || nd.bmax[k] < bmin[k])
+				break;
+		if (k < 3)
+			continue;
+
+		if (nd.count == 0) {
+			if (sp + 2 > BVH_STACK)
+				return 1;
+			stack[sp++] = nd.start;
+			stack[sp++] = idx + 1;
+			continue;
+		}
+
+		for (int n = nd.start; n < nd.start + nd.count; n++) {
+			const double *s = &m_tris[9 * n];
+			for (k = 0; k < 3; k++)
+				if (min(s[k], min(s[3 + k], s[6 + k])) > bmax[k] ||
+				    max(s[k], max(s[3 + k], s[6 + k])) < bmin[k])
+					break;
+			if (k == 3 && triTriDist2(s, t) < dist * dist)
+				return 1;
+		}
+	}
+
+	return 0;
+}
+//---------------------------------------------------------------------------
+int
+MeshBVH::crossPlane(const double *n, double d, vector<unsigned> &elems) const
+{
+	int stack[BVH_STACK];
+	int sp = 0;
+
+	if (m_nodes.empty())
+		return 0;
+
+	stack[sp++] = 0;
+	while (sp) {
+		int idx = stack[--sp];
+		const Node &nd = m_nodes[idx];
+
+		// the nearest and farthest corners along n
+		double lo = 0, hi = 0;
+		for (int k = 0; k < 3; k++) {
+			lo += n[k] * (n[k] > 0 ? nd.bmin[k] : nd.bmax[k]);
+			hi += n[k] * (n[k] > 0 ? nd.bmax[k] : nd.bmin[k]);
+		}
+		if (lo >= d || hi < d)
+			continue;
+
+		if (nd.count == 0) {
+			if (sp + 2 > BVH_STACK)
+				return 1;
+			stack[sp++] = nd.start;
+			stack[sp++] = idx + 1;
+			continue;
+		}
+
+		for (int i = nd.start; i < nd.start + nd.count; i++) {
+			const double *t = &m_tris[9 * i];
+			int above = 0;
+			for (int m = 0; m < 3; m++)
+				if (n[0] * t[3 * m] + n[1] * t[3 * m + 1] +
+				    n[2] * t[3 * m + 2] >= d)
+					above++;
+			if (above == 1 || above == 2)
+				elems.push_back(m_elem[i]);
+		}
+	}
+
+	return 0;
+}
+//---------------------------------------------------------------------------
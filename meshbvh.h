@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2014 Can Erkin Acar
+ * Copyright (C) 2014 Zeynep Akalin Acar
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef _MESHBVH_H_
+#define _MESHBVH_H_
+
+#include <vector>
+#include "mesh.h"
+
+using namespace std;
+
+// Bounding volume hierarchy over the triangles of a mesh (or one class).
+// The triangle coordinates are copied, so the tree remains usable
+// (but stale) if the mesh is edited after construction.
+class MeshBVH {
+public:
+	MeshBVH(const TriMeshLin &msh, int cls = -1);
+	// tree over the given elements only
+	MeshBVH(const TriMeshLin &msh, const vector<unsigned> &elems);
+	~MeshBVH(void) {};
+
+	inline int getNumTris(void) const
+		{ return m_elem.size(); }
+
+	// 1 if the point is inside the closed surface, 0 otherwise
+	int inside(const Point3 &p) const;
+	// generalized winding number (1 inside, 0 outside)
+	double winding(const Point3 &p) const;
+
+	// classify an array of points, res[n] is set to inside(pts[n])
+	void classify(const Point3 *pts, int np, char *res) const;
+
+	// enclosed (signed) volume
+	double volume(void) const;
+
+	// distance from p to the nearest point on the surface. The search
+	// is limited to distances below 'bound' (returned if nothing is
+	// closer) and stops as soon as a distance below 'stop' is found.
+	double nearest(const Point3 &p, double bound = -1,
+		       Point3 *pi = NULL, int *elem = NULL,
+		       double stop = 0) const;
+
+	// 1 if any triangle is closer than dist to the triangle a, b, c
+	int nearTriangle(const Point3 &a, const Point3 &b, const Point3 &c,
+			 double dist) const;
+
+	// appends the triangles with corners on both sides of the plane
+	// n.x = d, corners on the plane counting as above. Returns 1 if the
+	// tree is too deep to search in full, 0 otherwise.
+	int crossPlane(const double *n, double d,
+		       vector<unsigned> &elems) const;
+
+protected:
+	struct Node {
+		double bmin[3];
+		double bmax[3];
+		int start;	// first triangle (leaf) or right child
+		int count;	// number of triangles, 0 for inner nodes
+	};
+
+	void init(const TriMeshLin &msh, const vector<unsigned> &elems);
+	int build(unsigned *order, int start, int count,
+		  const vector<double> &tris, const vector<double> &cent);
+	int rayParity(const double *o, const double *d, int &hits) const;
+	static int rayBox(const Node &nd, const double *o,
+			  const double *inv);
+	static double boxDist2(const Node &nd, const double *o);
+	static double triDist2(const double *t, const double *o, double *q);
+	static double segDist2(const double *p0, const double *p1,
+			       const double *q0, const double *q1);
+	static double triTriDist2(const double *s, const double *t);
+
+	vector<Node> m_nodes;
+	vector<double> m_tris;		// 9 coordinates per triangle
+	vector<unsigned> m_elem;	// original element index
+};
+
+#endif
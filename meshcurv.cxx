@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2014 Can Erkin Acar
+ * Copyright (C) 2014 Zeynep Akalin Acar
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include <math.h>
+#include <string.h>
+#include "meshcurv.h"
+
+static const char *mc_names[MC_NUM] = { "mean", "gauss", "k1", "k2" };
+
+//---------------------------------------------------------------------------
+MeshCurvature::MeshCurvature(TriMeshLin &msh) : m_mesh(msh), m_ne(0), m_nn(0)
+{
+}
+//---------------------------------------------------------------------------
+void
+MeshCurvature::update(void)
+{
+	m_ne = m_mesh.getNumTris();
+	m_nn = m_mesh.getNumVerts();
+
+	for (int c = 0; c < MC_NUM; c++)
+		m_fld[c].assign(m_nn, 0.0);
+	if (m_ne == 0 || m_nn == 0)
+		return;
+
+	// the node normals only give the sign of the mean curvature
+	m_mesh.calcNormals();
+
+	buildCorners();
+	updateCorners();
+	updateNodes();
+}
+//---------------------------------------------------------------------------
+// counting sort of the element corners by node
+void
+MeshCurvature::buildCorners(void)
+{
+	const unsigned int *tris = m_mesh.getTriIndex();
+	unsigned int nc = 3 * m_ne;
+
+	m_start.assign(m_nn + 1, 0);
+	for (unsigned int c = 0; c < nc; c++)
+		m_start[tris[c] + 1]++;
+	for (int v = 0; v < m_nn; v++)
+		m_start[v + 1] += m_start[v];
+
+	vector<unsigned int> pos(m_start.begin(), m_start.end() - 1);
+	m_corner.resize(nc);
+	for (unsigned int c = 0; c < nc; c++)
+		m_corner[pos[tris[c]]++] = c;
+}
+//---------------------------------------------------------------------------
+void
+MeshCurvature::updateCorners(void)
+{
+	const Point3 *verts = m_mesh.getVerts();
+	const unsigned int *tris = m_mesh.getTriIndex();
+
+	m_lap.resize(9 * m_ne);
+	m_area.resize(3 * m_ne);
+	m_angle.resize(3 * m_ne);
+	m_bnd.resize(3 * m_ne);
+
+#pragma omp parallel for schedule(static)
+	for (int f = 0; f < m_ne; f++) {
+		const unsigned int *u = &tris[3 * f];
+		Point3 e[3];		// e[m] is opposite to corner m
+		double l2[3], ct[3];
+		int nb[3];
+
+		for (int m = 0; m < 3; m++) {
+			e[m] = verts[u[(m + 2) % 3]] - verts[u[(m + 1) % 3]];
+			l2[m] = e[m].length2();
+			Edge *ed = m_mesh.getEdge(u[(m + 1) % 3],
+						  u[(m + 2) % 3]);
+			nb[m] = (ed == NULL || ed->nelem != 2);
+		}
+
+		double a2 = Cross(e[0], e[1]).length();	// twice the area
+		for (int m = 0; m < 3; m++) {
+			const Point3 &ep = e[(m + 1) % 3];
+			const Point3 &en = e[(m + 2) % 3];
+			double d = -ep.dot(en);
+			m_angle[3 * f + m] = atan2(a2, d);
+			ct[m] = (a2 > 0) ? d / a2 : 0;
+		}
+
+		int obtuse = -1;
+		for (int m = 0; m < 3; m++)
+			if (ct[m] < 0)
+				obtuse = m;
+
+		for (int m = 0; m < 3; m++) {
+			int j = (m + 1) % 3, k = (m + 2) % 3;
+			const Point3 &p = verts[u[m]];
+			Point3 l = (verts[u[j]] - p) * ct[k] +
+				(verts[u[k]] - p) * ct[j];
+			double *lp = &m_lap[9 * f + 3 * m];
+
+			lp[0] = l.getX();
+			lp[1] = l.getY();
+			lp[2] = l.getZ();
+
+			// Voronoi area, or a share of the obtuse element
+			double area;
+			if (obtuse < 0)
+				area = (l2[k] * ct[k] + l2[j] * ct[j]) / 8;
+			else if (obtuse == m)
+				area = a2 / 4;
+			else
+				area = a2 / 8;
+			m_area[3 * f + m] = area;
+			m_bnd[3 * f + m] = nb[j] || nb[k];
+		}
+	}
+}
+//---------------------------------------------------------------------------
+void
+MeshCurvature::updateNodes(void)
+{
+	double *mean = &m_fld[MC_MEAN][0];
+	double *gauss = &m_fld[MC_GAUSS][0];
+	double *k1 = &m_fld[MC_K1][0];
+	double *k2 = &m_fld[MC_K2][0];
+
+#pragma omp parallel for schedule(static)
+	for (int v = 0; v < m_nn; v++) {
+		double l[3] = {0, 0, 0}, area = 0, angle = 0;
+		bool bnd = false;
+
+		for (unsigned int i = m_start[v]; i < m_start[v + 1]; i++) {
+			unsigned int c = m_corner[i];
+			for (int k = 0; k < 3; k++)
+				l[k] += m_lap[3 * c + k];
+			area += m_area[c];
+			angle += m_angle[c];
+			bnd = bnd || m_bnd[c];
+		}
+
+		if (bnd || area <= 0)
+			continue;
+
+		// the Laplacian is -2 H n, its direction gives the sign
+		Point3 lv(l[0], l[1], l[2]);
+		double h = lv.length() / (4 * area);
+		if (lv.dot(m_mesh.getVertexNormal(v)) > 0)
+			h = -h;
+		double g = (2 * M_PI - angle) / area;
+		double d = sqrt(fmax(0, h * h - g));
+
+		mean[v] = h;
+		gauss[v] = g;
+		k1[v] = h + d;
+		k2[v] = h - d;
+	}
+}
+//---------------------------------------------------------------------------
+int
+MeshCurvature::findField(const char *name)
+{
+	for (int c = 0; c < MC_NUM; c++)
+		if (strcmp(name, mc_names[c]) == 0)
+			return c;
+	return -1;
+}
+//---------------------------------------------------------------------------
+const char *
+MeshCurvature::fieldName(int c)
+{
+	return (c >= 0 && c < MC_NUM) ? mc_names[c] : NULL;
+}
+//---------------------------------------------------------------------------
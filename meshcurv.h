@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2014 Can Erkin Acar
+ * Copyright (C) 2014 Zeynep Akalin Acar
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef _MESHCURV_H_
+#define _MESHCURV_H_
+
+#include <math.h>
+#include <vector>
+#include "mesh.h"
+
+using namespace std;
+
+// node curvature fields
+#define MC_MEAN		0	// cotangent Laplacian, positive when convex
+#define MC_GAUSS	1	// angle deficit over the mixed area
+#define MC_K1		2	// larger principal curvature
+#define MC_K2		3	// smaller principal curvature
+#define MC_NUM		4
+
+// Discrete curvature of the nodes of a mesh (Meyer et al.). The angles,
+// cotangent weights and mixed Voronoi areas are computed per element
+// corner, then gathered per node over a compressed list of the node
+// corners, both in parallel. Boundary nodes get zero curvature.
+class MeshCurvature {
+public:
+	MeshCurvature(TriMeshLin &msh);
+	~MeshCurvature(void) {};
+
+	void update(void);
+
+	inline const double *field(int c) const
+		{ return m_fld[c].empty() ? NULL : &m_fld[c][0]; }
+	inline int getNumNodes(void) const
+		{ return m_nn; }
+	// largest absolute principal curvature
+	inline double maxAbs(unsigned int v) const
+		{ return fmax(fabs(m_fld[MC_K1][v]), fabs(m_fld[MC_K2][v])); }
+
+	static int findField(const char *name);
+	static const char *fieldName(int c);
+
+protected:
+	void buildCorners(void);
+	void updateCorners(void);
+	void updateNodes(void);
+
+	TriMeshLin &m_mesh;
+	int m_ne, m_nn;
+	vector<unsigned int> m_start;	// corners of node v are
+	vector<unsigned int> m_corner;	// m_corner[m_start[v] .. m_start[v+1]]
+	vector<double> m_lap;		// cotangent Laplacian terms, 3 per corner
+	vector<double> m_area;		// mixed area per corner
+	vector<double> m_angle;		// interior angle per corner
+	vector<char> m_bnd;		// corner is on a boundary edge
+	vector<double> m_fld[MC_NUM];
+};
+
+#endif
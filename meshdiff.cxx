@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2014 Can Erkin Acar
+ * Copyright (C) 2014 Zeynep Akalin Acar
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include <string.h>
+#include "meshdiff.h"
+
+//---------------------------------------------------------------------------
+MeshDiffusion::MeshDiffusion(TriMeshLin &msh) : m_mesh(msh), m_version(0),
+	m_ready(false), m_nn(0)
+{
+}
+//---------------------------------------------------------------------------
+int
+MeshDiffusion::prepare(void)
+{
+	if (m_ready && m_version == m_mesh.getVersion() &&
+	    m_nn == m_mesh.getNumVerts())
+		return 0;
+
+	m_nn = m_mesh.getNumVerts();
+	m_version = m_mesh.getVersion();
+	m_ready = false;
+	if (m_nn == 0 || m_mesh.getNumTris() == 0)
+		return 1;
+
+	vector<unsigned int> start, col;
+	vector<double> val;
+	m_mesh.cotanLaplacian(start, col, val);
+
+	// the same rows without the diagonal
+	m_start.resize(m_nn + 1);
+	for (int v = 0; v <= m_nn; v++)
+		m_start[v] = start[v] - v;
+	m_col.resize(m_start[m_nn]);
+	m_w.resize(m_start[m_nn]);
+
+#pragma omp parallel for schedule(static)
+	for (int v = 0; v < m_nn; v++) {
+		unsigned int r = m_start[v], n = start[v + 1] - start[v] - 1;
+		double sum = 0;
+
+		for (unsigned int k = 0; k < n; k++) {
+			m_col[r + k] = col[start[v] + 1 + k];
+			m_w[r + k] = fmax(0, -val[start[v] + 1 + k]);
+			sum += m_w[r + k];
+		}
+		for (unsigned int k = 0; k < n; k++)
+			m_w[r + k] = (sum > 0) ? m_w[r + k] / sum : 1.0 / n;
+	}
+
+	m_ready = true;
+	return 0;
+}
+//---------------------------------------------------------------------------
+int
+MeshDiffusion::smooth(double *val, int iter, double lambda, int nf)
+{
+	if (iter < 1 || nf < 1)
+		return 0;
+	if (lambda <= 0 || lambda > 1 || prepare())
+		return 1;
+
+	vector<double> tmp((size_t) m_nn * nf);
+	double *a = val, *b = &tmp[0];
+
+	for (int it = 0; it < iter; it++) {
+#pragma omp parallel for schedule(static)
+		for (int v = 0; v < m_nn; v++) {
+			const double *fa = &a[(size_t) v * nf];
+			double *fb = &b[(size_t) v * nf];
+
+			if (m_start[v] == m_start[v + 1]) {
+				memcpy(fb, fa, nf * sizeof(double));
+				continue;
+			}
+
+			for (int f = 0; f < nf; f++)
+				fb[f] = (1 - lambda) * fa[f];
+			for (unsigned int p = m_start[v]; p < m_start[v + 1];
+			     p++) {
+				const double *fn = &a[(size_t) m_col[p] * nf];
+				double w = lambda * m_w[p];
+				for (int f = 0; f < nf; f++)
+					fb[f] += w * fn[f];
+			}
+		}
+		double *t = a;
+		a = b;
+		b = t;
+	}
+
+	if (a != val)
+		memcpy(val, a, (size_t) m_nn * nf * sizeof(double));
+
+	return 0;
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2014 Can Erkin Acar
+ * Copyright (C) 2014 Zeynep Akalin Acar
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef _MESHDIFF_H_
+#define _MESHDIFF_H_
+
+#include <vector>
+#include "mesh.h"
+
+using namespace std;
+
+// Diffusion smoothing of node fields on the surface. Each step moves
+// the value of a node toward the weighted mean of its neighbors,
+//   f_i += lambda * (sum_j w_ij f_j / sum_j w_ij - f_i)
+// with the cotangent weights, negative ones clamped to zero (uniform
+// if none is left). The normalized weights are built once per mesh
+// version, the steps are parallel Jacobi sweeps between two buffers.
+class MeshDiffusion {
+public:
+	MeshDiffusion(TriMeshLin &msh);
+	~MeshDiffusion(void) {};
+
+	// builds the weights if the mesh changed, returns 0 on success
+	int prepare(void);
+
+	// smooths nf interleaved fields in place, the value of field f at
+	// node n is val[n * nf + f]. lambda is in (0, 1].
+	int smooth(double *val, int iter, double lambda = 0.5, int nf = 1);
+
+protected:
+	TriMeshLin &m_mesh;
+	unsigned int m_version;
+	bool m_ready;
+	int m_nn;
+	vector<unsigned int> m_start;	// neighbors of node v and weights
+	vector<unsigned int> m_col;	// m_col/m_w[m_start[v] .. m_start[v+1]]
+	vector<double> m_w;
+};
+
+#endif
@@ -0,0 +1,328 @@
+/*
+ * Copyright (C) 2014 Can Erkin Acar
+ * Copyright (C) 2014 Zeynep Akalin Acar
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include <math.h>
+#include <float.h>
+#include <queue>
+#include "meshgeod.h"
+
+#define GEOD_REG	1e-6	// Poisson regularization, relative to 1/t
+
+//---------------------------------------------------------------------------
+MeshGeodesic::MeshGeodesic(TriMeshLin &msh) : m_mesh(msh), m_version(0),
+	m_ready(false), m_nn(0), m_ne(0), m_time(0)
+{
+}
+//---------------------------------------------------------------------------
+int
+MeshGeodesic::prepare(void)
+{
+	if (m_ready && m_version == m_mesh.getVersion() &&
+	    m_nn == m_mesh.getNumVerts() && m_ne == m_mesh.getNumTris())
+		return 0;
+
+	m_ready = false;
+	m_heat.clear();
+	m_poisson.clear();
+	m_nn = m_mesh.getNumVerts();
+	m_ne = m_mesh.getNumTris();
+	m_version = m_mesh.getVersion();
+	if (m_nn == 0 || m_ne == 0)
+		return 1;
+
+	buildOperators();
+
+	vector<double> xyz(3 * m_nn);
+	for (int v = 0; v < m_nn; v++) {
+		const Point3 &p = m_mesh.getVertex(v);
+		xyz[3 * v] = p.getX();
+		xyz[3 * v + 1] = p.getY();
+		xyz[3 * v + 2] = p.getZ();
+	}
+	vector<int> perm;
+	SparseLDL::orderNested(m_nn, &xyz[0], m_start, m_col, perm);
+
+	// the diagonal is the first entry of each row. The two operators
+	// share the structure and order, and are factored side by side.
+	vector<double> vh(m_lap.size()), vp(m_lap);
+	for (unsigned int p = 0; p < vh.size(); p++)
+		vh[p] = m_time * m_lap[p];
+	for (int v = 0; v < m_nn; v++) {
+		vh[m_start[v]] += m_mass[v];
+		vp[m_start[v]] += GEOD_REG / m_time * m_mass[v];
+		// nodes without elements are left out
+		if (m_mass[v] == 0) {
+			vh[m_start[v]] = 1;
+			vp[m_start[v]] = 1;
+		}
+	}
+
+	int eh = 0, ep = 0;
+#pragma omp parallel sections
+	{
+#pragma omp section
+		eh = m_heat.factor(m_nn, m_start, m_col, vh, perm);
+#pragma omp section
+		ep = m_poisson.factor(m_nn, m_start, m_col, vp, perm);
+	}
+	if (eh || ep) {
+		MESH_LOG("Geodesic: %s operator is singular\n",
+			 eh ? "heat" : "Poisson");
+		m_heat.clear();
+		m_poisson.clear();
+		return 1;
+	}
+
+	MESH_LOG("Geodesic: factored %d nodes, %lu nonzeros each\n", m_nn,
+		 (unsigned long) m_heat.nonzeros());
+
+	m_ready = true;
+	return 0;
+}
+//---------------------------------------------------------------------------
+// cotangent Laplacian, lumped masses, corner cotangents for the
+// divergence and the connected components
+void
+MeshGeodesic::buildOperators(void)
+{
+	const Point3 *verts = m_mesh.getVerts();
+	const unsigned int *tris = m_mesh.getTriIndex();
+
+	m_mesh.cotanLaplacian(m_start, m_col, m_lap, &m_mass);
+	m_cot.resize(3 * m_ne);
+
+#pragma omp parallel for schedule(static)
+	for (int f = 0; f < m_ne; f++) {
+		const unsigned int *u = &tris[3 * f];
+		for (int m = 0; m < 3; m++) {
+			const Point3 &p = verts[u[m]];
+			Point3 a = verts[u[(m + 1) % 3]] - p;
+			Point3 b = verts[u[(m + 2) % 3]] - p;
+			double s = Cross(a, b).length();
+			m_cot[3 * f + m] = (s > 0) ? a.dot(b) / s : 0;
+		}
+	}
+
+	double len = 0;
+	unsigned int ne = 0;
+	for (int v = 0; v < m_nn; v++) {
+		for (unsigned int p = m_start[v] + 1; p < m_start[v + 1]; p++)
+			len += (verts[m_col[p]] - verts[v]).length();
+		ne += m_start[v + 1] - m_start[v] - 1;
+	}
+	len /= ne ? ne : 1;
+	m_time = len * len;
+
+	m_comp.assign(m_nn, -1);
+	vector<int> stack;
+	for (int v = 0, nc = 0; v < m_nn; v++) {
+		if (m_comp[v] >= 0)
+			continue;
+		m_comp[v] = nc;
+		stack.push_back(v);
+		while (stack.size()) {
+			int w = stack.back();
+			stack.pop_back();
+			for (unsigned int p = m_start[w]; p < m_start[w + 1]; p++) {
+				if (m_comp[m_col[p]] < 0) {
+					m_comp[m_col[p]] = nc;
+					stack.push_back(m_col[p]);
+				}
+			}
+		}
+		nc++;
+	}
+}
+//---------------------------------------------------------------------------
+// zero distance at the nearest source of each component, -1 for the
+// components without sources
+void
+MeshGeodesic::componentShift(const vector<unsigned int> &src, double *dist)
+{
+	vector<double> min(m_nn, DBL_MAX);
+
+	for (unsigned int s = 0; s < src.size(); s++) {
+		int c = m_comp[src[s]];
+		if (dist[src[s]] < min[c])
+			min[c] = dist[src[s]];
+	}
+
+#pragma omp parallel for schedule(static)
+	for (int v = 0; v < m_nn; v++) {
+		double m = min[m_comp[v]];
+		dist[v] = (m == DBL_MAX) ? -1 : fmax(0, dist[v] - m);
+	}
+}
+//---------------------------------------------------------------------------
+int
+MeshGeodesic::heat(const vector<unsigned int> &src, double *dist)
+{
+	if (src.empty() || prepare())
+		return 1;
+
+	const Point3 *verts = m_mesh.getVerts();
+	const unsigned int *tris = m_mesh.getTriIndex();
+	vector<double> u(m_nn, 0.0), x(3 * m_ne);
+
+	for (unsigned int s = 0; s < src.size(); s++) {
+		if (src[s] >= (unsigned int) m_nn)
+			return 1;
+		u[src[s]] = 1;
+	}
+	m_heat.solve(&u[0]);
+
+	// normalized heat gradient, pointing away from the sources
+#pragma omp parallel for schedule(static)
+	for (int f = 0; f < m_ne; f++) {
+		const unsigned int *t = &tris[3 * f];
+		Point3 n = Cross(verts[t[1]] - verts[t[0]],
+				 verts[t[2]] - verts[t[0]]);
+		Point3 g(0, 0, 0);
+
+		for (int m = 0; m < 3; m++)
+			g += Cross(n, verts[t[(m + 2) % 3]] -
+				   verts[t[(m + 1) % 3]]) * u[t[m]];
+		double l = g.length();
+		if (l > 0)
+			g /= -l;
+		x[3 * f] = g.getX();
+		x[3 * f + 1] = g.getY();
+		x[3 * f + 2] = g.getZ();
+	}
+
+	// integrated divergence, negated for the positive Laplacian
+#pragma omp parallel for schedule(static)
+	for (int v = 0; v < m_nn; v++) {
+		Neighbor &nf = m_mesh.getFaceNbrs(v);
+		const Point3 &p = verts[v];
+		double div = 0;
+
+		for (int k = 0; k < nf.count(); k++) {
+			unsigned int f = nf[k];
+			const unsigned int *t = &tris[3 * f];
+			int m = (t[0] == (unsigned int) v) ? 0 :
+				(t[1] == (unsigned int) v) ? 1 : 2;
+			int j = (m + 1) % 3, l = (m + 2) % 3;
+			Point3 g(x[3 * f], x[3 * f + 1], x[3 * f + 2]);
+
+			div += m_cot[3 * f + l] * (verts[t[j]] - p).dot(g) +
+				m_cot[3 * f + j] * (verts[t[l]] - p).dot(g);
+		}
+		dist[v] = -div / 2;
+	}
+
+	m_poisson.solve(dist);
+	componentShift(src, dist);
+
+	return 0;
+}
+//---------------------------------------------------------------------------
+// arrival time at c from the known values at a and b, a planar front
+// across the triangle if it comes from within the angle at c, otherwise
+// along the shorter edge
+double
+MeshGeodesic::triUpdate(unsigned int c, unsigned int a, unsigned int b,
+			const double *dist) const
+{
+	const Point3 &pc = m_mesh.getVertex(c);
+	Point3 x1 = m_mesh.getVertex(a) - pc, x2 = m_mesh.getVertex(b) - pc;
+	double ta = dist[a], tb = dist[b];
+	double g11 = x1.dot(x1), g12 = x1.dot(x2), g22 = x2.dot(x2);
+	double det = g11 * g22 - g12 * g12;
+	double te = fmin(ta + sqrt(g11), tb + sqrt(g22));
+
+	if (det <= 1e-12 * g11 * g22)
+		return te;
+
+	double q11 = g22 / det, q12 = -g12 / det, q22 = g11 / det;
+	double sq = q11 + 2 * q12 + q22;
+	double sb = q11 * ta + q12 * (ta + tb) + q22 * tb;
+	double sc = q11 * ta * ta + 2 * q12 * ta * tb + q22 * tb * tb;
+	double disc = sb * sb - sq * (sc - 1);
+
+	if (sq <= 0 || disc < 0)
+		return te;
+
+	double t = (sb + sqrt(disc)) / sq;
+	double alpha = q11 * (t - ta) + q12 * (t - tb);
+	double beta = q12 * (t - ta) + q22 * (t - tb);
+
+	if (t < fmax(ta, tb) || alpha < 0 || beta < 0)
+		return te;
+	return fmin(t, te);
+}
+//---------------------------------------------------------------------------
+int
+MeshGeodesic::march(const vector<unsigned int> &src, double *dist)
+{
+	typedef pair<double, unsigned int> item_t;
+	priority_queue<item_t, vector<item_t>, greater<item_t> > q;
+	int nn = m_mesh.getNumVerts();
+	const unsigned int *tris = m_mesh.getTriIndex();
+	vector<char> done(nn, 0);
+
+	if (src.empty())
+		return 1;
+
+	for (int v = 0; v < nn; v++)
+		dist[v] = DBL_MAX;
+	for (unsigned int s = 0; s < src.size(); s++) {
+		if (src[s] >= (unsigned int) nn)
+			return 1;
+		dist[src[s]] = 0;
+		q.push(item_t(0, src[s]));
+	}
+
+	while (!q.empty()) {
+		item_t it = q.top();
+		q.pop();
+		unsigned int v = it.second;
+		if (done[v] || it.first > dist[v])
+			continue;
+		done[v] = 1;
+
+		// update the open nodes of the elements around v
+		Neighbor &nf = m_mesh.getFaceNbrs(v);
+		for (int k = 0; k < nf.count(); k++) {
+			const unsigned int *t = &tris[3 * nf[k]];
+			for (int m = 0; m < 3; m++) {
+				unsigned int w = t[m];
+				if (done[w])
+					continue;
+				unsigned int o = t[0] + t[1] + t[2] - v - w;
+				double d;
+				if (done[o])
+					d = triUpdate(w, v, o, dist);
+				else
+					d = dist[v] + (m_mesh.getVertex(w) -
+						       m_mesh.getVertex(v)).length();
+				if (d < dist[w]) {
+					dist[w] = d;
+					q.push(item_t(d, w));
+				}
+			}
+		}
+	}
+
+	for (int v = 0; v < nn; v++)
+		if (!done[v])
+			dist[v] = -1;
+
+	return 0;
+}
+//---------------------------------------------------------------------------
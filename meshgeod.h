@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2014 Can Erkin Acar
+ * Copyright (C) 2014 Zeynep Akalin Acar
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef _MESHGEOD_H_
+#define _MESHGEOD_H_
+
+#include <vector>
+#include "mesh.h"
+#include "sparseldl.h"
+
+using namespace std;
+
+// Geodesic distances from a set of source nodes. The heat method
+// (Crane et al.) diffuses heat from the sources for a short time, and
+// then finds the distance whose gradient best matches the normalized
+// heat gradient. Both steps are sparse solves with matrices that only
+// depend on the mesh, so they are factored on the first query and kept
+// until the mesh version changes. Fast marching is the fallback.
+// Nodes not connected to any source get -1.
+class MeshGeodesic {
+public:
+	MeshGeodesic(TriMeshLin &msh);
+	~MeshGeodesic(void) {};
+
+	// dist has a value per node, returns 0 on success
+	int heat(const vector<unsigned int> &src, double *dist);
+	int march(const vector<unsigned int> &src, double *dist);
+
+	// builds the operators if the mesh changed, returns 0 on success
+	int prepare(void);
+
+protected:
+	void buildOperators(void);
+	void componentShift(const vector<unsigned int> &src, double *dist);
+	double triUpdate(unsigned int c, unsigned int a, unsigned int b,
+			 const double *dist) const;
+
+	TriMeshLin &m_mesh;
+	unsigned int m_version;
+	bool m_ready;
+	int m_nn, m_ne;
+	double m_time;			// diffusion time, mean edge length ^ 2
+
+	vector<unsigned int> m_start;	// cotangent Laplacian, compressed rows
+	vector<unsigned int> m_col;
+	vector<double> m_lap;
+	vector<double> m_mass;		// lumped mass
+	vector<double> m_cot;		// corner cotangents, 3 per element
+	vector<int> m_comp;		// connected component of the nodes
+
+	SparseLDL m_heat;		// M + t L
+	SparseLDL m_poisson;		// L + e M
+};
+
+#endif
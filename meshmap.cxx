@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2014 Can Erkin Acar
+ * Copyright (C) 2014 Zeynep Akalin Acar
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "meshmap.h"
+#include "meshbvh.h"
+
+//---------------------------------------------------------------------------
+int
+MeshMap::build(const TriMeshLin &src, const TriMeshLin &dst)
+{
+	int nd = dst.getNumVerts();
+
+	m_src = NULL;
+	m_dst = NULL;
+	m_idx.clear();
+	m_w.clear();
+	m_maxdist = 0;
+	if (src.getNumTris() == 0 || nd == 0)
+		return 1;
+
+	MeshBVH bvh(src);
+	const unsigned int *tris = src.getTriIndex();
+	double dmax = 0;
+
+	m_idx.resize(3 * nd);
+	m_w.resize(3 * nd);
+
+#pragma omp parallel for schedule(dynamic, 256) reduction(max:dmax)
+	for (int n = 0; n < nd; n++) {
+		const Point3 &p = dst.getVertex(n);
+		Point3 q;
+		int e = 0;
+		double d = bvh.nearest(p, -1, &q, &e);
+		if (d > dmax)
+			dmax = d;
+
+		// barycentric coordinates of the projection, which is on
+		// (or numerically near) the element
+		const unsigned int *u = &tris[3 * e];
+		const Point3 &a = src.getVertex(u[0]);
+		Point3 e0 = src.getVertex(u[1]) - a;
+		Point3 e1 = src.getVertex(u[2]) - a;
+		Point3 r = q - a;
+		double d00 = e0.dot(e0), d01 = e0.dot(e1), d11 = e1.dot(e1);
+		double d20 = r.dot(e0), d21 = r.dot(e1);
+		double det = d00 * d11 - d01 * d01;
+		double w1 = 0, w2 = 0;
+
+		if (det > 0) {
+			w1 = fmax(0, (d11 * d20 - d01 * d21) / det);
+			w2 = fmax(0, (d00 * d21 - d01 * d20) / det);
+			double s = w1 + w2;
+			if (s > 1) {
+				w1 /= s;
+				w2 /= s;
+			}
+		}
+
+		for (int k = 0; k < 3; k++)
+			m_idx[3 * n + k] = u[k];
+		m_w[3 * n] = 1 - w1 - w2;
+		m_w[3 * n + 1] = w1;
+		m_w[3 * n + 2] = w2;
+	}
+
+	m_maxdist = dmax;
+	m_src = &src;
+	m_dst = &dst;
+	m_sver = src.getVersion();
+	m_dver = dst.getVersion();
+
+	return 0;
+}
+//---------------------------------------------------------------------------
+int
+MeshMap::current(const TriMeshLin &src, const TriMeshLin &dst) const
+{
+	return m_src == &src && m_dst == &dst && m_sver == src.getVersion() &&
+		m_dver == dst.getVersion() &&
+		getNumTarget() == dst.getNumVerts();
+}
+//---------------------------------------------------------------------------
+void
+MeshMap::apply(const double *src, double *dst, int nf) const
+{
+	int nd = getNumTarget();
+
+#pragma omp parallel for schedule(static)
+	for (int n = 0; n < nd; n++) {
+		const unsigned int *u = &m_idx[3 * n];
+		const double *w = &m_w[3 * n];
+		const double *s0 = &src[(size_t) u[0] * nf];
+		const double *s1 = &src[(size_t) u[1] * nf];
+		const double *s2 = &src[(size_t) u[2] * nf];
+		double *d = &dst[(size_t) n * nf];
+
+		for (int f = 0; f < nf; f++)
+			d[f] = w[0] * s0[f] + w[1] * s1[f] + w[2] * s2[f];
+	}
+}
+//---------------------------------------------------------------------------
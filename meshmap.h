@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2014 Can Erkin Acar
+ * Copyright (C) 2014 Zeynep Akalin Acar
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef _MESHMAP_H_
+#define _MESHMAP_H_
+
+#include <vector>
+#include "mesh.h"
+
+using namespace std;
+
+// Transfer of node fields from a source mesh to the nodes of a target
+// mesh. Each target node is projected to the closest source element
+// and takes the barycentric combination of its three nodes, so the
+// map is a sparse matrix with three entries per row. It is built once
+// and applied to any number of fields.
+class MeshMap {
+public:
+	MeshMap(void) : m_src(NULL), m_dst(NULL), m_sver(0), m_dver(0),
+		m_maxdist(0) {};
+	~MeshMap(void) {};
+
+	// returns 0 on success
+	int build(const TriMeshLin &src, const TriMeshLin &dst);
+	// 1 if the map was built for these meshes as they are now
+	int current(const TriMeshLin &src, const TriMeshLin &dst) const;
+
+	// nf interleaved fields, value of field f at node n is at
+	// [n * nf + f] in both arrays
+	void apply(const double *src, double *dst, int nf = 1) const;
+
+	inline int getNumTarget(void) const
+		{ return m_idx.size() / 3; }
+	// largest projection distance
+	inline double getMaxDistance(void) const
+		{ return m_maxdist; }
+
+protected:
+	const TriMeshLin *m_src, *m_dst;
+	unsigned int m_sver, m_dver;
+	vector<unsigned int> m_idx;	// 3 source nodes per target node
+	vector<double> m_w;		// and their weights
+	double m_maxdist;
+};
+
+#endif
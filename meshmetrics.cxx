@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2014 Can Erkin Acar
+ * Copyright (C) 2014 Zeynep Akalin Acar
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include "meshmetrics.h"
+
+static const char *mq_elem_names[MQ_NUM_ELEM] = {
+	"aspect", "radius", "minangle", "maxangle",
+	"area", "minedge", "maxedge", "dihedral"};
+
+static const char *mq_node_names[MQ_NUM_NODE] = {
+	"valence", "edgelen", "nodearea"};
+
+#define RAD2DEG (180 / M_PI)
+
+//---------------------------------------------------------------------------
+MeshMetrics::MeshMetrics(TriMeshLin &msh) : m_mesh(msh), m_ne(0), m_nn(0)
+{
+}
+//---------------------------------------------------------------------------
+void
+MeshMetrics::update(void)
+{
+	m_ne = m_mesh.getNumTris();
+	m_nn = m_mesh.getNumVerts();
+
+	for (int m = 0; m < MQ_NUM_ELEM; m++)
+		m_elem[m].resize(m_ne);
+	for (int m = 0; m < MQ_NUM_NODE; m++)
+		m_node[m].resize(m_nn);
+	m_nrm.resize(3 * m_ne);
+
+	if (m_ne > 0)
+		updateElems();
+	if (m_nn > 0)
+		updateNodes();
+}
+//---------------------------------------------------------------------------
+void
+MeshMetrics::updateElems(void)
+{
+	double *aspect = &m_elem[MQ_ASPECT][0];
+	double *radius = &m_elem[MQ_RADIUS][0];
+	double *amin = &m_elem[MQ_MINANGLE][0];
+	double *amax = &m_elem[MQ_MAXANGLE][0];
+	double *area = &m_elem[MQ_AREA][0];
+	double *emin = &m_elem[MQ_MINEDGE][0];
+	double *emax = &m_elem[MQ_MAXEDGE][0];
+	double *dihed = &m_elem[MQ_DIHEDRAL][0];
+	double *nrm = &m_nrm[0];
+	const Point3 *verts = m_mesh.getVerts();
+	const unsigned int *tris = m_mesh.getTriIndex();
+
+#pragma omp parallel for schedule(static)
+	for (int f = 0; f < m_ne; f++) {
+		const Point3 &p0 = verts[tris[3 * f]];
+		const Point3 &p1 = verts[tris[3 * f + 1]];
+		const Point3 &p2 = verts[tris[3 * f + 2]];
+		Point3 e0 = p1 - p0, e1 = p2 - p1, e2 = p0 - p2;
+		Point3 n = Cross(e0, -e2);
+		double l0 = e0.length(), l1 = e1.length(), l2 = e2.length();
+		double a2 = n.length();		// twice the area
+
+		double lmin = fmin(l0, fmin(l1, l2));
+		double lmax = fmax(l0, fmax(l1, l2));
+		double s = (l0 + l1 + l2) / 2;
+
+		// angles at p0 and p1, p2 gets the rest
+		double t0 = atan2(a2, -e0.dot(e2));
+		double t1 = atan2(a2, -e0.dot(e1));
+		double t2 = M_PI - t0 - t1;
+
+		aspect[f] = (lmax > 0) ? lmin / lmax : 0;
+		radius[f] = (a2 > 0) ? 2 * a2 * a2 / (s * l0 * l1 * l2) : 0;
+		amin[f] = fmin(t0, fmin(t1, t2)) * RAD2DEG;
+		amax[f] = fmax(t0, fmax(t1, t2)) * RAD2DEG;
+		area[f] = a2 / 2;
+		emin[f] = lmin;
+		emax[f] = lmax;
+
+		if (a2 > 0)
+			n /= a2;
+		nrm[3 * f] = n.getX();
+		nrm[3 * f + 1] = n.getY();
+		nrm[3 * f + 2] = n.getZ();
+	}
+
+	// the neighbors need all normals
+#pragma omp parallel for schedule(static)
+	for (int f = 0; f < m_ne; f++) {
+		const double *nf = &nrm[3 * f];
+		double cmin = 1;
+
+		for (int m = 0; m < 3; m++) {
+			Edge *e = m_mesh.getEdge(tris[3 * f + m],
+						 tris[3 * f + (m + 1) % 3]);
+			for (int k = 0; e != NULL && k < e->nelem; k++) {
+				if (e->elem[k] == (unsigned int) f)
+					continue;
+				const double *ng = &nrm[3 * e->elem[k]];
+				double c = nf[0] * ng[0] + nf[1] * ng[1] +
+					nf[2] * ng[2];
+				if (c < cmin)
+					cmin = c;
+			}
+		}
+		dihed[f] = acos(fmax(-1, fmin(1, cmin))) * RAD2DEG;
+	}
+}
+//---------------------------------------------------------------------------
+void
+MeshMetrics::updateNodes(void)
+{
+	double *valence = &m_node[MQ_VALENCE][0];
+	double *elen = &m_node[MQ_EDGELEN][0];
+	double *narea = &m_node[MQ_NODEAREA][0];
+	const double *area = &m_elem[MQ_AREA][0];
+
+#pragma omp parallel for schedule(static)
+	for (int v = 0; v < m_nn; v++) {
+		Neighbor &nn = m_mesh.getNodeNbrs(v);
+		Neighbor &nf = m_mesh.getFaceNbrs(v);
+		const Point3 &p = m_mesh.getVertex(v);
+		double sum = 0;
+
+		for (int k = 0; k < nn.count(); k++)
+			sum += (m_mesh.getVertex(nn[k]) - p).length();
+		valence[v] = nn.count();
+		elen[v] = nn.count() ? sum / nn.count() : 0;
+
+		sum = 0;
+		for (int k = 0; k < nf.count(); k++)
+			sum += area[nf[k]];
+		narea[v] = sum / 3;
+	}
+}
+//---------------------------------------------------------------------------
+int
+MeshMetrics::findMetric(const char *name, int &node)
+{
+	for (int m = 0; m < MQ_NUM_ELEM; m++) {
+		if (strcmp(name, mq_elem_names[m]) == 0) {
+			node = 0;
+			return m;
+		}
+	}
+	for (int m = 0; m < MQ_NUM_NODE; m++) {
+		if (strcmp(name, mq_node_names[m]) == 0) {
+			node = 1;
+			return m;
+		}
+	}
+
+	return -1;
+}
+//---------------------------------------------------------------------------
+const char *
+MeshMetrics::metricName(int m, int node)
+{
+	if (node)
+		return (m >= 0 && m < MQ_NUM_NODE) ? mq_node_names[m] : NULL;
+	return (m >= 0 && m < MQ_NUM_ELEM) ? mq_elem_names[m] : NULL;
+}
+//---------------------------------------------------------------------------
+// linear interpolation between the closest ranks
+double
+MeshMetrics::percentile(const double *val, int n, double p)
+{
+	if (n <= 0)
+		return 0;
+
+	vector<double> v(val, val + n);
+	double pos = fmax(0, fmin(100, p)) / 100 * (n - 1);
+	int k = (int) pos;
+
+	nth_element(v.begin(), v.begin() + k, v.end());
+	double lo = v[k];
+	if (k + 1 >= n)
+		return lo;
+
+	double hi = *min_element(v.begin() + k + 1, v.end());
+	return lo + (hi - lo) * (pos - k);
+}
+//---------------------------------------------------------------------------
+void
+MeshMetrics::histogram(const double *val, int n, int nbins,
+		       double min, double max, vector<unsigned int> &hist)
+{
+	hist.assign(nbins, 0);
+	if (nbins <= 0)
+		return;
+
+	double scale = (max > min) ? nbins / (max - min) : 0;
+
+#pragma omp parallel
+	{
+		vector<unsigned int> h(nbins, 0);
+
+#pragma omp for schedule(static)
+		for (int i = 0; i < n; i++) {
+			int b = (int) ((val[i] - min) * scale);
+			if (b < 0)
+				b = 0;
+			else if (b >= nbins)
+				b = nbins - 1;
+			h[b]++;
+		}
+
+#pragma omp critical
+		for (int b = 0; b < nbins; b++)
+			hist[b] += h[b];
+	}
+}
+//---------------------------------------------------------------------------
+void
+MeshMetrics::printRow(FILE *f, const char *name, const double *val, int n)
+{
+	static const double pct[5] = { 0, 5, 50, 95, 100 };
+	vector<double> v(val, val + n);
+	double sum = 0;
+
+	for (int i = 0; i < n; i++)
+		sum += val[i];
+	sort(v.begin(), v.end());
+
+	fprintf(f, "%-10s", name);
+	for (int k = 0; k < 5; k++) {
+		double pos = pct[k] / 100 * (n - 1);
+		int i = (int) pos;
+		double x = 0;
+		if (n > 0)
+			x = (i + 1 < n) ? v[i] + (v[i + 1] - v[i]) * (pos - i) :
+				v[i];
+		fprintf(f, " %10.4g", x);
+	}
+	fprintf(f, " %10.4g\n", n ? sum / n : 0);
+}
+//---------------------------------------------------------------------------
+void
+MeshMetrics::printSummary(FILE *f) const
+{
+	fprintf(f, "%d elements, %d nodes\n", m_ne, m_nn);
+	fprintf(f, "%-10s %10s %10s %10s %10s %10s %10s\n", "metric",
+		"min", "5%", "median", "95%", "max", "mean");
+
+	for (int m = 0; m < MQ_NUM_ELEM; m++)
+		printRow(f, mq_elem_names[m], elemMetric(m), m_ne);
+	for (int m = 0; m < MQ_NUM_NODE; m++)
+		printRow(f, mq_node_names[m], nodeMetric(m), m_nn);
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2014 Can Erkin Acar
+ * Copyright (C) 2014 Zeynep Akalin Acar
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef _MESHMETRICS_H_
+#define _MESHMETRICS_H_
+
+#include <stdio.h>
+#include <vector>
+#include "mesh.h"
+
+using namespace std;
+
+// element metrics
+#define MQ_ASPECT	0	// shortest / longest edge
+#define MQ_RADIUS	1	// 2 * inradius / circumradius
+#define MQ_MINANGLE	2	// degrees
+#define MQ_MAXANGLE	3	// degrees
+#define MQ_AREA		4
+#define MQ_MINEDGE	5
+#define MQ_MAXEDGE	6
+#define MQ_DIHEDRAL	7	// largest normal angle to a neighbor, degrees
+#define MQ_NUM_ELEM	8
+
+// node metrics
+#define MQ_VALENCE	0	// number of neighbor nodes
+#define MQ_EDGELEN	1	// mean length of the node edges
+#define MQ_NODEAREA	2	// a third of the area of the node elements
+#define MQ_NUM_NODE	3
+
+// Quality metrics of the elements and nodes of a mesh. Each metric is
+// kept in its own array, computed for all elements (nodes) in parallel.
+// The values are those of the last update().
+class MeshMetrics {
+public:
+	MeshMetrics(TriMeshLin &msh);
+	~MeshMetrics(void) {};
+
+	void update(void);
+
+	inline const double *elemMetric(int m) const
+		{ return m_elem[m].empty() ? NULL : &m_elem[m][0]; }
+	inline const double *nodeMetric(int m) const
+		{ return m_node[m].empty() ? NULL : &m_node[m][0]; }
+	inline int getNumElems(void) const
+		{ return m_ne; }
+	inline int getNumNodes(void) const
+		{ return m_nn; }
+
+	// metric number by name, node is set for node metrics
+	static int findMetric(const char *name, int &node);
+	static const char *metricName(int m, int node);
+
+	// the p-th percentile (0 - 100) of n values
+	static double percentile(const double *val, int n, double p);
+	// counts of n values in nbins equal bins over [min, max]
+	static void histogram(const double *val, int n, int nbins,
+			      double min, double max,
+			      vector<unsigned int> &hist);
+
+	void printSummary(FILE *f) const;
+
+protected:
+	void updateElems(void);
+	void updateNodes(void);
+	static void printRow(FILE *f, const char *name,
+			     const double *val, int n);
+
+	TriMeshLin &m_mesh;
+	int m_ne, m_nn;
+	vector<double> m_elem[MQ_NUM_ELEM];
+	vector<double> m_node[MQ_NUM_NODE];
+	vector<double> m_nrm;		// unit element normals, 3 per element
+};
+
+#endif
@@ -18,7 +18,10 @@
  */
 #include <vector>
 #include <set>
+#include <algorithm>
 #include "meshproc.h"
+#include "meshbvh.h"
+#include "meshcurv.h"
 
 #define INT_EPS 1e-8
 
@@ -318,194 +321,31 @@ MeshProc::minimumEdgeDistance(int node)
 
 }
 //---------------------------------------------------------------------------
-// Split the element and add the resulting elements to the faces vector
-#define V_INVAL 0xFFFFFFFF
-int
-MeshProc::splitElement(unsigned int e, vector<unsigned int> &faces)
-{
-	int nf = 0;
-	unsigned int p1 = m_mesh->getElemInd(e, 0);
-	unsigned int p2 = m_mesh->getElemInd(e, 1);
-	unsigned int p3 = m_mesh->getElemInd(e, 2);
-
-	Edge *e1 = m_mesh->getEdge(p1, p2);
-	Edge *e2 = m_mesh->getEdge(p2, p3);
-	Edge *e3 = m_mesh->getEdge(p3, p1);
-
-	unsigned int c1 = e1->store;
-	unsigned int c2 = e2->store;
-	unsigned int c3 = e3->store;
-
-	if (c1 == V_INVAL && c2 == V_INVAL && c3 == V_INVAL) {
-		faces.push_back(p1);
-		faces.push_back(p2);
-		faces.push_back(p3);
-		return 1;
-	}
-
-	// If only one edge is divided, split into two
-	if (c1 == V_INVAL && c2 == V_INVAL) {
-		// [p1 p2 c3]
-		faces.push_back(p1);
-		faces.push_back(p2);
-		faces.push_back(c3);
-		// [c3 p2 p3]
-		faces.push_back(c3);
-		faces.push_back(p2);
-		faces.push_back(p3);
-		return 2;
-	}
-	if (c1 == V_INVAL && c3 == V_INVAL) {
-		// [p1 p2 c2]
-		faces.push_back(p1);
-		faces.push_back(p2);
-		faces.push_back(c2);
-		// [p1 c2 p3]
-		faces.push_back(p1);
-		faces.push_back(c2);
-		faces.push_back(p3);
-		return 2;
-	}
-	if (c2 == V_INVAL && c3 == V_INVAL) {
-		// [p1 c1 p3]
-		faces.push_back(p1);
-		faces.push_back(c1);
-		faces.push_back(p3);
-		// [c1 p2 p3]
-		faces.push_back(c1);
-		faces.push_back(p2);
-		faces.push_back(p3);
-		return 2;
-	}
-
-	if (c1 == V_INVAL) {
-		splitElement3(faces, p1, p2, p3, c2, c3);
-		return 3;
-	}
-	if (c2 == V_INVAL) {
-		splitElement3(faces, p2, p3, p1, c3, c1);
-		return 3;
-	}
-	if (c3 == V_INVAL) {
-		splitElement3(faces, p3, p1, p2, c1, c2);
-		return 3;
-	}
-
-	// [p1 c1 c3]
-	faces.push_back(p1);
-	faces.push_back(c1);
-	faces.push_back(c3);
-	// [c1 p2 c2]
-	faces.push_back(c1);
-	faces.push_back(p2);
-	faces.push_back(c2);
-	// [c3 c2 p3]
-	faces.push_back(c3);
-	faces.push_back(c2);
-	faces.push_back(p3);
-	// [c1 c2 c3]
-	faces.push_back(c1);
-	faces.push_back(c2);
-	faces.push_back(c3);
-
-	return 4;
-}
-//---------------------------------------------------------------------------
-// Assume edges 2 and 3 need to be split, and split the element by
-// using the shortest edge of |p1 c2| and |p2 c3|
-void
-MeshProc::splitElement3(vector<unsigned int> &faces,
-			unsigned int p1, unsigned int p2, unsigned int p3,
-			unsigned int c2, unsigned int c3)
-{
-	Point3 v1(m_mesh->getVertex(p1));
-	Point3 v2(m_mesh->getVertex(p2));
-
-	v1 -= m_mesh->getVertex(c2);
-	v2 -= m_mesh->getVertex(c3);
-
-	// [c3 c2 p3] common to all
-	faces.push_back(c3);
-	faces.push_back(c2);
-	faces.push_back(p3);
-
-	if (v1.length2() < v2.length2()) {
-		// [p1 c2 c3]
-		faces.push_back(p1);
-		faces.push_back(c2);
-		faces.push_back(c3);
-		// [p1 p2 c2]
-		faces.push_back(p1);
-		faces.push_back(p2);
-		faces.push_back(c2);
-	} else {
-		// [p2 c2 c3]
-		faces.push_back(p2);
-		faces.push_back(c2);
-		faces.push_back(c3);
-		// [p1 p2 c3]
-		faces.push_back(p1);
-		faces.push_back(p2);
-		faces.push_back(c3);
-	}
-}
-//---------------------------------------------------------------------------
+// split the edges longer than thresh at their midpoints
 void
 MeshProc::splitEdges(double thresh)
 {
+	vector<unsigned int> nodes;
+	vector<Point3> pos;
+
 	for (EdgeIter it(*m_mesh); it.value(); it.next()) {
 		Edge *e = it.value();
-		Point3 p1(m_mesh->getVertex(e->node1));
-		Point3 p2(m_mesh->getVertex(e->node2));
-		Point3 vl = p2 - p1;
+		const Point3 &p1 = m_mesh->getVertex(e->node1);
+		const Point3 &p2 = m_mesh->getVertex(e->node2);
 
-		double dist = vl.length();
-		vl /= dist;
-		if (dist < thresh) {
-			e->store = V_INVAL;
+		if (e->nelem == 0 || (p2 - p1).length() < thresh)
 			continue;
-		}
 
-		Point3 pm = (p1 + p2)/2;
-#ifdef NOTYET
-		// XXX try to calculate a 'better' midpoint
-		
-		Point3 vn = (m_mesh->getVertexNormal(e->node1) +
-			     m_mesh->getVertexNormal(e->node2)) / 2;
-		Point3 vp = Cross(vl, vn);
-#endif
-		e->store = m_mesh->addVertex(pm);
+		nodes.push_back(e->node1);
+		nodes.push_back(e->node2);
+		pos.push_back((p1 + p2) / 2);
 	}
 
-	unsigned int ne = m_mesh->getNumTris();
+	int ns = m_mesh->splitEdges(nodes, pos);
 
-#if 0
-	for (unsigned int e = 0; e < ne; e++) {
-		vector<unsigned> faces;
-		int ne = splitElement(e, faces);
-		if (ne == 1)
-			continue;
-
-		MESH_LOG("Splitting element %d by %d:\n", e, ne);
-		// replace the element
-		m_mesh->changeElem(e, faces[0], faces[1], faces[2]);
-		int p = 3;
-		
-		// and add the remaining elements
-		for (int i = 1; i < ne; i++, p += 3) {
-			int e = m_mesh->addElem(faces[p], faces[p+1], faces[p+2]);
-			MESH_LOG("Added element %d\n", e);
-		}
-	}
-#else
-	vector<unsigned> faces;
-	for (unsigned int e = 0; e < ne; e++)
-		int ne = splitElement(e, faces);
-
-	m_mesh->replaceElements(faces);
-#endif
+	printf("Split %d of %d edges\n", ns, (int)pos.size());
 }
-
+//---------------------------------------------------------------------------
 SCache *
 MeshProc::createElementCache(void)
 {
@@ -1112,323 +952,239 @@ MeshProc::extractClass(int cls)
 	return msh;
 }
 //---------------------------------------------------------------------------
-void
+// weld the vertices closer than dist, removing the elements that
+// become degenerate or duplicate
+int
 MeshProc::mergeVertices(double dist)
 {
-	SCache sc(m_mesh->getMin(), m_mesh->getSize(), 16);
-
 	if (dist <= 0)
 		dist = averageEdgeDistance() / 100;
 
-	unsigned int nv = m_mesh->getNumVerts();
-
-	sc.resize(nv);
-
 	printf("Checking close vertices, eps: %g\n", dist);
 
-	for (unsigned int v = 0; v < nv; v++) {
-		const Point3 &pv = m_mesh->getVertex(v);
-		Sphere3 vs(pv, dist);
-		SCache::spset_t eset;
+	unsigned int nv = m_mesh->getNumVerts();
+	int ne = m_mesh->removeDuplicates(dist);
 
-		sc.intersect(vs, eset);
-		if (eset.empty()) {
-			sc.addSphere(v, vs);
-			continue;
-		}
-		
-//		printf("Vertex %d close to %d vertices:\n", v, eset.size());
-		SCache::spset_t::iterator it;
-		for (it = eset.begin(); it != eset.end(); it++) {
-			unsigned int vi = *it;
-			const Point3 &pvi = m_mesh->getVertex(vi);
-			double dist = (pvi - pv).length();
-//			printf("  %d (%g)\n", vi, dist);
-			if (dist > INT_EPS)
-				continue;
-			printf("Vertex %d identical to %d (%g):\n",
-			       v, vi, dist);
-			Edge *ed = m_mesh->getEdge(v, vi);
-			if (ed != NULL)
-				printf("  Edge between identical vertices!\n");
-
-			Neighbor &nf = m_mesh->getFaceNbrs(v);
-			while (nf.count()) {
-				unsigned e = nf[0];
-				unsigned v0 = m_mesh->getElemInd(e, 0);
-				unsigned v1 = m_mesh->getElemInd(e, 1);
-				unsigned v2 = m_mesh->getElemInd(e, 2);
-				printf("  Elem: %d (%d %d %d)",
-				       e, v0, v1, v2);
-				if (v0 == v)
-					v0 = vi;
-				if (v1 == v)
-					v1 = vi;
-				if (v2 == v)
-					v2 = vi;
-
-				printf(" -> (%d %d %d)\n", v0, v1, v2);
-				
-				m_mesh->changeElem(e, v0, v1, v2);
-				printf("  modified element %d\n", e);
-			}
-		}
-	}
-	m_mesh->recalculateEdges();
+	printf("Removed %d vertices and %d elements\n",
+	       nv - m_mesh->getNumVerts(), ne);
+
+	return nv - m_mesh->getNumVerts();
 }
 //---------------------------------------------------------------------------
-void
+// remove the elements repeating another one. If ef is given it is set
+// to the number of removed copies of each remaining element.
+int
 MeshProc::mergeElements(double *ef)
 {
-	SCache sc(m_mesh->getMin(), m_mesh->getSize(), 16);
-
-	unsigned int ne = m_mesh->getNumTris();
-
-	sc.resize(ne);	
-
-	double dist = averageEdgeDistance() / 100;
-
-	printf("Checking for identical elements, eps: %g\n", dist);
-	list<unsigned int> eset;
-	set<unsigned int> vset;
+	vector<int> dups;
 
-	for (unsigned int e = 0; e < ne; e++) {
-		unsigned int ia = m_mesh->getElemInd(e, 0);
-		unsigned int ib = m_mesh->getElemInd(e, 1);
-		unsigned int ic = m_mesh->getElemInd(e, 2);
+	printf("Checking for identical elements\n");
 
-		const Point3 &p0 = m_mesh->getVertex(ia);
-		const Point3 &p1 = m_mesh->getVertex(ib);
-		const Point3 &p2 = m_mesh->getVertex(ic);
-
-		Sphere3 es((p0 + p1 + p2)/2, dist);
-		SCache::spset_t iset;
+	int ne = m_mesh->removeDuplicates(-1, &dups);
 
-		if (ef)
-			ef[e] = 0;
+	if (ef)
+		for (unsigned int e = 0; e < dups.size(); e++)
+			ef[e] = dups[e];
 
-		sc.intersect(es, iset);
-		if (iset.empty()) {
-			sc.addSphere(e, es);
-			continue;
-		}
+	printf("Removed %d identical elements\n", ne);
 
-		SCache::spset_t::iterator it;
-		for (it = iset.begin(); it != iset.end(); it++) {
-
-			unsigned int ei = *it;
-			unsigned int ia2 = m_mesh->getElemInd(e, 0);
-			unsigned int ib2 = m_mesh->getElemInd(e, 1);
-			unsigned int ic2 = m_mesh->getElemInd(e, 2);
-
-			if (((ia2 == ia) || (ia2 == ib) || (ia2 == ic)) &&
-			    ((ib2 == ia) || (ib2 == ib) || (ib2 == ic)) &&
-			    ((ic2 == ia) || (ic2 == ib) || (ic2 == ic))) {
-				printf("Elements %d and %d are identical\n",
-				       e, ei);
-
-				// delete the element and all the nbrs
-				vset.insert(e);
-//				vset.insert(ei);
-				for (int m = 0; m < 3; m++) {
-					int v = m_mesh->getElemInd(e, m);
-					Neighbor &n1 = m_mesh->getFaceNbrs(v);
-					printf("e: %d, v: %d nb: %d\n",
-					       e, v, n1.count());
-//					for (int n = 0; n < n1.count(); n++)
-//						vset.insert(n1[n]);
-
-					v = m_mesh->getElemInd(ei, m);
-					Neighbor &n2 = m_mesh->getFaceNbrs(v);
-					printf("e: %d, v: %d nb: %d\n",
-					       ei, v, n2.count());
-//					for (int n = 0; n < n2.count(); n++)
-//						vset.insert(n2[n]);
-
-				}
-
-				if (ef) {
-//					ef[e]++;
-					ef[ei]++;
-				}
-			}
-		}
-	}
-
-	set<unsigned int>::iterator vi;
-	for (vi = vset.begin(); vi != vset.end(); vi++) {
-		unsigned int e = *vi;
-		eset.push_front(e);
-	}
-	while(!eset.empty()) {
-		unsigned int e = eset.front();;
-		m_mesh->delElem(e);
-		eset.pop_front();
-	}
-
-	m_mesh->recalculateEdges();
+	return ne;
 }
 //---------------------------------------------------------------------------
-#define SHARP_THRESH -0.98	// 168.5 deg
 int
-MeshProc::checkSharpEdge(
-	unsigned int el, unsigned int v1, unsigned int v2,
-	set<unsigned int> &eset)
+MeshProc::sharpNeighbors(unsigned int el, unsigned int *nbrs)
 {
-	Edge *e = m_mesh->getEdge(v1, v2);
-	int sharp = 0;
-
-	if (e == NULL) {
-		printf ("Invalid edge <%u %u> on element %u\n", v1, v2, el);
-		return 0;
-	}
-
 	const Point3 &n1 = m_mesh->getFaceNormal(el);
+	int ns = 0;
 
-	for (int n = 0; n < e->nelem; n++) {
-		if (e->elem[n] == el)
+	for (int i = 0; i < 3; i++) {
+		Edge *e = m_mesh->getEdge(m_mesh->getElemInd(el, i),
+					  m_mesh->getElemInd(el, (i + 1) % 3));
+		if (e == NULL)
 			continue;
-		
-		double dot = n1.dot(m_mesh->getFaceNormal(e->elem[n]));
 
-		if (dot < SHARP_THRESH) {
-			printf("Sharp edge <%u %u> between %u and %u\n",
-			       v1, v2, el, e->elem[n]);
-			eset.insert(e->elem[n]);
-			sharp++;
+		for (int n = 0; n < e->nelem; n++) {
+			unsigned int en = e->elem[n];
+			if (en == el)
+				continue;
+			if (n1.dot(m_mesh->getFaceNormal(en)) >= m_sharp)
+				continue;
+			int m;
+			for (m = 0; m < ns; m++)
+				if (nbrs[m] == en)
+					break;
+			if (m == ns)
+				nbrs[ns++] = en;
 		}
 	}
-	return sharp;
-}
 
+	return ns;
+}
 //---------------------------------------------------------------------------
+// marks the elements with sharp edges in ef (if not NULL)
+// returns the number of such elements
 int
-MeshProc::printSharpEdges(void)
+MeshProc::findSharpElements(double *ef)
 {
-	int se, rf;
-
-	printf("Checking for sharp edges\n");
-
-	unsigned int ne = m_mesh->getNumTris();
-	se = rf = 0;
-	for (unsigned int e = 0; e < ne; e++) {
-		unsigned int v1 = m_mesh->getElemInd(e, 0);
-		unsigned int v2 = m_mesh->getElemInd(e, 1);
-		unsigned int v3 = m_mesh->getElemInd(e, 2);
-		unsigned int nv[3];
-		unsigned int ne[3];
-		unsigned int idx = 0;
-			
-		set<unsigned int> eset;
-		set<unsigned int>::iterator vi;
+	int ne = m_mesh->getNumTris();
+	int se = 0;
 
-		checkSharpEdge(e, v1, v2, eset);
-		checkSharpEdge(e, v1, v3, eset);
-		checkSharpEdge(e, v3, v2, eset);
+	// face normals are computed once, the sweep is read only
+	m_mesh->calcFaceNorm();
 
-		if (eset.size() == 0)
-			continue;
-
-		printf ("Element %u has %lu sharp edges:",
-			e, eset.size());
-		se++;
-		for (vi = eset.begin(); vi != eset.end(); vi++)
-			printf(" %u", *vi);
-		printf("\n");
+#pragma omp parallel for reduction(+:se)
+	for (int e = 0; e < ne; e++) {
+		unsigned int nbrs[3 * MAX_EDGE_ELEM];
+		int ns = sharpNeighbors(e, nbrs);
+		if (ns)
+			se++;
+		if (ef)
+			ef[e] = ns ? 1 : 0;
 	}
 
 	return se;
 }
 //---------------------------------------------------------------------------
 int
-MeshProc::flipSharpEdges(void)
+MeshProc::printSharpEdges(double *ef)
 {
-	int se, rf, nm = 0;
+	printf("Checking for sharp edges\n");
 
-	printf("Flipping sharp edges\n");
+	return findSharpElements(ef);
+}
+//---------------------------------------------------------------------------
+#define SHARP_MIN_ANGLE	20	// degrees
+// sets the sharp edge threshold from the curvature instead of the fixed
+// SHARP_THRESH: normals may turn by up to factor times the angle a smooth
+// surface with the 95th percentile curvature turns over an average edge.
+// returns the threshold angle in degrees.
+double
+MeshProc::sharpFromCurvature(const MeshCurvature &mc, double factor)
+{
+	int nn = mc.getNumNodes();
+	if (nn == 0)
+		return acos(m_sharp) * 180 / M_PI;
+
+	vector<double> k(nn);
+	for (int v = 0; v < nn; v++)
+		k[v] = mc.maxAbs(v);
+	int n95 = (int) (0.95 * (nn - 1));
+	nth_element(k.begin(), k.begin() + n95, k.end());
+
+	double ang = factor * k[n95] * averageEdgeDistance() * 180 / M_PI;
+	double amax = acos(SHARP_THRESH) * 180 / M_PI;
+	if (ang < SHARP_MIN_ANGLE)
+		ang = SHARP_MIN_ANGLE;
+	if (ang > amax)
+		ang = amax;
+
+	m_sharp = cos(ang * M_PI / 180);
+	return ang;
+}
+//---------------------------------------------------------------------------
+// one parallel sweep collects the elements with sharp edges, then the
+// worklist is processed one flip at a time and only the elements around
+// the modified vertices are queued again. Returns the number of elements
+// still with sharp edges (marked in ef as findSharpElements does), the
+// number of flips goes to flips.
+int
+MeshProc::flipSharpEdges(double *ef, int *flips)
+{
+	int ne = m_mesh->getNumTris();
+	int nm = 0;
 
+	printf("Flipping sharp edges\n");
 
-	do {
-		unsigned int ne = m_mesh->getNumTris();
-		se = rf = 0;
-		for (unsigned int e = 0; e < ne; e++) {
-			unsigned int v1 = m_mesh->getElemInd(e, 0);
-			unsigned int v2 = m_mesh->getElemInd(e, 1);
-			unsigned int v3 = m_mesh->getElemInd(e, 2);
-			unsigned int nv[3];
-			unsigned int ne[3];
-			unsigned int idx = 0;
+	vector<char> sharp(ne);
+	m_mesh->calcFaceNorm();
 
-			
-			set<unsigned int> eset;
-			set<unsigned int>::iterator vi;
+#pragma omp parallel for
+	for (int e = 0; e < ne; e++) {
+		unsigned int nbrs[3 * MAX_EDGE_ELEM];
+		sharp[e] = sharpNeighbors(e, nbrs) > 1;
+	}
 
-			checkSharpEdge(e, v1, v2, eset);
-			checkSharpEdge(e, v1, v3, eset);
-			checkSharpEdge(e, v3, v2, eset);
+	// the worklist refers to elements by their vertices, element
+	// indices change when elements are deleted
+	vector<unsigned int> wl;
+	for (int e = 0; e < ne; e++) {
+		if (!sharp[e])
+			continue;
+		for (int i = 0; i < 3; i++)
+			wl.push_back(m_mesh->getElemInd(e, i));
+	}
 
-			if (eset.size() == 0)
-				continue;
+	for (unsigned int w = 0; w < wl.size(); w += 3) {
+		int e = m_mesh->findElem(wl[w], wl[w + 1], wl[w + 2]);
+		if (e < 0)
+			continue;
 
-			printf ("Element %u has %lu sharp edges:",
-				e, eset.size());
-			se++;
-			for (vi = eset.begin(); vi != eset.end(); vi++)
-				printf(" %u", *vi);
-			printf("\n");
+		unsigned int nbrs[3 * MAX_EDGE_ELEM];
+		int ns = sharpNeighbors(e, nbrs);
 
-			if (eset.size() < 2)
-				continue;
+		if (ns < 2 || ns > 3)
+			continue;
 
-			if (eset.size() > 3)
-				continue;
+		unsigned int v1 = m_mesh->getElemInd(e, 0);
+		unsigned int v2 = m_mesh->getElemInd(e, 1);
+		unsigned int v3 = m_mesh->getElemInd(e, 2);
+		unsigned int nv[3];
+		int rf = 0;
 
-			printf("Trying to collapse edge\n");
-			
-			for (vi = eset.begin(); vi != eset.end(); vi++) {
-				unsigned int v;
-				for (int i = 0; i < 3; i++) {
-					v = m_mesh->getElemInd(*vi, i);
-					if (v != v1 && v != v2 && v != v3)
-						break;
-				}
-				ne[idx] = *vi;
-				nv[idx] = v;
-				idx++;
+		for (int n = 0; n < ns; n++) {
+			unsigned int v;
+			for (int i = 0; i < 3; i++) {
+				v = m_mesh->getElemInd(nbrs[n], i);
+				if (v != v1 && v != v2 && v != v3)
+					break;
 			}
+			nv[n] = v;
+		}
 
-			if (idx == 2) {
-				if (nv[0] == nv[1])
-					rf = flipSharp(e, ne[0], ne[1], nv[0]);
-			} else {
-				if (nv[0] == nv[1]) 
-					rf = flipSharp(e, ne[0], ne[1], nv[0]);
-				else if (nv[0] == nv[2])
-					rf = flipSharp(e, ne[0], ne[2], nv[2]);
-				else if (nv[1] == nv[2])
-					rf = flipSharp(e, ne[1], ne[2], nv[1]);
-			}
-			if (rf) {
-				printf("Elements modified, restart search\n");
-				nm++;
-				break;
-			}
+		unsigned int vmod[4];
+		if (nv[0] == nv[1])
+			rf = flipSharp(e, nbrs[0], nbrs[1], nv[0], vmod);
+		else if (ns == 3 && nv[0] == nv[2])
+			rf = flipSharp(e, nbrs[0], nbrs[2], nv[2], vmod);
+		else if (ns == 3 && nv[1] == nv[2])
+			rf = flipSharp(e, nbrs[1], nbrs[2], nv[1], vmod);
+
+		if (!rf)
+			continue;
+
+		nm++;
+		for (int i = 0; i < 4; i++) {
+			Neighbor &nb = m_mesh->getFaceNbrs(vmod[i]);
+			for (int n = 0; n < nb.count(); n++)
+				for (int m = 0; m < 3; m++)
+					wl.push_back(m_mesh->getElemInd(nb[n], m));
 		}
-	} while(rf);
+	}
+
+	if (nm)
+		m_mesh->recalculateEdges();
 
-	printf("flipSharpEdges: %d flipped, %d remaining\n", nm, se);
+	int se = findSharpElements(ef);
+	printf("flipSharpEdges: %d flips, %d remaining\n", nm, se);
 
-	return nm;
+	if (flips)
+		*flips = nm;
+	return se;
 }
 //---------------------------------------------------------------------------
+// element e0 and its sharp neighbors e1 and e2 share the vertex vx, and
+// e1 and e2 share the vertex v0 across. Replaces the three elements by a
+// single element connecting v0 to the remaining edge of e0. The modified
+// vertices are returned in vmod.
 int
-MeshProc::flipSharp(unsigned int e0, unsigned int e1, unsigned int e2, unsigned int v0)
+MeshProc::flipSharp(unsigned int e0, unsigned int e1, unsigned int e2,
+		    unsigned int v0, unsigned int *vmod)
 {
-	unsigned int vl[3];
+	unsigned int u[3];
 	int vi = 0, vx = -1;
 
 	for (int i = 0; i < 3; i++) {
-		unsigned int v = m_mesh->getElemInd(e0, i);
+		unsigned int v = u[i] = m_mesh->getElemInd(e0, i);
 		int match = 0;
 		for (int j = 0; j < 3; j++) {
 			if (v == m_mesh->getElemInd(e1, j)) {
@@ -1443,9 +1199,9 @@ MeshProc::flipSharp(unsigned int e0, unsigned int e1, unsigned int e2, unsigned
 			}
 		}
 		if (match == 1)
-			vl[vi++] = v;
+			vi++;
 		if (match == 2)
-			vx = v;
+			vx = i;
 	}
 
 	if (vi != 2 || vx == -1) {
@@ -1453,6 +1209,10 @@ MeshProc::flipSharp(unsigned int e0, unsigned int e1, unsigned int e2, unsigned
 		return 0;
 	}
 
+	// keep the orientation of the remaining edge of e0
+	unsigned int vl0 = u[(vx + 1) % 3];
+	unsigned int vl1 = u[(vx + 2) % 3];
+
 	if (e1 > e2)
 		m_mesh->delElem(e1);
 
@@ -1461,18 +1221,94 @@ MeshProc::flipSharp(unsigned int e0, unsigned int e1, unsigned int e2, unsigned
 	if (e1 < e2)
 		m_mesh->delElem(e1);
 
-	m_mesh->changeElem(e0, v0, vl[0], vl[1]);
+	// e0 may have been moved by the deletions
+	int e = m_mesh->findElem(u[0], u[1], u[2]);
+	assert(e >= 0);
+	m_mesh->changeElem(e, v0, vl0, vl1);
 
-	printf("v0:%u, vl0:%u, vl1:%u, vx:%u [", v0, vl[0], vl[1], vx);
+	vmod[0] = v0;
+	vmod[1] = vl0;
+	vmod[2] = vl1;
+	vmod[3] = u[vx];
 
-	Neighbor &nb = m_mesh->getNodeNbrs(vx);
-	for (int i = 0; i < nb.count(); i++)
-		printf(" %u", nb[i]);
-	printf("]\n");
+	for (int i = 0; i < 4; i++)
+		m_mesh->pruneEdges(vmod[i]);
 
-	m_mesh->getNodeNbrs(vx).del(v0);
-
-	printf("Recompute ...\n");
-	m_mesh->recalculateEdges();
 	return 1;
 }
+//---------------------------------------------------------------------------
+// distance of each vertex to the surface in bvh. Returns the maximum
+// (one sided Hausdorff distance sampled at the vertices) and the RMS
+// deviation in rms. The distance to the previous vertex in the same
+// thread bounds the search for the next one.
+double
+MeshProc::deviation(const MeshBVH &bvh, double *dist, double &rms)
+{
+	int nv = m_mesh->getNumVerts();
+	double dmax = 0, sum = 0;
+
+	if (nv == 0) {
+		rms = 0;
+		return 0;
+	}
+
+#pragma omp parallel
+	{
+		int prev = -1;
+#pragma omp for schedule(static) reduction(max:dmax) reduction(+:sum)
+		for (int v = 0; v < nv; v++) {
+			const Point3 &p = m_mesh->getVertex(v);
+			double bound = -1;
+			if (prev >= 0)
+				bound = dist[prev] +
+					(p - m_mesh->getVertex(prev)).length();
+			double d = bvh.nearest(p, bound);
+			if (d < 0)
+				d = bvh.nearest(p);
+			dist[v] = d;
+			if (d > dmax)
+				dmax = d;
+			sum += d * d;
+			prev = v;
+		}
+	}
+
+	rms = sqrt(sum / nv);
+	return dmax;
+}
+//---------------------------------------------------------------------------
+// one sided Hausdorff distance from the vertices to the surface in bvh.
+// Vertices that are closer than the current maximum can not change the
+// result, so their search stops at the first such triangle.
+double
+MeshProc::hausdorff(const MeshBVH &bvh, double lower)
+{
+	int nv = m_mesh->getNumVerts();
+	double dmax = lower;
+
+#pragma omp parallel
+	{
+		int prev = -1;
+		double dprev = 0, hmax = lower;
+#pragma omp for schedule(static) reduction(max:dmax)
+		for (int v = 0; v < nv; v++) {
+			const Point3 &p = m_mesh->getVertex(v);
+			double bound = -1;
+			if (prev >= 0)
+				bound = dprev +
+					(p - m_mesh->getVertex(prev)).length();
+			double d = bvh.nearest(p, bound, NULL, NULL, hmax);
+			if (d < 0)
+				d = bvh.nearest(p, -1, NULL, NULL, hmax);
+			if (d > hmax)
+				hmax = d;
+			if (d > dmax)
+				dmax = d;
+			dprev = d;
+			prev = v;
+		}
+	}
+
+	return dmax;
+}
+//---------------------------------------------------------------------------
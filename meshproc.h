@@ -24,10 +24,17 @@
 #include "mesh.h"
 #include "scache.h"
 
+class MeshBVH;
+class MeshCurvature;
+
+// cosine of the normal angle above which an edge is sharp
+#define SHARP_THRESH -0.98	// 168.5 deg
+
 class MeshProc {
 public:
-	MeshProc(TriMeshLin *msh) : m_mesh(msh) {};
-	MeshProc(MeshProc &mp) { m_mesh = mp.getMesh();}
+	MeshProc(TriMeshLin *msh) : m_mesh(msh), m_sharp(SHARP_THRESH) {};
+	MeshProc(MeshProc &mp) { m_mesh = mp.getMesh();
+		m_sharp = mp.getSharpThreshold(); }
 
 	TriMeshLin *getMesh(void) {return m_mesh;}
 
@@ -41,34 +48,41 @@ public:
 	void splitIntersecting(void);
 	int printIntersecting(void);
 	int pushIntersecting(void);
-	void mergeVertices(double dist);
-	void mergeElements(double *ef = NULL);
-	int printSharpEdges(void);
-	int flipSharpEdges(void);
+	int mergeVertices(double dist);
+	int mergeElements(double *ef = NULL);
+	int printSharpEdges(double *ef = NULL);
+	int flipSharpEdges(double *ef = NULL, int *flips = NULL);
+	double sharpFromCurvature(const MeshCurvature &mc,
+				  double factor = 4);
+
+	inline double getSharpThreshold(void) const
+		{ return m_sharp; }
+	inline void setSharpThreshold(double c)
+		{ m_sharp = c; }
 
 	TriMeshLin *extractClass(int cls);
 
+	double deviation(const MeshBVH &bvh, double *dist, double &rms);
+	double hausdorff(const MeshBVH &bvh, double lower = 0);
+
 	typedef set<unsigned int> nodeset_t;
 	typedef vector<unsigned> nodelist_t;
 
 protected:
 	int edgeNearest(const Point3 &p1, const Point3 &p2,
 			const Point3 &pt, Point3 &pi) const;
-	int splitElement(unsigned int e, vector<unsigned int> &faces);
-	void splitElement3(vector<unsigned int> &faces,
-			   unsigned int p1, unsigned int p2, unsigned int p3,
-			   unsigned int c2, unsigned int c3);
 	void triangulateElement(unsigned int e,
 				nodelist_t &faces, const nodeset_t nl);
 	int elementBoundingSphere(Point3 a, Point3 b, Point3 c,
 				  Point3 &center, double &r);
 	SCache *createElementCache(void);
-	int checkSharpEdge(unsigned int el, unsigned int v1, unsigned int v2,
-			   set<unsigned int> &eset);
+	int sharpNeighbors(unsigned int el, unsigned int *nbrs);
+	int findSharpElements(double *ef);
 	int flipSharp(unsigned int e0, unsigned int e1,
-		      unsigned int e2, unsigned int v0);
+		      unsigned int e2, unsigned int v0, unsigned int *vmod);
 
 	TriMeshLin *m_mesh;
+	double m_sharp;
 };
 
 
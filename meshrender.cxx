@@ -18,8 +18,22 @@
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
+#define GL_GLEXT_PROTOTYPES
 #include <GL/gl.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
 #include "meshrender.h"
+#include "meshproc.h"
+
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE 0x812F
+#endif
+#ifndef GL_COMBINE
+#define GL_COMBINE	0x8570
+#define GL_COMBINE_RGB	0x8571
+#define GL_RGB_SCALE	0x8573
+#endif
 //---------------------------------------------------------------------------
 MeshRender::MeshRender(TriMeshLin &mesh)
 {
@@ -31,30 +45,60 @@ MeshRender::MeshRender(TriMeshLin &mesh)
 
 	m_log = false;
 
-	m_eprops.resize(m_mesh->getNumTris());
-	m_nprops.resize(m_mesh->getNumVerts());
+	m_clipX0 = m_clipY0 = m_clipZ0 = -1e10;
+	m_clipX1 = m_clipY1 = m_clipZ1 = 1e10;
+
+	m_expanded = false;
+	m_arrays_valid = false;
+	m_arrays_mode = 0;
+	m_layout = 0;
+	m_lines_valid = false;
+	m_lines_mode = m_lines_layout = m_lines_geom = 0;
+	m_lines_sharp = 0;
+	m_sharp = SHARP_THRESH;
+	m_tex_base = 0;
+	m_arrays_cmode = 0;
+	m_section_valid = false;
+	m_section_geom = m_section_clip = 0;
+	m_bvh = NULL;
+	m_bvh_geom = 0;
+	m_lut = 0;
+	m_lut_ver = 0;
+	m_lut_log = false;
+	m_lut_del = 0;
+#ifdef MR_USE_VBO
+	for (int b = 0; b < MR_NUM_BUF; b++)
+		m_vbo[b] = 0;
+#endif
+
+	m_cmap = NULL;
 	colormapDefault();
 }
 //---------------------------------------------------------------------------
+MeshRender::~MeshRender(void)
+{
+#ifdef MR_USE_VBO
+	if (m_vbo[0])
+		glDeleteBuffers(MR_NUM_BUF, m_vbo);
+#endif
+	if (m_lut)
+		glDeleteTextures(1, &m_lut);
+	if (m_cmap)
+		m_cmap->unref();
+	delete m_bvh;
+}
+//---------------------------------------------------------------------------
 int
 MeshRender::render(int fclass)
 {
         if (m_flags & MRF_HIDDEN)
                 return 0;
 
-	if (m_flags & MRF_SHOW_EDGES) {
+	if (m_flags & (MRF_SHOW_EDGES | MRF_EDGE_SELECT)) {
 		glEnable(GL_POLYGON_OFFSET_FILL);
 		glPolygonOffset(1, 0);
 	}
 
-	if ((m_flags & MRF_SHOW_ECOLOR) &&
-	    m_eprops.size() != m_mesh->getNumTris())
-		m_eprops.resize(m_mesh->getNumTris());
-
-	if ((m_flags & (MRF_SHOW_NCOLOR | MRF_SHOW_NBGRND)) &&
-	    m_nprops.size() != m_mesh->getNumVerts())
-		m_nprops.resize(m_mesh->getNumVerts());
-
 	if ((m_flags & (MRF_SHOW_ECOLOR | MRF_SHOW_NCOLOR |
 			MRF_SHOW_EBGRND | MRF_SHOW_NBGRND)) == 0)
 		glColor4d(m_r, m_g, m_b, m_alpha);
@@ -70,6 +114,9 @@ MeshRender::render(int fclass)
 			     -m_mesh->getMean().getZ());
 	}
 
+	if (m_flags & MRF_CLIP)
+		enableClip(true);
+
         glEnable(GL_BLEND);
         glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
@@ -77,13 +124,18 @@ MeshRender::render(int fclass)
 
         glDisable(GL_BLEND);
 
-	if (m_flags & MRF_SHOW_EDGES) {
-		unsigned int fl = m_flags;
-		m_flags &= ~(MRF_SHOW_NCOLOR | MRF_SHOW_ECOLOR);
-		glDisable(GL_POLYGON_OFFSET_FACTOR);
+	if (m_flags & (MRF_SHOW_EDGES | MRF_EDGE_SELECT)) {
+		glDisable(GL_POLYGON_OFFSET_FILL);
 		glColor3f(0,0,0);
 		render_wireframe(fclass);
-		m_flags = fl;
+	}
+
+	if (m_flags & MRF_CLIP) {
+		if (m_flags & MRF_SECTION) {
+			glColor3f(0,0,0);
+			render_section(fclass);
+		}
+		enableClip(false);
 	}
 
 	if (m_flags & MRF_TRANSFORM)
@@ -95,90 +147,444 @@ MeshRender::render(int fclass)
 void
 MeshRender::render_surf(int cls)
 {
-        int start = 0;
-        int end;
+	updateArrays();
+
+	int ncls = m_cstart.size() - 1;
+	if (cls >= ncls)
+		return;
+
+	// field values are colored by the colormap modulated by the lighting
+	// of a half gray surface, doubled so that lighting brighter than
+	// white saturates as it does with vertex colors
+	bool tex = m_vtex.size() > 0;
+	if (tex) {
+		glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT |
+			     GL_TRANSFORM_BIT | GL_CURRENT_BIT);
+		updateLUT();
+		glEnable(GL_TEXTURE_1D);
+		glBindTexture(GL_TEXTURE_1D, m_lut);
+		glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_COMBINE);
+		glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_RGB, GL_MODULATE);
+		glTexEnvf(GL_TEXTURE_ENV, GL_RGB_SCALE, 2);
+		glColor4f(0.5, 0.5, 0.5, m_alpha);
+		glMatrixMode(GL_TEXTURE);
+		glPushMatrix();
+		loadTexMatrix();
+	}
+
+	if (cls < 0)
+		drawArrays(GL_TRIANGLES, 0, m_cstart[ncls], true);
+	else
+		drawArrays(GL_TRIANGLES, m_cstart[cls], m_cstart[cls + 1], true);
 
-        int interp = m_flags & MRF_INTERP;
+	if (tex) {
+		glPopMatrix();
+		glPopAttrib();
+	}
+}
+//---------------------------------------------------------------------------
+// draws the corners or line ends first to last from the render arrays,
+// with their normals and colors if attrib is set
+void
+MeshRender::drawArrays(GLenum prim, unsigned int first, unsigned int last,
+		       bool attrib)
+{
+	if (last == first)
+		return;
 
-        if (cls >= 0) {
-		int c;
-                for (c = 0; c < cls; c++)
-                        start += m_mesh->getNumTris(c);
-                end = start + m_mesh->getNumTris(c);
-        } else
-		end = m_mesh->getNumTris();
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, bindArray(MR_BUF_POS, &m_vpos[0]));
+	if (attrib) {
+		glEnableClientState(GL_NORMAL_ARRAY);
+		glNormalPointer(GL_FLOAT, 0,
+				bindArray(MR_BUF_NRM, &m_vnrm[0]));
+	} else
+		glDisableClientState(GL_NORMAL_ARRAY);
+	if (attrib && m_vcol.size()) {
+		glEnableClientState(GL_COLOR_ARRAY);
+		glColorPointer(4, GL_UNSIGNED_BYTE, 0,
+			       bindArray(MR_BUF_COL, &m_vcol[0]));
+	} else
+		glDisableClientState(GL_COLOR_ARRAY);
+	if (attrib && m_vtex.size()) {
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glTexCoordPointer(1, GL_FLOAT, 0,
+				  bindArray(MR_BUF_TEX, &m_vtex[0]));
+	} else
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
 
-        glBegin(GL_TRIANGLES);
+	if (prim == GL_TRIANGLES && m_expanded)
+		glDrawArrays(prim, first, last - first);
+	else {
+		const GLuint *idx;
+#ifdef MR_USE_VBO
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,
+			     m_vbo[prim == GL_LINES ? MR_BUF_LINE : MR_BUF_IDX]);
+		idx = NULL;
+#else
+		idx = (prim == GL_LINES) ? &m_lidx[0] : &m_vidx[0];
+#endif
+		glDrawElements(prim, last - first, GL_UNSIGNED_INT,
+			       idx + first);
+	}
 
-        for (int t = start; t < end; t++) {
-		if (m_flags & MRF_CLIP && m_eprops[t].flags & PRF_CLIP)
-			continue;
-                if (!interp) {
-			const Point3 &n = m_mesh->getFaceNormal(t);
-			glNormal3d(n.getX(), n.getY(), n.getZ());
+#ifdef MR_USE_VBO
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+#endif
+	glPopClientAttrib();
+}
+//---------------------------------------------------------------------------
+// the buffer object for the array if there is one, the data otherwise
+const GLvoid *
+MeshRender::bindArray(int buf, const void *data)
+{
+#ifdef MR_USE_VBO
+	(void) data;
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo[buf]);
+	return NULL;
+#else
+	(void) buf;
+	return data;
+#endif
+}
+//---------------------------------------------------------------------------
+template <class T>
+static inline const T *
+arrayData(const vector<T> &v)
+{
+	return v.empty() ? NULL : &v[0];
+}
+//---------------------------------------------------------------------------
+void
+MeshRender::uploadArray(int buf, const void *data, unsigned int size)
+{
+#ifdef MR_USE_VBO
+	GLenum target = (buf == MR_BUF_IDX || buf == MR_BUF_LINE) ?
+		GL_ELEMENT_ARRAY_BUFFER : GL_ARRAY_BUFFER;
+
+	if (m_vbo[0] == 0)
+		glGenBuffers(MR_NUM_BUF, m_vbo);
+	glBindBuffer(target, m_vbo[buf]);
+	glBufferData(target, size, data, GL_STATIC_DRAW);
+	glBindBuffer(target, 0);
+#else
+	(void) buf;
+	(void) data;
+	(void) size;
+#endif
+}
+//---------------------------------------------------------------------------
+// brings the render arrays up to date, rebuilding and uploading only
+// the parts whose source changed since the last time
+void
+MeshRender::updateArrays(void)
+{
+	int ne = m_mesh->getNumTris();
+	bool interp = (m_flags & MRF_INTERP) != 0;
+	bool ncol = (m_flags & (MRF_SHOW_NCOLOR | MRF_SHOW_NBGRND)) != 0;
+	bool ecol = !ncol && (m_flags & (MRF_SHOW_ECOLOR | MRF_SHOW_EBGRND));
+	bool expanded = !interp || ecol;
+	// blending the background needs colors per vertex, otherwise the
+	// values are looked up in the colormap texture
+	bool vcol = (ncol || ecol) && (m_flags & (MRF_VCOLOR | MRF_SHOW_NBGRND));
+	bool tex = (ncol || ecol) && !vcol;
+
+	if (ecol && m_eprops.value.size() != (unsigned) ne) {
+		m_eprops.value.resize(ne);
+		m_ver.efield++;
+	}
+	if (ncol && m_nprops.value.size() != (unsigned) m_mesh->getNumVerts()) {
+		m_nprops.value.resize(m_mesh->getNumVerts());
+		m_ver.nfield++;
+	}
+	m_ver.geom = m_mesh->getVersion();
+	m_ver.topo = m_mesh->getTopoVersion();
+
+	// the flags as they apply to the arrays
+	unsigned int mode = (interp ? MRF_INTERP : 0) |
+		(ncol ? MRF_SHOW_NCOLOR : 0) | (ecol ? MRF_SHOW_ECOLOR : 0) |
+		(vcol ? MRF_VCOLOR : 0);
+	unsigned int changed = mode ^ m_arrays_mode;
+	unsigned int cmode = vcol ? m_flags & (MRF_SHOW_NCOLOR |
+		MRF_SHOW_ECOLOR | MRF_SHOW_NBGRND) : 0;
+
+	// vertex layout, element list, positions, normals and colors
+	bool reshape = !m_arrays_valid || expanded != m_expanded ||
+		(!expanded &&
+		 m_vpos.size() != 3 * (unsigned) m_mesh->getNumVerts());
+	bool relayout = reshape || m_ver.topo != m_arrays_ver.topo;
+	bool repos = reshape || (expanded && relayout) ||
+		m_ver.geom != m_arrays_ver.geom;
+	bool renorm = repos || (changed & MRF_INTERP);
+	bool recol = reshape || (expanded && relayout) ||
+		(changed & (MRF_SHOW_NCOLOR | MRF_SHOW_ECOLOR | MRF_VCOLOR)) ||
+		cmode != m_arrays_cmode ||
+		(vcol && m_ver.cmap != m_arrays_ver.cmap) ||
+		(ncol && m_ver.nfield != m_arrays_ver.nfield) ||
+		(ecol && m_ver.efield != m_arrays_ver.efield);
+
+	if (!relayout && !repos && !renorm && !recol)
+		return;
+
+	const unsigned int *tris = m_mesh->getTriIndex();
+
+	if (relayout) {
+		m_keep.clear();
+		m_keep.reserve(ne);
+		int ncls = m_mesh->getNumClasses();
+		if (ncls < 1)
+			ncls = 1;
+		m_cstart.assign(ncls + 1, 0);
+		for (int c = 0, t = 0; c < ncls; c++) {
+			int end = (c == ncls - 1) ? ne :
+				t + m_mesh->getNumTris(c);
+			if (end > ne)
+				end = ne;
+			for (; t < end; t++)
+				m_keep.push_back(t);
+			m_cstart[c + 1] = 3 * m_keep.size();
 		}
+		m_layout++;
+	}
+
+	if (renorm) {
+		if (interp)
+			m_mesh->calcNormals();
+		else
+			m_mesh->calcFaceNorm();
+	}
+
+	int nk = m_keep.size();
+	int nv = expanded ? 3 * nk : m_mesh->getNumVerts();
+	if (repos)
+		m_vpos.resize(3 * nv);
+	if (renorm)
+		m_vnrm.resize(3 * nv);
+	if (recol) {
+		m_vcol.resize(vcol ? 4 * nv : 0);
+		m_vtex.resize(tex ? nv : 0);
+		m_tex_base = ncol ? m_nfldmin : m_efldmin;
+	}
+	bool val = recol && tex;
 
-		if (m_flags & (MRF_SHOW_ECOLOR | MRF_SHOW_EBGRND))
-			glColor4fv(m_eprops[t].color.color);
+	// shared vertices take the node colors as they are, the expanded
+	// ones copy them from the nodes or elements
+	const GLuint *pcol = NULL;
+	if (recol && vcol && !expanded && nv > 0)
+		calcColors(true, &m_vcol[0]);
+	else if (recol && vcol && nv > 0) {
+		PropArrays &p = ncol ? m_nprops : m_eprops;
+		p.color.resize(4 * p.value.size());
+		calcColors(ncol, &p.color[0]);
+		pcol = (const GLuint *) &p.color[0];
+	}
+	GLuint *vcol32 = pcol ? (GLuint *) &m_vcol[0] : NULL;
 
-                for (int n = 0; n < 3; n++) {
-			unsigned vi = m_mesh->getElemInd(t, n);
-			if (m_flags & (MRF_SHOW_NCOLOR | MRF_SHOW_NBGRND))
-				glColor4fv(m_nprops[vi].color.color);
-                        if (interp) {
-				const Point3 &nv = m_mesh->getVertexNormal(vi);
-				glNormal3d(nv.getX(), nv.getY(), nv.getZ());
+	if (expanded) {
+#pragma omp parallel for schedule(static)
+		for (int k = 0; k < nk; k++) {
+			unsigned int t = m_keep[k];
+			for (int m = 0; m < 3; m++) {
+				unsigned int vi = tris[3 * t + m];
+				int o = 3 * k + m;
+				if (repos) {
+					const Point3 &p = m_mesh->getVertex(vi);
+					m_vpos[3 * o] = p.getX();
+					m_vpos[3 * o + 1] = p.getY();
+					m_vpos[3 * o + 2] = p.getZ();
+				}
+				if (renorm) {
+					const Point3 &n = interp ?
+						m_mesh->getVertexNormal(vi) :
+						m_mesh->getFaceNormal(t);
+					m_vnrm[3 * o] = n.getX();
+					m_vnrm[3 * o + 1] = n.getY();
+					m_vnrm[3 * o + 2] = n.getZ();
+				}
+				if (pcol)
+					vcol32[o] = pcol[ncol ? vi : t];
+				if (val)
+					m_vtex[o] = (ncol ? m_nprops.value[vi] :
+						     m_eprops.value[t]) -
+						m_tex_base;
 			}
-			const Point3 &v  = m_mesh->getVertex(vi);
-                        glVertex3d(v.getX(), v.getY(), v.getZ());
-                }
-        }
+		}
+	} else {
+#pragma omp parallel for schedule(static)
+		for (int v = 0; v < nv; v++) {
+			if (repos) {
+				const Point3 &p = m_mesh->getVertex(v);
+				m_vpos[3 * v] = p.getX();
+				m_vpos[3 * v + 1] = p.getY();
+				m_vpos[3 * v + 2] = p.getZ();
+			}
+			if (renorm) {
+				const Point3 &n = m_mesh->getVertexNormal(v);
+				m_vnrm[3 * v] = n.getX();
+				m_vnrm[3 * v + 1] = n.getY();
+				m_vnrm[3 * v + 2] = n.getZ();
+			}
+			if (val)
+				m_vtex[v] = m_nprops.value[v] - m_tex_base;
+		}
+
+		if (relayout) {
+			m_vidx.resize(3 * nk);
+			for (int k = 0; k < nk; k++)
+				for (int m = 0; m < 3; m++)
+					m_vidx[3 * k + m] =
+						tris[3 * m_keep[k] + m];
+		}
+	}
+	if (relayout && expanded)
+		m_vidx.clear();
+
+	if (repos)
+		uploadArray(MR_BUF_POS, arrayData(m_vpos),
+			    m_vpos.size() * sizeof(GLfloat));
+	if (renorm)
+		uploadArray(MR_BUF_NRM, arrayData(m_vnrm),
+			    m_vnrm.size() * sizeof(GLfloat));
+	if (recol) {
+		uploadArray(MR_BUF_COL, arrayData(m_vcol), m_vcol.size());
+		uploadArray(MR_BUF_TEX, arrayData(m_vtex),
+			    m_vtex.size() * sizeof(GLfloat));
+	}
+	if (relayout)
+		uploadArray(MR_BUF_IDX, arrayData(m_vidx),
+			    m_vidx.size() * sizeof(GLuint));
 
-        glEnd();
+	m_expanded = expanded;
+	m_arrays_valid = true;
+	m_arrays_mode = mode;
+	m_arrays_cmode = cmode;
+	m_arrays_ver = m_ver;
 }
 //---------------------------------------------------------------------------
+// rebuilds the edge lines if the drawn elements, the edge selection or,
+// for sharp edges, the geometry changed since the last time
 void
-MeshRender::render_wireframe(int cls)
+MeshRender::updateLines(void)
 {
-        int start = 0;
-        int end;
+	unsigned int mode = m_flags & (MRF_SHOW_EDGES | MRF_EDGE_SELECT);
+	bool sharp = (mode & MRF_EDGE_SHARP) != 0;
 
-        if (cls >= 0) {
-		int c;
-                for (c = 0; c < cls; c++)
-                        start += m_mesh->getNumTris(c);
-                end = start + m_mesh->getNumTris(c);
-        } else
-		end = m_mesh->getNumTris();
+	if (m_lines_valid && m_lines_layout == m_layout &&
+	    m_lines_mode == mode && (!sharp ||
+	    (m_lines_geom == m_mesh->getVersion() && m_lines_sharp == m_sharp)))
+		return;
 
-	glPushAttrib(GL_ENABLE_BIT | GL_POLYGON_BIT);
-	glDisable(GL_LIGHTING);
-	glDisable(GL_TEXTURE_2D);
-	
-	glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        glBegin(GL_TRIANGLES);
+	int ncls = m_cstart.size() - 1;
+	int ne = m_mesh->getNumTris();
+	const unsigned int *tris = m_mesh->getTriIndex();
 
+	// position of each drawn element in m_keep
+	vector<int> kpos(ne, -1);
+	for (unsigned int k = 0; k < m_keep.size(); k++)
+		kpos[m_keep[k]] = k;
 
-        for (int t = start; t < end; t++) {
-		if (m_flags & MRF_CLIP && m_eprops[t].flags & PRF_CLIP)
+	if (sharp)
+		m_mesh->calcFaceNorm();
+
+	// an edge is listed once in each class it has drawn elements in
+	vector< vector<GLuint> > lines(2 * ncls);
+	for (EdgeIter it(*m_mesh); ne > 0 && it.value(); it.next()) {
+		Edge *e = it.value();
+		int ns = e->nelem < MAX_EDGE_ELEM ? e->nelem : MAX_EDGE_ELEM;
+
+		bool sel = ((mode & MRF_BOUND) && e->nelem == 1) ||
+			((mode & MRF_EDGE_NONMAN) && e->nelem > 2) ||
+			(sharp && e->nelem == 2 &&
+			 m_mesh->getFaceNormal(e->elem[0]).dot(
+				 m_mesh->getFaceNormal(e->elem[1])) < m_sharp);
+		if (!sel && !(mode & MRF_SHOW_EDGES))
 			continue;
-		if (m_flags & MRF_SHOW_ECOLOR)
-			glColor4fv(m_eprops[t].color.color);
-                for (int n = 0; n < 3; n++) {
-			if (m_flags & MRF_SHOW_NCOLOR) {
-				unsigned vi = m_mesh->getElemInd(t, n);
-				glColor4fv(m_nprops[vi].color.color);
+
+		int ecls[MAX_EDGE_ELEM];
+		for (int i = 0; i < ns; i++) {
+			int k = kpos[e->elem[i]];
+			ecls[i] = -1;
+			if (k < 0)
+				continue;
+			int c = upper_bound(m_cstart.begin(), m_cstart.end(),
+					    3 * k) - m_cstart.begin() - 1;
+			int j;
+			for (j = 0; j < i && ecls[j] != c; j++)
+				;
+			if (j < i)
+				continue;
+			ecls[i] = c;
+
+			GLuint v1 = e->node1, v2 = e->node2;
+			if (m_expanded) {
+				unsigned int t = m_keep[k];
+				for (int m = 0; m < 3; m++) {
+					if (tris[3 * t + m] == e->node1)
+						v1 = 3 * k + m;
+					else if (tris[3 * t + m] == e->node2)
+						v2 = 3 * k + m;
+				}
 			}
-			const Point3 &v  = m_mesh->getElemVert(t, n);
-                        glVertex3d(v.getX(), v.getY(), v.getZ());
-                }
-        }
+			if (mode & MRF_SHOW_EDGES) {
+				lines[c].push_back(v1);
+				lines[c].push_back(v2);
+			}
+			if (sel) {
+				lines[ncls + c].push_back(v1);
+				lines[ncls + c].push_back(v2);
+			}
+		}
+	}
+
+	m_lidx.clear();
+	m_lstart.assign(2 * ncls + 1, 0);
+	for (int g = 0; g < 2 * ncls; g++) {
+		m_lidx.insert(m_lidx.end(), lines[g].begin(), lines[g].end());
+		m_lstart[g + 1] = m_lidx.size();
+	}
+	uploadArray(MR_BUF_LINE, arrayData(m_lidx),
+		    m_lidx.size() * sizeof(GLuint));
+
+	m_lines_valid = true;
+	m_lines_mode = mode;
+	m_lines_layout = m_layout;
+	m_lines_geom = m_mesh->getVersion();
+	m_lines_sharp = m_sharp;
+}
+//---------------------------------------------------------------------------
+// the unique edges of the elements drawn by render_surf, all of them
+// with MRF_SHOW_EDGES and the selected ones highlighted over them
+void
+MeshRender::render_wireframe(int cls)
+{
+	updateArrays();
+	updateLines();
+
+	int ncls = m_cstart.size() - 1;
+	if (cls >= ncls)
+		return;
+	int c0 = (cls < 0) ? 0 : cls;
+	int c1 = (cls < 0) ? ncls : cls + 1;
 
-        glEnd();
+	glPushAttrib(GL_ENABLE_BIT | GL_LINE_BIT | GL_CURRENT_BIT);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_TEXTURE_2D);
+
+	if (m_flags & MRF_SHOW_EDGES)
+		drawArrays(GL_LINES, m_lstart[c0], m_lstart[c1], false);
+
+	if (m_flags & MRF_EDGE_SELECT) {
+		glColor3f(1, 0, 0);
+		glLineWidth(2);
+		drawArrays(GL_LINES, m_lstart[ncls + c0], m_lstart[ncls + c1],
+			   false);
+	}
 	glPopAttrib();
 }
 //---------------------------------------------------------------------------
-GColor &
+GColor
 MeshRender::colorMap(double val, double min, double max)
 {
 	int idx;
@@ -210,65 +616,47 @@ MeshRender::colorMap(double val, double min, double max)
 		assert(idx >=0 && idx < CMAP_SIZE);
 	}
 
-        return m_cmap[idx];
+	GColor c = m_cmap->getColor(idx);
+	c.A() = m_alpha;
+        return c;
 }
 //---------------------------------------------------------------------------
-void
-MeshRender::colormapDefault(void)
+int
+MeshRender::setColormap(const char *name)
 {
-	double val, r, g, b;
-	for (int n=0; n<CMAP_SIZE; n++) {
-		val=(double)n /(CMAP_SIZE-1);
-		r=b=0;
-		if (val<0.5) b=1-(2*val);
-		if (val>0.5) r=(2*val)-1;
-
-		g = 0.5 * (1 - (b+r));
+	ColorMap *cm = ColorMap::get(name);
+	if (cm == NULL)
+		return 1;
 
-		if (b < g)
-			b = g;
-		if (r < g)
-			r = g;
-
-		m_cmap[n]=GColor(r,g,b, m_alpha);
-	}
+	if (m_cmap)
+		m_cmap->unref();
+	m_cmap = cm;
 	updateFields();
+	return 0;
+}
+//---------------------------------------------------------------------------
+void
+MeshRender::colormapDefault(void)
+{
+	setColormap("default");
 }
 //---------------------------------------------------------------------------
 void
 MeshRender::colormapGray(int nq)
 {
-	if (nq < 2)
-		nq = CMAP_SIZE;
-	double inc = 1 / (double)(nq - 1);
-	double val = 0;
-
-	int num = 0;
-	
-	for (int n=0; n<CMAP_SIZE; n++) {
-		num += nq;
-		if (num >= CMAP_SIZE) {
-			val += inc;
-			num -= CMAP_SIZE;
-		}
-		m_cmap[n]=GColor(val,val,val, m_alpha);
-	}
-	updateFields();
+	char name[32];
+
+	if (nq < 2 || nq > CMAP_SIZE)
+		snprintf(name, sizeof(name), "gray");
+	else
+		snprintf(name, sizeof(name), "gray%d", nq);
+	setColormap(name);
 }
 //---------------------------------------------------------------------------
 void
 MeshRender::colormapFlip(void)
 {
-	int first = 0;
-	int last = CMAP_SIZE - 1;
-	while (first < last) {
-		GColor tmp = m_cmap[first];
-		m_cmap[first] = m_cmap[last];
-		m_cmap[last] = tmp;
-		first++;
-		last--;
-	}
-	updateFields();
+	setColormap(ColorMap::flipName(m_cmap->getName()).c_str());
 }
 //---------------------------------------------------------------------------
 void
@@ -278,17 +666,16 @@ MeshRender::setEField(double *f, int update)
 	if (ne < 1)
 		return;
 
-	m_eprops.resize(ne);
+	m_eprops.value.resize(ne);
 
 	if (f) {
 		for (int n = 0; n < ne; n++)
-			m_eprops[n].value = f[n];
+			m_eprops.value[n] = f[n];
 	}
 
+	updateEField();
 	if (update)
 		setEFRangeAuto(update < 0);
-	else
-		updateEField();
 }
 //---------------------------------------------------------------------------
 void
@@ -299,7 +686,7 @@ MeshRender::setEBackground(double *f)
 	if (ne < 1)
 		return;
 
-	m_eprops.resize(ne);
+	m_eprops.background.resize(ne);
 
 	if (f) {
 		bmin = bmax = f[0];
@@ -314,7 +701,7 @@ MeshRender::setEBackground(double *f)
 
 		for (int n = 0; n < ne; n++) {
 			double val = (f[n] - bmin) / (bmax - bmin);
-			m_eprops[n].background = val;
+			m_eprops.background[n] = val;
 		}
 	}
 
@@ -322,26 +709,17 @@ MeshRender::setEBackground(double *f)
 }
 //---------------------------------------------------------------------------
 void
-MeshRender::updateEField(void)
-{
-	int ne = m_mesh->getNumTris();
-	for (int n = 0; n < ne; n++) {
-		if (m_flags & MRF_SHOW_NBGRND)
-			setEColor(n, m_eprops[n].value, m_eprops[n].background, m_balpha);
-		else
-			setEColor(n, m_eprops[n].value);
-	}
-}
-//---------------------------------------------------------------------------
-void
 MeshRender::setEFRangeAuto(bool zero)
 {
 	int ne = m_mesh->getNumTris();
 
-        m_efldmax = m_efldmin = m_eprops[0].value;
+	if (m_eprops.value.size() != (unsigned) ne || ne < 1)
+		return;
+
+        m_efldmax = m_efldmin = m_eprops.value[0];
 
         for (int n = 1; n < ne; n++) {
-                double v = m_eprops[n].value;
+                double v = m_eprops.value[n];
                 if (v < m_efldmin)
 			m_efldmin = v;
                 else if (v > m_efldmax)
@@ -357,7 +735,7 @@ MeshRender::setEFRangeAuto(bool zero)
 		m_efldmax = v2;
 	}
 
-	updateEField();
+	updateColors();
 }
 //---------------------------------------------------------------------------
 void
@@ -367,17 +745,16 @@ MeshRender::setNField(double *f, int update)
 	if (nn < 1)
 		return;
 
-	m_nprops.resize(nn);
+	m_nprops.value.resize(nn);
 
 	if (f) {
 		for (int n = 0; n < nn; n++)
-			m_nprops[n].value = f[n];
+			m_nprops.value[n] = f[n];
 	}
     
+	updateNField();
 	if (update)
 		setNFRangeAuto(update < 0);
-	else
-		updateNField();
 }
 //---------------------------------------------------------------------------
 void
@@ -388,7 +765,7 @@ MeshRender::setNBackground(double *f)
 	if (nn < 1)
 		return;
 
-	m_nprops.resize(nn);
+	m_nprops.background.resize(nn);
 
 	if (f) {
 		bmin = bmax = f[0];
@@ -403,7 +780,7 @@ MeshRender::setNBackground(double *f)
 
 		for (int n = 0; n < nn; n++) {
 			double val = (f[n] - bmin) / (bmax - bmin);
-			m_nprops[n].background = val;
+			m_nprops.background[n] = val;
 		}
 	}
 
@@ -414,10 +791,13 @@ void
 MeshRender::setNFRangeAuto(bool zero)
 {
 	int nn = m_mesh->getNumVerts();
-	m_nfldmax = m_nfldmin = m_nprops[0].value;
+	if (m_nprops.value.size() != (unsigned) nn || nn < 1)
+		return;
+
+	m_nfldmax = m_nfldmin = m_nprops.value[0];
 
 	for (int n = 1; n < nn; n++) {
-		double v = m_nprops[n].value;
+		double v = m_nprops.value[n];
 		if (v < m_nfldmin)
 			m_nfldmin = v;
 		else if (v > m_nfldmax)
@@ -433,55 +813,435 @@ MeshRender::setNFRangeAuto(bool zero)
 		m_nfldmax = v2;
 	}
 
-	updateNField();
+	updateColors();
 }
 //---------------------------------------------------------------------------
+// RGBA8 colors of the nodes or elements for the per vertex color arrays
 void
-MeshRender::updateNField(void)
+MeshRender::calcColors(bool nodes, GLubyte *out)
 {
-	int nn = m_mesh->getNumVerts();
-	for (int n = 0; n < nn; n++) {
-		if (m_flags & MRF_SHOW_NBGRND)
-			setNColor(n, m_nprops[n].value, m_nprops[n].background, m_balpha);
-		else
-			setNColor(n, m_nprops[n].value);
+	PropArrays &p = nodes ? m_nprops : m_eprops;
+	int n = p.value.size();
+	bool blend = (m_flags & MRF_SHOW_NBGRND) != 0;
+	bool show = (m_flags & (nodes ? MRF_SHOW_NCOLOR : MRF_SHOW_ECOLOR)) != 0;
+
+	if (blend && p.background.size() != (unsigned) n)
+		p.background.resize(n);
+	const float *bg = blend && n ? &p.background[0] : NULL;
+
+	if (n < 1)
+		return;
+	if (nodes)
+		mapColors(&p.value[0], bg, n, m_nfldmin, m_nfldmax, show, out);
+	else
+		mapColors(&p.value[0], bg, n, m_efldmin, m_efldmax, show, out);
+}
+//---------------------------------------------------------------------------
+// a color component as GL would store it
+static inline GLubyte
+colorByte(GLfloat c)
+{
+	c = (c > 0) ? c : 0;
+	c = (c < 1) ? c : 1;
+	return (GLubyte) (c * 255 + 0.5f);
+}
+//---------------------------------------------------------------------------
+#define MR_COLOR_BLOCK	256
+
+// maps n values to packed RGBA8 through the colormap over [min, max], as
+// colorMap does. With a background bg (0 to 1) it is blended into the
+// colormap color, or into the mesh color unless show is set.
+void
+MeshRender::mapColors(const float *val, const float *bg, int n,
+		      double min, double max, bool show, GLubyte *out)
+{
+	if (min > max) {
+		double t = max;
+		max = min;
+		min = t;
+	}
+	double del = max - min;
+	bool log = m_log && del > 0;
+	// divided rather than scaled, so values on a colormap step land
+	// where colorMap puts them
+	double den = 1;
+	int mid = CMAP_SIZE / 2, size = 0;
+	if (del > 0) {
+		den = log ? log1p(del) : del;
+		mid = 0;
+		size = CMAP_SIZE;
+	}
+
+	// the colormap is opaque, the alpha is the mesh's
+	const GLubyte *lut = m_cmap->getRGBA8();
+	GLfloat base[3] = {(GLfloat) m_r, (GLfloat) m_g, (GLfloat) m_b};
+	GLfloat a = m_balpha, ca = 1 - a;
+	GLubyte alpha = colorByte(m_alpha);
+
+	int nb = (n + MR_COLOR_BLOCK - 1) / MR_COLOR_BLOCK;
+#pragma omp parallel for schedule(static)
+	for (int b = 0; b < nb; b++) {
+		int i0 = b * MR_COLOR_BLOCK;
+		int m = (n - i0 < MR_COLOR_BLOCK) ? n - i0 : MR_COLOR_BLOCK;
+		const float *v = val + i0;
+		GLubyte *o = out + 4 * i0;
+		double x[MR_COLOR_BLOCK];
+		int idx[MR_COLOR_BLOCK];
+
+		// offsets clamped into the range, then the colormap index:
+		// simple loops the compiler can vectorize
+		for (int i = 0; i < m; i++) {
+			double t = v[i] - min;
+			t = (t > 0) ? t : 0;
+			x[i] = (t < del) ? t : del;
+		}
+		if (log) {
+			for (int i = 0; i < m; i++)
+				x[i] = log1p(x[i]);
+		}
+		for (int i = 0; i < m; i++) {
+			int k = (int) (x[i] * size / den) + mid;
+			idx[i] = ((unsigned) k < CMAP_SIZE) ? k : CMAP_SIZE - 1;
+		}
+
+		if (bg == NULL) {
+			for (int i = 0; i < m; i++) {
+				memcpy(o + 4 * i, lut + 4 * idx[i], 3);
+				o[4 * i + 3] = alpha;
+			}
+			continue;
+		}
+
+		for (int i = 0; i < m; i++) {
+			const GLfloat *c = show ?
+				m_cmap->getColor(idx[i]).color : base;
+			GLfloat g = bg[i0 + i] * a;
+			for (int j = 0; j < 3; j++)
+				o[4 * i + j] = colorByte(c[j] * ca + g);
+			o[4 * i + 3] = alpha;
+		}
 	}
 }
 //---------------------------------------------------------------------------
+// range of the field shown by the texture
 void
-MeshRender::updateAlpha(void)
+MeshRender::colorRange(double &lo, double &hi) const
 {
-	int nn = m_mesh->getNumVerts();
+	if (m_arrays_mode & MRF_SHOW_NCOLOR) {
+		lo = m_nfldmin;
+		hi = m_nfldmax;
+	} else {
+		lo = m_efldmin;
+		hi = m_efldmax;
+	}
+	if (lo > hi) {
+		double t = lo;
+		lo = hi;
+		hi = t;
+	}
+}
+//---------------------------------------------------------------------------
+// loads the colormap into the texture. The texture coordinates are linear
+// in the value, so in log scale the entries depend on the range.
+void
+MeshRender::updateLUT(void)
+{
+	double lo, hi;
+	colorRange(lo, hi);
+	double del = hi - lo;
+
+	if (m_lut && m_lut_ver == m_ver.lut && m_lut_log == m_log &&
+	    (!m_log || m_lut_del == del))
+		return;
+
+	GLint size = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &size);
+	if (size <= 0 || size > CMAP_SIZE)
+		size = CMAP_SIZE;
+
+	const GLubyte *cmap = m_cmap->getRGBA8();
+	vector<GLubyte> lut(4 * size);
+	for (int j = 0; j < size; j++) {
+		double x = (j + 0.5) / size;
+		double i = x * CMAP_SIZE;
+		if (m_log && del > 0)
+			i = log1p(x * del) * CMAP_SIZE / log1p(del);
+		int idx = (int) floor(i);
+		if (idx >= CMAP_SIZE)
+			idx = CMAP_SIZE - 1;
+		memcpy(&lut[4 * j], cmap + 4 * idx, 4);
+	}
+
+	if (m_lut == 0)
+		glGenTextures(1, &m_lut);
+	glBindTexture(GL_TEXTURE_1D, m_lut);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA8, size, 0, GL_RGBA,
+		     GL_UNSIGNED_BYTE, &lut[0]);
+
+	m_lut_ver = m_ver.lut;
+	m_lut_log = m_log;
+	m_lut_del = del;
+}
+//---------------------------------------------------------------------------
+// maps the texture coordinates (values less m_tex_base) to [0, 1] over
+// the field range, or to the middle of the colormap if it is empty
+void
+MeshRender::loadTexMatrix(void)
+{
+	double lo, hi;
+	colorRange(lo, hi);
+
+	glLoadIdentity();
+	if (hi > lo) {
+		glScaled(1 / (hi - lo), 1, 1);
+		glTranslated(m_tex_base - lo, 0, 0);
+	} else {
+		glTranslated(0.5, 0, 0);
+		glScaled(0, 1, 1);
+	}
+}
+//---------------------------------------------------------------------------
+// face p of the clip box as the plane n.x = d, inside where n.x >= d
+void
+MeshRender::clipPlane(int p, double *n, double &d) const
+{
+	const double lo[3] = {m_clipX0, m_clipY0, m_clipZ0};
+	const double hi[3] = {m_clipX1, m_clipY1, m_clipZ1};
+	int k = p / 2;
+
+	n[0] = n[1] = n[2] = 0;
+	if (p & 1) {
+		n[k] = -1;
+		d = -hi[k];
+	} else {
+		n[k] = 1;
+		d = lo[k];
+	}
+}
+//---------------------------------------------------------------------------
+// the clip box as GL clip planes, given in mesh coordinates
+void
+MeshRender::enableClip(bool on)
+{
+	for (int p = 0; p < 6; p++) {
+		if (!on) {
+			glDisable(GL_CLIP_PLANE0 + p);
+			continue;
+		}
+		double n[3], d;
+		clipPlane(p, n, d);
+		GLdouble eq[4] = {n[0], n[1], n[2], -d};
+		glClipPlane(GL_CLIP_PLANE0 + p, eq);
+		glEnable(GL_CLIP_PLANE0 + p);
+	}
+}
+//---------------------------------------------------------------------------
+// rebuilds the cross sections if the clip box or the mesh changed. The
+// elements crossing each face come from a BVH over the mesh, their cut
+// edges are chained into polylines, closed where the surface is.
+void
+MeshRender::updateSection(void)
+{
+	unsigned int geom = m_mesh->getVersion();
+	if (m_section_valid && m_section_geom == geom &&
+	    m_section_clip == m_ver.clip)
+		return;
+
+	if (m_bvh == NULL || m_bvh_geom != geom) {
+		delete m_bvh;
+		m_bvh = new MeshBVH(*m_mesh);
+		m_bvh_geom = geom;
+	}
+
+	m_section.clear();
+	m_spts.clear();
+
+	const unsigned int *tris = m_mesh->getTriIndex();
 	int ne = m_mesh->getNumTris();
+	int ncls = m_mesh->getNumClasses();
+	if (ncls < 1)
+		ncls = 1;
 
-	if (m_flags & MRF_SHOW_NCOLOR)
-		for (int n = 0; n < nn; n++)
-			m_nprops[n].color.A() = m_alpha;
+	// first element after each class
+	vector<int> cend(ncls);
+	for (int c = 0, t = 0; c < ncls; c++) {
+		t = (c == ncls - 1) ? ne : t + m_mesh->getNumTris(c);
+		cend[c] = (t < ne) ? t : ne;
+	}
 
-	if (m_flags & MRF_SHOW_ECOLOR)
-		for (int n = 0; n < ne; n++)
-			m_eprops[n].color.A() = m_alpha;
+	for (int p = 0; p < 6; p++) {
+		double n[3], d;
+		vector<unsigned> elems;
+		clipPlane(p, n, d);
+		if (m_bvh->crossPlane(n, d, elems)) {
+			// the tree is too deep, test every element
+			MESH_DEBUG("Section: BVH too deep, scanning all elements\n");
+			elems.clear();
+			for (int e = 0; e < ne; e++) {
+				int above = 0;
+				for (int m = 0; m < 3; m++) {
+					const Point3 &q =
+						m_mesh->getVertex(tris[3 * e + m]);
+					if (n[0] * q.getX() + n[1] * q.getY() +
+					    n[2] * q.getZ() >= d)
+						above++;
+				}
+				if (above == 1 || above == 2)
+					elems.push_back(e);
+			}
+		}
+		sort(elems.begin(), elems.end());
+
+		for (unsigned int i = 0, c = 0; i < elems.size(); ) {
+			while ((int) elems[i] >= cend[c])
+				c++;
+			unsigned int j = i;
+			while (j < elems.size() && (int) elems[j] < cend[c])
+				j++;
+			addSection(p, c, n, d, &elems[i], j - i, tris);
+			i = j;
+		}
+	}
 
-	for (int n = 0; n < CMAP_SIZE; n++)
-		m_cmap[n].A() = m_alpha;
+	m_section_valid = true;
+	m_section_geom = geom;
+	m_section_clip = m_ver.clip;
 }
 //---------------------------------------------------------------------------
+// chains the cuts of the plane through the elements into polylines. A
+// cut edge is named by its two nodes, so the elements sharing it meet
+// at the same point.
 void
-MeshRender::updateClip(void)
-{
-	int nn = m_mesh->getNumTris();
-	for (int n = 0; n < nn; n++) {
-		Point3 p;
-		for (int m = 0; m < 3; m++)
-			p += m_mesh->getElemVert(n, m);
-		p /= 3;
-
-		if (p.getX() < m_clipX0 || p.getX() > m_clipX1 ||
-		    p.getY() < m_clipY0 || p.getY() > m_clipY1 ||
-		    p.getZ() < m_clipZ0 || p.getZ() > m_clipZ1)
-			m_eprops[n].flags |= PRF_CLIP;
-		else
-			m_eprops[n].flags &= ~PRF_CLIP;
+MeshRender::addSection(int p, int cls, const double *n, double d,
+		       const unsigned int *elems, int ne,
+		       const unsigned int *tris)
+{
+	typedef map<uint64_t, vector<int> > EdgeMap;
+	EdgeMap ends;
+	vector<uint64_t> segs;
+
+	for (int i = 0; i < ne; i++) {
+		const unsigned int *v = &tris[3 * elems[i]];
+		double s[3];
+		for (int m = 0; m < 3; m++) {
+			const Point3 &q = m_mesh->getVertex(v[m]);
+			s[m] = n[0] * q.getX() + n[1] * q.getY() +
+				n[2] * q.getZ() - d;
+		}
+		uint64_t key[3];
+		int nk = 0;
+		for (int m = 0; m < 3; m++) {
+			int m1 = (m + 1) % 3;
+			if ((s[m] >= 0) == (s[m1] >= 0))
+				continue;
+			unsigned int a = min(v[m], v[m1]);
+			unsigned int b = max(v[m], v[m1]);
+			key[nk++] = ((uint64_t) a << 32) | b;
+		}
+		if (nk != 2)
+			continue;
+		for (int k = 0; k < 2; k++) {
+			ends[key[k]].push_back(segs.size() / 2);
+			segs.push_back(key[k]);
+		}
+	}
+
+	int nseg = segs.size() / 2;
+	vector<bool> used(nseg, false);
+
+	// open chains start at an edge with a single cut, then the loops
+	for (int pass = 0; pass < 2; pass++) {
+		for (int s0 = 0; s0 < nseg; s0++) {
+			if (used[s0])
+				continue;
+			uint64_t start = segs[2 * s0];
+			if (pass == 0 && ends[start].size() != 1) {
+				start = segs[2 * s0 + 1];
+				if (ends[start].size() != 1)
+					continue;
+			}
+
+			Section sec;
+			sec.start = m_spts.size() / 3;
+			sec.plane = p;
+			sec.cls = cls;
+
+			uint64_t key = start;
+			int sg = s0;
+			while (sg >= 0) {
+				used[sg] = true;
+				addSectionPoint(key, n, d);
+				key = (segs[2 * sg] == key) ? segs[2 * sg + 1] :
+					segs[2 * sg];
+				const vector<int> &e = ends[key];
+				sg = -1;
+				for (unsigned int k = 0; k < e.size(); k++)
+					if (!used[e[k]]) {
+						sg = e[k];
+						break;
+					}
+			}
+			sec.closed = (key == start);
+			if (!sec.closed)
+				addSectionPoint(key, n, d);
+			sec.count = m_spts.size() / 3 - sec.start;
+			m_section.push_back(sec);
+		}
 	}
 }
 //---------------------------------------------------------------------------
+// where the plane cuts the edge between the two nodes of the key
+void
+MeshRender::addSectionPoint(uint64_t key, const double *n, double d)
+{
+	const Point3 &a = m_mesh->getVertex(key >> 32);
+	const Point3 &b = m_mesh->getVertex(key & 0xffffffff);
+	double sa = n[0] * a.getX() + n[1] * a.getY() + n[2] * a.getZ() - d;
+	double sb = n[0] * b.getX() + n[1] * b.getY() + n[2] * b.getZ() - d;
+	double t = sa / (sa - sb);
+
+	Point3 q = a + (b - a) * t;
+	m_spts.push_back(q.getX());
+	m_spts.push_back(q.getY());
+	m_spts.push_back(q.getZ());
+}
+//---------------------------------------------------------------------------
+// the cross sections of class cls (all if negative), each drawn with the
+// clip plane it lies on turned off
+void
+MeshRender::render_section(int cls)
+{
+	updateSection();
+	if (m_section.empty())
+		return;
+
+	glPushAttrib(GL_ENABLE_BIT | GL_LINE_BIT);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_TEXTURE_1D);
+	glDisable(GL_TEXTURE_2D);
+	glLineWidth(2);
+
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, &m_spts[0]);
+
+	for (unsigned int i = 0; i < m_section.size(); i++) {
+		const Section &sec = m_section[i];
+		if (cls >= 0 && sec.cls != cls)
+			continue;
+		glDisable(GL_CLIP_PLANE0 + sec.plane);
+		glDrawArrays(sec.closed ? GL_LINE_LOOP : GL_LINE_STRIP,
+			     sec.start, sec.count);
+		glEnable(GL_CLIP_PLANE0 + sec.plane);
+	}
+
+	glPopClientAttrib();
+	glPopAttrib();
+}
+//---------------------------------------------------------------------------
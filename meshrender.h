@@ -22,6 +22,8 @@
 #define meshrenderH
 //---------------------------------------------------------------------------
 #include "mesh.h"
+#include "colormap.h"
+#include "meshbvh.h"
 
 #define MRF_HIDDEN	 0x001
 #define MRF_INTERP	 0x002
@@ -33,38 +35,35 @@
 #define MRF_TRANSFORM	 0x080
 #define MRF_SHOW_EBGRND  0x100
 #define MRF_SHOW_NBGRND  0x200
+#define MRF_EDGE_NONMAN  0x400
+#define MRF_EDGE_SHARP	 0x800
+#define MRF_VCOLOR	 0x1000	// colors per vertex instead of the colormap
+				// texture, for output that can not texture
+#define MRF_SECTION	 0x2000	// outline where the clip box cuts the mesh
+
+// edges drawn over the surface in addition to or instead of all edges
+#define MRF_EDGE_SELECT	(MRF_BOUND | MRF_EDGE_NONMAN | MRF_EDGE_SHARP)
+
+// the surface is drawn from vertex arrays kept in buffer objects, which
+// need the OpenGL 1.5 entry points. Without them (or with MR_NO_VBO) the
+// same arrays are drawn from client memory.
+#if !defined(MR_NO_VBO) && !defined(__WIN32__) && !defined(_WIN32)
+#define MR_USE_VBO
+#endif
 
-#define CMAP_SIZE       16384
-
-// property flags
-#define PRF_CLIP	0x01
-
-struct GColor {
-	GColor(){}
-	GColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a = 1)
-        {color[0] = r; color[1] = g; color[2] = b; color[3] = a;}
-
-	inline GLfloat &R() {return color[0];}
-	inline GLfloat &G() {return color[1];}
-	inline GLfloat &B() {return color[2];}
-	inline GLfloat &A() {return color[3];}
-	inline void assign(GLfloat r, GLfloat g, GLfloat b, GLfloat a = 1)
-        { color[0]=r; color[1]=g; color[2]=b; color[3] = a; }
-	GLfloat color[4];
-};
-
-struct ColorProp {
-	ColorProp():value(0), flags(0), color(1,1,1){}
-	double value;
-	double background;
-	unsigned int flags;
-	GColor color;   // element color
+// per node or element data as separate arrays, each allocated only
+// when the feature using it is: field values, background (0 to 1) and
+// RGBA8 colors
+struct PropArrays {
+	vector<float> value;
+	vector<float> background;
+	vector<GLubyte> color;
 };
 
 class MeshRender {
 public:
         MeshRender(TriMeshLin &msh);
-        ~MeshRender(void) {};
+        ~MeshRender(void);
 
         inline void setFlag(unsigned flag) {
 		m_flags |= flag;
@@ -79,7 +78,7 @@ public:
                 else if (a > 1) a = 1;
                 if (m_alpha != a) {
 			m_alpha = a;
-			updateAlpha();
+			updateColors();
 		}
         }
 
@@ -122,7 +121,7 @@ public:
 		else if (alpha > 1)
 			alpha = 1;
 		m_balpha = alpha;
-		updateFields();
+		updateColors();
 	}
 	inline double getBackgroundAlpha(void) {
 		return m_balpha;
@@ -135,22 +134,22 @@ public:
 
 	inline void setColorLog(void) {
 		m_log = 1;
-		updateFields();
+		updateColors();
 	}
 
 	inline void setColorLinear(void) {
 		m_log = 0;
-		updateFields();
+		updateColors();
 	}
 
 	inline void setEFRange(double min, double max) {
 		m_efldmin=min; m_efldmax=max;
-		updateEField();
+		updateColors();
 	}
 
 	inline void setNFRange(double min, double max) {
 		m_nfldmin=min; m_nfldmax=max;
-		updateNField();
+		updateColors();
 	}
 
 	inline void getEFRange(double &min, double &max) {
@@ -164,31 +163,34 @@ public:
 	void colormapFlip(void);
 	void colormapGray(int quant);
 	void colormapDefault(void);
-
-	int saveFaces(FILE *f);
-
-	inline const GColor &getEColor(int el) const {
-		return m_eprops[el].color;
+	// shows the named colormap from the registry, returns 0 on success
+	int setColormap(const char *name);
+	inline const char *getColormap(void) const {
+		return m_cmap->getName();
 	}
 
-	inline const GColor &getNColor(int nd) const {
-		return m_nprops[nd].color;
-	}
+	int saveFaces(FILE *f);
 
 	inline double getEField(int el) const {
-		return m_eprops[el].value;
+		return m_eprops.value[el];
 	}
 
 	inline double getNField(int nd) const {
-		return m_nprops[nd].value;
+		return m_nprops.value[nd];
+	}
+
+	inline unsigned int getNFieldSize(void) const {
+		return m_nprops.value.size();
 	}
 
 	inline double getEBackground(int el) const {
-		return m_eprops[el].background;
+		return m_eprops.background.empty() ? 0 :
+			m_eprops.background[el];
 	}
 
 	inline double getNBackground(int nd) const {
-		return m_nprops[nd].background;
+		return m_nprops.background.empty() ? 0 :
+			m_nprops.background[nd];
 	}
 
         int render(int filter = -1);
@@ -201,7 +203,7 @@ public:
 		m_clipX1 = x1;
 		m_clipY1 = y1;
 		m_clipZ1 = z1;
-		updateClip();
+		m_ver.clip++;
 	}
 
 	void setOffset(const Point3 &off) {
@@ -218,55 +220,57 @@ public:
 		return m_rot;
 	}
 
+	// cosine of the normal angle above which MRF_EDGE_SHARP shows an edge
+	inline void setSharpThreshold(double c) {
+		m_sharp = c;
+	}
+	inline double getSharpThreshold(void) const {
+		return m_sharp;
+	}
+
 protected:
 	void render_surf(int cls);	
 	void render_wireframe(int cls);
-
-	GColor &colorMap(double val, double min, double max);
-	inline void setEColor(int el, double val)
-		{m_eprops[el].color=colorMap(val, m_efldmin, m_efldmax);}
-	inline void setNColor(int nd, double val)
-		{m_nprops[nd].color=colorMap(val, m_nfldmin, m_nfldmax);}
-
-	inline void setEColor(int el, double val, double bg, double alpha) {
-		GColor c(m_r, m_g, m_b, m_alpha);
-		bg = bg * alpha;
-		alpha = 1-alpha;
-		if (m_flags & MRF_SHOW_ECOLOR)
-			c = colorMap(val, m_efldmin, m_efldmax);
-		m_eprops[el].color.R() = c.R() * alpha + bg;
-		m_eprops[el].color.G() = c.G() * alpha + bg;
-		m_eprops[el].color.B() = c.B() * alpha + bg;
-		m_eprops[el].color.A() = c.A();
-	}
-	inline void setNColor(int nd, double val, double bg, double alpha) {
-		GColor c(m_r, m_g, m_b, m_alpha);
-		bg = bg * alpha;
-		alpha = 1 - alpha;
-		if (m_flags & MRF_SHOW_NCOLOR)
-			c = colorMap(val, m_nfldmin, m_nfldmax);
-		m_nprops[nd].color.R() = c.R() * alpha + bg;
-		m_nprops[nd].color.G() = c.G() * alpha + bg;
-		m_nprops[nd].color.B() = c.B() * alpha + bg;
-		m_nprops[nd].color.A() = c.A();
-	}
-    
+	void updateArrays(void);
+	void updateLines(void);
+	void updateLUT(void);
+	void loadTexMatrix(void);
+	void colorRange(double &lo, double &hi) const;
+	void drawArrays(GLenum prim, unsigned int first, unsigned int last,
+			bool attrib);
+	const GLvoid *bindArray(int buf, const void *data);
+	void uploadArray(int buf, const void *data, unsigned int size);
+
+	GColor colorMap(double val, double min, double max);
+	void calcColors(bool nodes, GLubyte *out);
+	void mapColors(const float *val, const float *bg, int n,
+		       double min, double max, bool show, GLubyte *out);
+
+	// the colors are computed when drawn: these only record what changed
+	inline void updateColors(void)
+		{m_ver.cmap++;}
 	inline void updateFields(void)
-		{updateEField(); updateNField();}
-	void updateEField();
-	void updateNField();
-	void updateAlpha();
-	void updateClip();
+		{m_ver.lut++; m_ver.cmap++;}
+	inline void updateEField(void)
+		{m_ver.efield++;}
+	inline void updateNField(void)
+		{m_ver.nfield++;}
+	void clipPlane(int p, double *n, double &d) const;
+	void enableClip(bool on);
+	void updateSection(void);
+	void addSection(int p, int cls, const double *n, double d,
+			const unsigned int *elems, int ne,
+			const unsigned int *tris);
+	void addSectionPoint(uint64_t key, const double *n, double d);
+	void render_section(int cls);
 
 
 private:
         TriMeshLin *m_mesh;
 
-	typedef vector<ColorProp> CPropVec;
-
-	CPropVec m_eprops;
-	CPropVec m_nprops;
-	GColor m_cmap[CMAP_SIZE];
+	PropArrays m_eprops;
+	PropArrays m_nprops;
+	ColorMap *m_cmap;
 
         double m_alpha, m_balpha;
         double m_r, m_g, m_b;
@@ -276,11 +280,73 @@ private:
 	double m_efldmin, m_efldmax;
 	double m_nfldmin, m_nfldmax;
 
-	bool m_clip;
 	double m_clipX0, m_clipX1;
 	double m_clipY0, m_clipY1;
 	double m_clipZ0, m_clipZ1;
 
 	Point3 m_move, m_rot;
+
+	// render arrays: shared vertices indexed by the elements, or three
+	// vertices per element for flat normals and element colors
+	enum { MR_BUF_POS, MR_BUF_NRM, MR_BUF_COL, MR_BUF_TEX, MR_BUF_IDX,
+	       MR_BUF_LINE, MR_NUM_BUF };
+	vector<GLfloat> m_vpos, m_vnrm;
+	vector<GLubyte> m_vcol;		// RGBA8
+	vector<GLfloat> m_vtex;		// field values less m_tex_base
+	double m_tex_base;
+	vector<GLuint> m_vidx;
+	vector<unsigned int> m_keep;	// elements drawn, in class order
+	vector<unsigned int> m_cstart;	// first corner of each class
+	bool m_expanded;
+	bool m_arrays_valid;
+	unsigned int m_arrays_mode;	// flags the arrays were built for
+	unsigned int m_arrays_cmode;	// and the colors
+	unsigned int m_layout;		// changes with m_keep
+
+	// unique edges of the drawn elements as line pairs into the vertex
+	// arrays: all edges by class, then the selected edges by class
+	vector<GLuint> m_lidx;
+	vector<unsigned int> m_lstart;
+	bool m_lines_valid;
+	unsigned int m_lines_mode, m_lines_layout, m_lines_geom;
+	double m_lines_sharp;
+	double m_sharp;
+
+	// each part of the render arrays is rebuilt only if the version
+	// of the data it was built from changed
+	struct Versions {
+		Versions() : geom(0), topo(0), efield(0), nfield(0),
+			     cmap(0), lut(0), clip(0) {}
+		unsigned int geom, topo;	// mesh nodes and elements
+		unsigned int efield, nfield;	// element and node values
+		unsigned int cmap;		// anything the colors depend on
+		unsigned int lut;		// colormap entries
+		unsigned int clip;		// clip box
+	};
+	Versions m_ver;			// current
+	Versions m_arrays_ver;		// of the render arrays
+
+	// polylines where the faces of the clip box cut the mesh, each
+	// drawn with the other faces clipping it
+	struct Section {
+		unsigned int start, count;	// points in m_spts
+		int plane, cls;
+		bool closed;
+	};
+	vector<Section> m_section;
+	vector<GLfloat> m_spts;
+	bool m_section_valid;
+	unsigned int m_section_geom, m_section_clip;
+	MeshBVH *m_bvh;
+	unsigned int m_bvh_geom;
+
+	// the colormap as a 1D texture, looked up by the field values
+	GLuint m_lut;
+	unsigned int m_lut_ver;
+	bool m_lut_log;
+	double m_lut_del;
+#ifdef MR_USE_VBO
+	GLuint m_vbo[MR_NUM_BUF];
+#endif
 };
 #endif
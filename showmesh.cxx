@@ -25,6 +25,12 @@
 #include "glcapture.h"
 #include "command.h"
 #include "meshproc.h"
+#include "meshbvh.h"
+#include "meshmetrics.h"
+#include "meshcurv.h"
+#include "meshgeod.h"
+#include "meshmap.h"
+#include "meshdiff.h"
 #include "gl2ps.h"
 //---------------------------------------------------------------------------
 
@@ -35,9 +41,9 @@ extern ShowMeshUI *ui;
 
 ShowMeshWindow::ShowMeshWindow(int X, int Y, int W, int H, const char *L)
 	: Fl_Gl_Window(X, Y, W, H, L), eye(0,0,0), rot(90, 0, 0),
-	  pf_scale(1,1,1)
+	  pf_scale(1,1,1), m_darrows(GS_ARROW)
 {
-	idle = ani = capture = filter = 0;
+	idle = ani = dplay = capture = filter = 0;
 	edges = glcull = help = interp = light = wire = 0;
 	revorder = edges = tmode = 0;
 
@@ -51,6 +57,12 @@ ShowMeshWindow::ShowMeshWindow(int X, int Y, int W, int H, const char *L)
 	tmode = 0;
 
 	num_meshes = 0;
+	for (int n = 0; n < MAX_MESHES; n++) {
+		snapshots[n] = NULL;
+		geodesics[n] = NULL;
+		nodemaps[n] = NULL;
+		diffusions[n] = NULL;
+	}
 
 	numiter = 0;
 	numcorrect = 0;
@@ -65,6 +77,10 @@ ShowMeshWindow::ShowMeshWindow(int X, int Y, int W, int H, const char *L)
 
 	m_delsc = 1;
 
+	m_dnodes.setMode(GS_GLYPH);
+	m_darrows.setMode(GS_GLYPH);
+	m_dip_valid = false;
+
 	setAmbientLight(0.3, 0.3, 0.45);
 	setSourceLight(0.9, 0.8, 0.8);
 	setLightPos(7.0, 0.0, 0.0);
@@ -279,9 +295,9 @@ ShowMeshWindow::glDisplay(void)
 	glRotatef(rot.getY(), 0.0f, 1.0f, 0.0f);
 	glRotatef(rot.getZ(), 0.0f, 0.0f, 1.0f);
 
-	for (int n = 0; n < m_dip.size(); n++)
-		if (m_dip[n].show)
-			drawDipole(m_dip[n]);
+	if (!m_dip.empty())
+		drawDipoles();
+	m_dset.render(m_delsc);
 
 	if (!pfield.empty()) {
 		drawPointField();
@@ -444,6 +460,32 @@ ShowMeshWindow::loadFSCurvFile(TriMeshLin *msh, FILE *f)
 	return pot;
 }
 
+// reads a node field for msh in any of the supported formats
+double *
+ShowMeshWindow::loadNodeField(TriMeshLin *msh, const char *fn)
+{
+	FILE *f = fopen(fn, "r");
+
+	if (f == NULL) {
+		perror("Failed to open!\n");
+		return NULL;
+	}
+
+	double *pot = loadPotFile(msh, f);
+	if (pot == NULL) {
+		fseek(f, 0, SEEK_SET);
+		pot = loadFSCurvFile(msh, f);
+		if (pot == NULL) {
+			fseek(f, 0, SEEK_SET);
+			pot = loadFSWFile(msh, f);
+		}
+	}
+
+	fclose(f);
+
+	return pot;
+}
+
 int
 ShowMeshWindow::load_node_fn(const char *fn, int mn)
 {
@@ -454,34 +496,122 @@ ShowMeshWindow::load_node_fn(const char *fn, int mn)
 	if (r == NULL)
 		return 1;
 
-	FILE *f=fopen(fn,"r");
+	double *pot = loadNodeField(r->getMesh(), fn);
+	if (pot == NULL)
+		return 1;
 
-	if (f == NULL) {
-		perror("Failed to open!\n");
+	r->setNField(pot);
+	r->setFlag(MRF_SHOW_NCOLOR);
+	double n0, n1;
+	r->getNFRange(n0, n1);
+	printf("Nfield range: [%g %g]\n", n0, n1);
+	delete[] pot;
+
+	return 0;
+}
+
+// diffusion smoothing of the node field of a mesh
+int
+ShowMeshWindow::smooth_node_fn(int iter, double lambda, int mn)
+{
+	if (mn < 0 || mn >= num_meshes)
+		return 1;
+
+	MeshRender *r = meshes[mn];
+	TriMeshLin *mesh = r->getMesh();
+	int nn = mesh->getNumVerts();
+
+	if (r->getNFieldSize() != (unsigned int) nn) {
+		printf("No node field on mesh %d\n", mn);
 		return 1;
 	}
 
-	double *pot = loadPotFile(r->getMesh(), f);
-	if (pot == NULL) {
-		fseek(f, 0, SEEK_SET);
-		pot = loadFSCurvFile(r->getMesh(), f);
+	vector<double> val(nn);
+	for (int n = 0; n < nn; n++)
+		val[n] = r->getNField(n);
+
+	// kept with the mesh, the weights are rebuilt when it changes
+	if (diffusions[mn] == NULL)
+		diffusions[mn] = new MeshDiffusion(*mesh);
+	if (diffusions[mn]->smooth(&val[0], iter, lambda))
+		return 1;
+
+	r->setNField(&val[0]);
+	double n0, n1;
+	r->getNFRange(n0, n1);
+	printf("Nfield range: [%g %g]\n", n0, n1);
+
+	return 0;
+}
+
+// maps node fields of mesh ma onto mesh mb: the fields in the given
+// files, each saved as <file>.m<mb>, or the current field of ma. The
+// first one is shown on mb. The map is kept until either mesh changes.
+int
+ShowMeshWindow::transfer_node_fn(int ma, int mb,
+				 const vector<const char *> &files)
+{
+	if (ma < 0 || ma >= num_meshes || mb < 0 || mb >= num_meshes)
+		return 1;
+
+	TriMeshLin *src = meshes[ma]->getMesh();
+	TriMeshLin *dst = meshes[mb]->getMesh();
+	if (src == NULL || dst == NULL)
+		return 1;
+
+	int ns = src->getNumVerts(), nd = dst->getNumVerts();
+	int nf = files.size() ? files.size() : 1;
+
+	vector<double> in((size_t) ns * nf), out((size_t) nd * nf);
+	if (files.empty()) {
+		if (meshes[ma]->getNFieldSize() != (unsigned int) ns) {
+			printf("No node field on mesh %d\n", ma);
+			return 1;
+		}
+		for (int n = 0; n < ns; n++)
+			in[n] = meshes[ma]->getNField(n);
+	}
+	for (int f = 0; f < (int) files.size(); f++) {
+		double *pot = loadNodeField(src, files[f]);
 		if (pot == NULL) {
-			fseek(f, 0, SEEK_SET);
-			pot = loadFSWFile(r->getMesh(), f);
+			printf("Failed to load %s\n", files[f]);
+			return 1;
 		}
+		for (int n = 0; n < ns; n++)
+			in[(size_t) n * nf + f] = pot[n];
+		delete[] pot;
 	}
 
-	if (pot) {
-		r->setNField(pot);
-		r->setFlag(MRF_SHOW_NCOLOR);
-		double n0, n1;
-		r->getNFRange(n0, n1);
-		printf("Nfield range: [%g %g]\n", n0, n1);
-
-	} else
-		return 1;
+	if (nodemaps[mb] == NULL)
+		nodemaps[mb] = new MeshMap();
+	if (!nodemaps[mb]->current(*src, *dst)) {
+		if (nodemaps[mb]->build(*src, *dst))
+			return 1;
+		printf("Mapped %d nodes, largest projection %g\n", nd,
+		       nodemaps[mb]->getMaxDistance());
+	}
+	nodemaps[mb]->apply(&in[0], &out[0], nf);
+
+	for (int f = 0; f < (int) files.size(); f++) {
+		char name[1024];
+		snprintf(name, sizeof(name), "%s.m%d", files[f], mb);
+		FILE *fo = fopen(name, "w");
+		if (fo == NULL) {
+			perror(name);
+			return 1;
+		}
+		for (int n = 0; n < nd; n++)
+			fprintf(fo, "%.9g\n", out[(size_t) n * nf + f]);
+		fclose(fo);
+		printf("Saved %s\n", name);
+	}
 
-	fclose(f);
+	vector<double> first(nd);
+	for (int n = 0; n < nd; n++)
+		first[n] = out[(size_t) n * nf];
+	meshes[mb]->setNField(&first[0]);
+	meshes[mb]->clearFlag(MRF_SHOW_ECOLOR);
+	meshes[mb]->setFlag(MRF_SHOW_NCOLOR);
 
 	return 0;
 }
@@ -574,152 +704,82 @@ ShowMeshWindow::set_node_auto(int zero, int mn)
 	return 0;
 }
 
-void
-ShowMeshWindow::drawArrow(Point3 dc, Point3 dn, double scale)
+int
+ShowMeshWindow::set_colormap(const char *name, int mn)
 {
-	if (scale == 0)
-		return;
+	if (mn < 0 || mn >= num_meshes)
+		return 1;
 
-	Point3 dn1, dn2;
+	MeshRender *r = meshes[mn];
+	if (r == NULL)
+		return 1;
 
-        if (fabs(dn.getZ()) > fabs(dn.getY())) {
-		if (fabs(dn.getZ()) > fabs(dn.getX()))
-			dn1 = Point3(dn.getZ(), 0, -dn.getX());
-		else
-			dn1 = Point3(-dn.getY(), dn.getX(), 0);
-	} else {
-		if (fabs(dn.getY()) > fabs(dn.getX()))
-			dn1 = Point3(dn.getY(), -dn.getX(), 0);
-		else
-			dn1 = Point3(-dn.getZ(), 0, dn.getX());
+	if (r->setColormap(name)) {
+		printf("No colormap %s\n", name);
+		return 1;
 	}
 
-	dn1.normalize();
-	dn2=Cross(dn1, dn);
-	dn2.normalize();
-
-	scale *= m_delsc;
-	dn *= scale*6;
-	dn1*= scale;
-	dn2*= scale;
-
-	Point3 v0(dc + dn);
-	Point3 v1(dc + dn1);
-	Point3 v2(dc - dn2);
-	Point3 v3(dc - dn1);
-	Point3 v4(dc + dn2);
-
-	dn.normalize();
-	dn1.normalize();
-	dn2.normalize();
-
-	glBegin(GL_TRIANGLE_FAN);
-
-	glNormal3f(dn.X(), dn.Y(), dn.Z());
-	glVertex3f(v0.X(), v0.Y(), v0.Z());
-
-	glNormal3f(dn1.X(), dn1.Y(), dn1.Z());
-	glVertex3f(v1.X(), v1.Y(), v1.Z());
-
-	glNormal3f(-dn2.X(), -dn2.Y(), -dn2.Z());
-	glVertex3f(v2.X(), v2.Y(), v2.Z());
-
-	glNormal3f(-dn1.X(), -dn1.Y(), -dn1.Z());
-	glVertex3f(v3.X(), v3.Y(), v3.Z());
-
-	glNormal3f(dn2.X(), dn2.Y(), dn2.Z());
-	glVertex3f(v4.X(), v4.Y(), v4.Z());
-
-	glNormal3f(dn1.X(), dn1.Y(), dn1.Z());
-	glVertex3f(v1.X(), v1.Y(), v1.Z());
-
-	glEnd();
-
-	glBegin(GL_QUADS);
-
-	glNormal3f(-dn.X(), -dn.Y(), -dn.Z());
-	glVertex3f(v1.X(), v1.Y(), v1.Z());
-	glVertex3f(v4.X(), v4.Y(), v4.Z());
-	glVertex3f(v3.X(), v3.Y(), v3.Z());
-	glVertex3f(v2.X(), v2.Y(), v2.Z());
-
-	glEnd();
+	return 0;
 }
 
-void
-ShowMeshWindow::drawNode(const Point3 &nd, double scale)
+int
+ShowMeshWindow::flip_colormap(int mn)
 {
-	double d = m_delsc * 2 * scale;
-	double x=nd.getX();
-	double y=nd.getY();
-	double z=nd.getZ();
-
-	if (scale == 0)
-		return;
-
-	glBegin(GL_TRIANGLE_FAN);
-
-	glNormal3f(1, 0, 0);
-	glVertex3f(x+d, y, z);
-
-	glNormal3f(0, 1, 0);
-	glVertex3f(x, y+d, z);
-
-	glNormal3f(0, 0, 1);
-	glVertex3f(x, y, z+d);
-
-	glNormal3f(0, -1, 0);
-	glVertex3f(x, y-d, z);
-
-	glNormal3f(0, 0, -1);
-	glVertex3f(x, y, z-d);
-
-	glNormal3f(0, 1, 0);
-	glVertex3f(x, y+d, z);
-
-	glEnd();
-
-	glBegin(GL_TRIANGLE_FAN);
-
-	glNormal3f(-1, 0, 0);
-	glVertex3f(x-d, y, z);
-
-	glNormal3f(0, 1, 0);
-	glVertex3f(x, y+d, z);
-
-	glNormal3f(0, 0, -1);
-	glVertex3f(x, y, z-d);
-
-	glNormal3f(0, -1, 0);
-	glVertex3f(x, y-d, z);
+	if (mn < 0 || mn >= num_meshes)
+		return 1;
 
-	glNormal3f(0, 0, 1);
-	glVertex3f(x, y, z+d);
+	MeshRender *r = meshes[mn];
+	if (r == NULL)
+		return 1;
 
-	glNormal3f(0, 1, 0);
-	glVertex3f(x, y+d, z);
+	r->colormapFlip();
+	printf("Colormap %s\n", r->getColormap());
 
-	glEnd();
+	return 0;
 }
 
+// the dipoles set one by one, each a node with an arrow along its moment
 void
-ShowMeshWindow::drawDipole(const DInfo &dip)
+ShowMeshWindow::drawDipoles(void)
 {
-	Point3 dc(dip.D);
-	Point3 dn(dip.J);
-
-	if (dn.length() == 0)
-		return;
-
-	dn.normalize();
+	if (!m_dip_valid) {
+		int nd = m_dip.size();
+		vector<Point3> pos, dir;
+		vector<GLubyte> rgba;
+		vector<float> size;
+
+		pos.reserve(nd);
+		dir.reserve(nd);
+		rgba.reserve(4 * nd);
+		size.reserve(nd);
+		for (int n = 0; n < nd; n++) {
+			const DInfo &dip = m_dip[n];
+			Point3 dn(dip.J);
+			if (!dip.show || dip.scale == 0 || dn.length() == 0)
+				continue;
+			dn.normalize();
+			pos.push_back(dip.D);
+			dir.push_back(dn);
+			size.push_back(dip.scale);
+
+			double c[3];
+			dip.Color.getCoord(c[0], c[1], c[2]);
+			for (int k = 0; k < 3; k++)
+				rgba.push_back((GLubyte) (c[k] * 255 + 0.5));
+			rgba.push_back(255);
+		}
 
-	glColor4f(dip.Color.getX(),dip.Color.getY(),dip.Color.getZ(),1);
+		m_dnodes.set(pos, rgba, size);
+		m_darrows.set(pos, rgba, size, dir);
+		m_dip_valid = true;
+	}
 
-	drawNode(dc, dip.scale);
-	drawArrow(dc, dn, dip.scale);
+	m_dnodes.setRadius(2 * m_delsc);
+	m_darrows.setRadius(m_delsc);
+	m_dnodes.render();
+	m_darrows.render();
 }
 
-
 int
 ShowMeshWindow::mark_elem(int mn, int idx, bool nbrs)
 {
@@ -773,6 +833,8 @@ ShowMeshWindow::mark_node(int mn, int idx, bool nbrs)
 	Point3 p = mesh->getVertex(idx);
 
 	pfield.clear();
+	pf_color.clear();
+	pf_size.clear();
 
 	pfield.push_back(p);
 
@@ -787,6 +849,7 @@ ShowMeshWindow::mark_node(int mn, int idx, bool nbrs)
 			pfield.push_back(mesh->getVertex(nd));
 		}
 	}
+	pfUpdate();
 
 	return 0;
 }
@@ -805,15 +868,25 @@ ShowMeshWindow::loadPointField(const char *fname)
 	}
 
 	pfield.clear();
+	pf_color.clear();
+	pf_size.clear();
+
+	// "x y z", optionally followed by a size, an "r g b" color (0 to 1)
+	// or both. Points without them get the defaults.
+	vector<GLubyte> color;
+	vector<float> size;
+	bool has_color = false, has_size = false;
 
 	int line = 0;
 	while (fgets(buf, sizeof(buf), f)) {
-		double x, y, z;
+		double v[7];
 		char *e = strchr(buf, '\n');
 		line++;
 
 		if (e == NULL) {
 			fprintf(stderr, "line %d: too long\n", line);
+			fclose(f);
+			pfUpdate();
 			return 1;
 		}
 		*e = '\0';
@@ -821,15 +894,43 @@ ShowMeshWindow::loadPointField(const char *fname)
 		if (*buf == '\0' || *buf == '#')
 			continue;
 
-		if (sscanf(buf, "%lg %lg %lg", &x, &y, &z) != 3) {
+		int ne = sscanf(buf, "%lg %lg %lg %lg %lg %lg %lg",
+				&v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6]);
+		if (ne != 3 && ne != 4 && ne != 6 && ne != 7) {
 			printf("line %d: invalid number of entries\n", line);
+			fclose(f);
+			pfUpdate();
 			return 1;
 		}
 
-//		printf("%g %g %g\n", x, y, z);
+		pfield.push_back(Point3(v[0] - m_mx, v[1] - m_my, v[2] - m_mz));
+
+		double s = 1, rgb[3] = {1, 0, 0};
+		if (ne == 4 || ne == 7) {
+			s = v[3];
+			has_size = true;
+		}
+		if (ne >= 6) {
+			for (int k = 0; k < 3; k++)
+				rgb[k] = v[ne - 3 + k];
+			has_color = true;
+		}
 
-		pfield.push_back(Point3(x - m_mx, y - m_my, z - m_mz));
+		size.push_back(s);
+		for (int k = 0; k < 3; k++) {
+			double c = (rgb[k] > 0) ? rgb[k] : 0;
+			c = (c < 1) ? c : 1;
+			color.push_back((GLubyte) (c * 255 + 0.5));
+		}
+		color.push_back(255);
 	}
+	fclose(f);
+
+	if (has_color)
+		pf_color.swap(color);
+	if (has_size)
+		pf_size.swap(size);
+	pfUpdate();
 
 	printf("Done, %lu points read\n", pfield.size());
 	return 0;
@@ -838,8 +939,6 @@ ShowMeshWindow::loadPointField(const char *fname)
 int
 ShowMeshWindow::savePointField(const char *fname)
 {
-	char buf[1024];
-
 	if (pfield.empty()) {
 		printf("No points to save\n");
 		return (0);
@@ -854,19 +953,33 @@ ShowMeshWindow::savePointField(const char *fname)
 	for (int n = 0; n < pfield.size(); n++) {
 		double x, y, z;
 		pfield[n].getCoord(x, y, z);
-		fprintf(f, "%g %g %g\n", x + m_mx, y + m_my, z + m_mz);
+		fprintf(f, "%g %g %g", x + m_mx, y + m_my, z + m_mz);
+		if (!pf_size.empty())
+			fprintf(f, " %g", pf_size[n]);
+		if (!pf_color.empty())
+			fprintf(f, " %g %g %g", pf_color[4 * n] / 255.0,
+				pf_color[4 * n + 1] / 255.0,
+				pf_color[4 * n + 2] / 255.0);
+		fprintf(f, "\n");
 	}
 	fclose(f);
 
 	return (0);
 }
 
+// hands the point field to its glyph set after it changed
+void
+ShowMeshWindow::pfUpdate(void)
+{
+	pf_glyphs.set(pfield, pf_color, pf_size);
+}
+
 int
 ShowMeshWindow::drawPointField(void)
 {
 	glColor4f(1,0,0,1);
 
-	double d = m_delsc;
+	pf_glyphs.setRadius(m_delsc);
 
 	glPushMatrix();
 	glTranslatef(pf_off.getX(), pf_off.getY(), pf_off.getZ());
@@ -875,57 +988,7 @@ ShowMeshWindow::drawPointField(void)
 	glRotatef(pf_rot.getX(), 1.0f, 0.0f, 0.0f);
 	glScalef(pf_scale.getX(), pf_scale.getY(), pf_scale.getZ());
 
-	int np = pfield.size();
-	for (int n = 0; n < np; n++) {
-		double x, y, z;
-		pfield[n].getCoord(x, y, z);
-
-		glBegin(GL_TRIANGLE_FAN);
-
-		glNormal3f(1, 0, 0);
-		glVertex3f(x+d, y, z);
-
-		glNormal3f(0, 1, 0);
-		glVertex3f(x, y+d, z);
-		
-		glNormal3f(0, 0, 1);
-		glVertex3f(x, y, z+d);
-		
-		glNormal3f(0, -1, 0);
-		glVertex3f(x, y-d, z);
-		
-		glNormal3f(0, 0, -1);
-		glVertex3f(x, y, z-d);
-		
-		glNormal3f(0, 1, 0);
-		glVertex3f(x, y+d, z);
-		
-		glEnd();
-
-		glBegin(GL_TRIANGLE_FAN);
-
-		glNormal3f(-1, 0, 0);
-		glVertex3f(x-d, y, z);
-
-		glNormal3f(0, 1, 0);
-		glVertex3f(x, y+d, z);
-		
-		glNormal3f(0, 0, -1);
-		glVertex3f(x, y, z-d);
-
-		glNormal3f(0, -1, 0);
-		glVertex3f(x, y-d, z);
-
-		glNormal3f(0, 0, 1);
-		glVertex3f(x, y, z+d);
-		
-		glNormal3f(0, 1, 0);
-		glVertex3f(x, y+d, z);
-		
-		glEnd();
-	}
-
-	glEnd();
+	pf_glyphs.render();
 
 	glPopMatrix();
 	
@@ -1335,7 +1398,7 @@ ShowMeshWindow::keyboard(unsigned char key, int x, int y)
 	if (handled)
 		redraw();
 
-	if (!idle && (ani || numiter || numcorrect || command_need_loop())){
+	if (!idle && (ani || dplay || numiter || numcorrect || command_need_loop())){
 	    Fl::add_idle(ShowMeshWindow::glIdleCB, this);
 	}
 
@@ -1380,17 +1443,16 @@ ShowMeshWindow::improve_mesh(int mn, int cnt, double aspect, double esize)
 		double avg =  mp.averageEdgeDistance();
 		printf("Average Edge Distance: %g\n", avg);
 
-#if 0
-		mp.mergeVertices(0);
-#endif
+		ret = mesh->removeDuplicates(0);
+		printf(" >> removed %d duplicate elements\n", ret);
 		ret = mesh->flipElements();
 		printf(" >> flipped %d edges\n", ret);
 		ret = mesh->removeBadAspectElements(aspect);
 		printf(" >> removed %d bad aspect elements\n", ret);
 		ret = mesh->removeSmallElements(avg * esize);
 		printf(" >> removed %d small elements\n", ret);
-		ret = mp.flipSharpEdges();
-		printf(" >> flipped %d sharp edges\n", ret);
+		mp.flipSharpEdges(NULL, &ret);
+		printf(" >> %d sharp edge flips\n", ret);
 
 #if 0
 		double *ef = new double[mesh->getNumTris()];
@@ -1529,7 +1591,7 @@ ShowMeshWindow::process_intersecting(int mn, int fix)
 }
 
 int
-ShowMeshWindow::process_sharp_edges(int mn, int fix)
+ShowMeshWindow::process_sharp_edges(int mn, int fix, double kfactor)
 {
 	TriMeshLin *mesh = meshes[mn]->getMesh();
 	int ni;
@@ -1541,19 +1603,445 @@ ShowMeshWindow::process_sharp_edges(int mn, int fix)
 
 	printf("Looking for sharp edges ...\n");
 
-	if (fix)
-		ni = mp.flipSharpEdges();
-	else
-		ni = mp.printSharpEdges();		
+	double *ef = NULL;
+	if (fix) {
+		int nf;
+		ef = new double[mesh->getNumTris()];
+		ni = mp.flipSharpEdges(ef, &nf);
+		printf("%d sharp edge flips\n", nf);
+	}
 
-	if (ni)
+	// the flips only undo folds, features use the curvature threshold.
+	// The elements left after flipping are already marked unless the
+	// threshold changes.
+	if (kfactor > 0) {
+		MeshCurvature mc(*mesh);
+		mc.update();
+		printf("Sharp edge threshold: %g deg\n",
+		       mp.sharpFromCurvature(mc, kfactor));
+	}
+
+	if (ef == NULL || kfactor > 0) {
+		delete[] ef;
+		ef = new double[mesh->getNumTris()];
+		ni = mp.printSharpEdges(ef);
+	}
+
+	if (ni) {
 		printf("%d elements have sharp edges\n", ni);
-	else
+		meshes[mn]->setEField(ef);
+		meshes[mn]->setFlag(MRF_SHOW_ECOLOR);
+		meshes[mn]->setSharpThreshold(mp.getSharpThreshold());
+		meshes[mn]->setFlag(MRF_EDGE_SHARP);
+	} else
 		printf("no sharp edges\n");
 
+	delete[] ef;
+
 	return (0);
 }
 
+int
+ShowMeshWindow::snapshot_mesh(int mn)
+{
+	if (mn < 0 || mn >= num_meshes)
+		return 1;
+
+	TriMeshLin *mesh = meshes[mn]->getMesh();
+	if (mesh == NULL)
+		return 1;
+
+	if (snapshots[mn] == NULL)
+		snapshots[mn] = new TriMeshLin();
+
+	snapshots[mn]->set(*mesh);
+
+	return 0;
+}
+
+// deviation of mesh m1 from mesh m2, or from the snapshot of m1
+int
+ShowMeshWindow::mesh_deviation(int m1, int m2)
+{
+	if (m1 < 0 || m1 >= num_meshes || m2 >= num_meshes)
+		return 1;
+
+	TriMeshLin *mesh = meshes[m1]->getMesh();
+	TriMeshLin *ref;
+
+	if (m2 < 0) {
+		ref = snapshots[m1];
+		if (ref == NULL) {
+			printf("No snapshot for mesh %d\n", m1);
+			return 1;
+		}
+	} else
+		ref = meshes[m2]->getMesh();
+
+	if (mesh == NULL || ref == NULL || mesh->getNumVerts() == 0 ||
+	    ref->getNumVerts() == 0)
+		return 1;
+
+	MeshBVH bref(*ref), bmesh(*mesh);
+	MeshProc mp(mesh), mr(ref);
+	double rms;
+
+	double *dist = new double[mesh->getNumVerts()];
+	double h1 = mp.deviation(bref, dist, rms);
+	double h2 = mr.hausdorff(bmesh, h1);
+
+	if (m2 < 0)
+		printf("Deviation of mesh %d from snapshot:\n", m1);
+	else
+		printf("Deviation of mesh %d from mesh %d:\n", m1, m2);
+	printf("  Hausdorff (one sided): %g\n", h1);
+	printf("  Hausdorff (symmetric): %g\n", h2 > h1 ? h2 : h1);
+	printf("  RMS: %g\n", rms);
+
+	meshes[m1]->setNField(dist);
+	meshes[m1]->setFlag(MRF_SHOW_NCOLOR);
+	delete[] dist;
+
+	return 0;
+}
+
+int
+ShowMeshWindow::decimate_mesh(int mn, int target, int perclass,
+			      double clearance, double curvature)
+{
+	if (mn < 0 || mn >= num_meshes || target < 4)
+		return 1;
+
+	TriMeshLin *mesh = meshes[mn]->getMesh();
+	if (mesh == NULL)
+		return 1;
+
+	int ret = mesh->decimate(target, perclass, clearance, curvature);
+	printf(" >> removed %d elements, %d left in %d classes\n",
+	       ret, mesh->getNumTris(), mesh->getNumClasses());
+
+	return 0;
+}
+
+int
+ShowMeshWindow::remesh_mesh(int mn, double len, int iter)
+{
+	if (mn < 0 || mn >= num_meshes)
+		return 1;
+
+	TriMeshLin *mesh = meshes[mn]->getMesh();
+	if (mesh == NULL)
+		return 1;
+
+	MeshProc mp(mesh);
+	printf("Average Edge Distance: %g\n", mp.averageEdgeDistance());
+	if (mesh->remesh(len, iter))
+		return 1;
+	printf("Average Edge Distance: %g\n", mp.averageEdgeDistance());
+	printf(" >> %d elements, %d nodes\n", mesh->getNumTris(),
+	       mesh->getNumVerts());
+
+	return 0;
+}
+
+int
+ShowMeshWindow::subdivide_mesh(int mn, int levels, int scheme)
+{
+	if (mn < 0 || mn >= num_meshes)
+		return 1;
+
+	TriMeshLin *mesh = meshes[mn]->getMesh();
+	if (mesh == NULL)
+		return 1;
+
+	if (mesh->subdivide(levels, scheme) < 0)
+		return 1;
+	printf(" >> %d elements, %d nodes in %d classes\n",
+	       mesh->getNumTris(), mesh->getNumVerts(),
+	       mesh->getNumClasses());
+
+	return 0;
+}
+
+// prints the quality summary of a mesh, or the histogram of one metric
+// which is also shown as an element or node field
+int
+ShowMeshWindow::mesh_quality(int mn, const char *metric, int nbins)
+{
+	if (mn < 0 || mn >= num_meshes)
+		return 1;
+
+	TriMeshLin *mesh = meshes[mn]->getMesh();
+	if (mesh == NULL || mesh->getNumTris() == 0)
+		return 1;
+
+	MeshMetrics mm(*mesh);
+	mm.update();
+
+	if (metric == NULL || *metric == 0) {
+		mm.printSummary(stdout);
+		return 0;
+	}
+
+	int node, m = MeshMetrics::findMetric(metric, node);
+	if (m < 0) {
+		printf("Unknown metric: %s\n", metric);
+		return 1;
+	}
+
+	const double *val = node ? mm.nodeMetric(m) : mm.elemMetric(m);
+	int n = node ? mm.getNumNodes() : mm.getNumElems();
+	double min = MeshMetrics::percentile(val, n, 0);
+	double max = MeshMetrics::percentile(val, n, 100);
+	vector<unsigned int> hist;
+
+	if (nbins < 1)
+		nbins = 10;
+	MeshMetrics::histogram(val, n, nbins, min, max, hist);
+
+	printf("%s: %d %s, min %g, median %g, max %g\n", metric, n,
+	       node ? "nodes" : "elements", min,
+	       MeshMetrics::percentile(val, n, 50), max);
+	for (int b = 0; b < nbins; b++)
+		printf("  %10.4g - %10.4g: %d\n",
+		       min + (max - min) * b / nbins,
+		       min + (max - min) * (b + 1) / nbins, hist[b]);
+
+	if (node) {
+		meshes[mn]->setNField((double *) val);
+		meshes[mn]->clearFlag(MRF_SHOW_ECOLOR);
+		meshes[mn]->setFlag(MRF_SHOW_NCOLOR);
+	} else {
+		meshes[mn]->setEField((double *) val);
+		meshes[mn]->setFlag(MRF_SHOW_ECOLOR);
+	}
+
+	return 0;
+}
+
+// computes the curvature of a mesh and shows one of the fields
+int
+ShowMeshWindow::mesh_curvature(int mn, const char *field)
+{
+	if (mn < 0 || mn >= num_meshes)
+		return 1;
+
+	TriMeshLin *mesh = meshes[mn]->getMesh();
+	if (mesh == NULL || mesh->getNumTris() == 0)
+		return 1;
+
+	int c = MC_MEAN;
+	if (field && *field) {
+		c = MeshCurvature::findField(field);
+		if (c < 0) {
+			printf("Unknown curvature: %s\n", field);
+			return 1;
+		}
+	}
+
+	MeshCurvature mc(*mesh);
+	mc.update();
+
+	const double *val = mc.field(c);
+	int n = mc.getNumNodes();
+	printf("%s curvature: min %g, median %g, max %g\n",
+	       MeshCurvature::fieldName(c),
+	       MeshMetrics::percentile(val, n, 0),
+	       MeshMetrics::percentile(val, n, 50),
+	       MeshMetrics::percentile(val, n, 100));
+
+	meshes[mn]->setNField((double *) val);
+	meshes[mn]->clearFlag(MRF_SHOW_ECOLOR);
+	meshes[mn]->setFlag(MRF_SHOW_NCOLOR);
+
+	return 0;
+}
+
+// geodesic distance field from the given nodes, or from the nodes
+// nearest to the point field (marked node, electrodes). The heat method
+// factorization is kept per mesh, so later queries only solve.
+int
+ShowMeshWindow::mesh_geodesic(int mn, const vector<unsigned int> &src,
+			      int march)
+{
+	if (mn < 0 || mn >= num_meshes)
+		return 1;
+
+	TriMeshLin *mesh = meshes[mn]->getMesh();
+	if (mesh == NULL || mesh->getNumTris() == 0)
+		return 1;
+
+	vector<unsigned int> nodes(src);
+	if (nodes.empty() && pfield.size()) {
+		MeshBVH bvh(*mesh);
+		for (unsigned int n = 0; n < pfield.size(); n++) {
+			Point3 pi;
+			int e;
+			bvh.nearest(pfTransform(pfield[n]), -1, &pi, &e);
+			unsigned int best = mesh->getElemInd(e, 0);
+			for (int k = 1; k < 3; k++) {
+				unsigned int v = mesh->getElemInd(e, k);
+				if ((mesh->getVertex(v) - pi).length2() <
+				    (mesh->getVertex(best) - pi).length2())
+					best = v;
+			}
+			nodes.push_back(best);
+		}
+	}
+	if (nodes.empty()) {
+		printf("No source nodes\n");
+		return 1;
+	}
+
+	if (geodesics[mn] == NULL)
+		geodesics[mn] = new MeshGeodesic(*mesh);
+
+	double *dist = new double[mesh->getNumVerts()];
+	int ret = march ? geodesics[mn]->march(nodes, dist) :
+		geodesics[mn]->heat(nodes, dist);
+	if (ret && !march) {
+		printf("Heat method failed, using fast marching\n");
+		ret = geodesics[mn]->march(nodes, dist);
+	}
+
+	if (ret == 0) {
+		meshes[mn]->setNField(dist);
+		meshes[mn]->clearFlag(MRF_SHOW_ECOLOR);
+		meshes[mn]->setFlag(MRF_SHOW_NCOLOR);
+	}
+	delete[] dist;
+
+	return ret;
+}
+
+// applies the point field transformation used by drawPointField
+Point3
+ShowMeshWindow::pfTransform(const Point3 &p) const
+{
+	double x = p.getX() * pf_scale.getX();
+	double y = p.getY() * pf_scale.getY();
+	double z = p.getZ() * pf_scale.getZ();
+	double c, s, t;
+
+	c = cos(pf_rot.getX() * M_PI / 180);
+	s = sin(pf_rot.getX() * M_PI / 180);
+	t = y * c - z * s;
+	z = y * s + z * c;
+	y = t;
+
+	c = cos(pf_rot.getY() * M_PI / 180);
+	s = sin(pf_rot.getY() * M_PI / 180);
+	t = x * c + z * s;
+	z = -x * s + z * c;
+	x = t;
+
+	c = cos(pf_rot.getZ() * M_PI / 180);
+	s = sin(pf_rot.getZ() * M_PI / 180);
+	t = x * c - y * s;
+	y = x * s + y * c;
+	x = t;
+
+	return Point3(x, y, z) + pf_off;
+}
+
+// classify dipoles or point field against every class of every mesh
+int
+ShowMeshWindow::check_inside(int dip)
+{
+	vector<Point3> pts;
+	vector<MeshBVH *> layers;
+	vector<int> lmesh, lcls;
+
+	if (dip) {
+		for (unsigned int n = 0; n < m_dip.size(); n++)
+			pts.push_back(m_dip[n].D);
+		const vector<Point3> &dset = m_dset.getPositions();
+		pts.insert(pts.end(), dset.begin(), dset.end());
+	} else {
+		for (unsigned int n = 0; n < pfield.size(); n++)
+			pts.push_back(pfTransform(pfield[n]));
+	}
+
+	if (pts.empty()) {
+		printf("No %s to check\n", dip ? "dipoles" : "points");
+		return 0;
+	}
+
+	for (int n = 0; n < num_meshes; n++) {
+		TriMeshLin *mesh = meshes[n]->getMesh();
+		for (int c = 0; c < mesh->getNumClasses(); c++) {
+			lmesh.push_back(n);
+			lcls.push_back(c);
+		}
+	}
+
+	int nl = lmesh.size();
+	int np = pts.size();
+	if (nl == 0) {
+		printf("No meshes loaded\n");
+		return 1;
+	}
+
+	layers.resize(nl);
+	vector<double> vol(nl);
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int l = 0; l < nl; l++) {
+		layers[l] = new MeshBVH(*meshes[lmesh[l]]->getMesh(), lcls[l]);
+		vol[l] = fabs(layers[l]->volume());
+	}
+
+	vector<char> res(np * nl);
+	for (int l = 0; l < nl; l++)
+		layers[l]->classify(&pts[0], np, &res[l * np]);
+
+	// innermost layer is the smallest enclosing volume
+	vector<int> inner(np, -1), count(nl, 0), icount(nl, 0);
+	int innermost = 0, outside = 0;
+	for (int l = 1; l < nl; l++)
+		if (vol[l] < vol[innermost])
+			innermost = l;
+
+	for (int n = 0; n < np; n++) {
+		for (int l = 0; l < nl; l++) {
+			if (!res[l * np + n])
+				continue;
+			count[l]++;
+			if (inner[n] < 0 || vol[l] < vol[inner[n]])
+				inner[n] = l;
+		}
+		if (inner[n] < 0)
+			outside++;
+		else
+			icount[inner[n]]++;
+	}
+
+	printf("Checking %d %s against %d layers\n",
+	       np, dip ? "dipoles" : "points", nl);
+	for (int l = 0; l < nl; l++)
+		printf(" mesh %d class %d: %d inside, %d innermost\n",
+		       lmesh[l], lcls[l], count[l], icount[l]);
+	printf(" outside all layers: %d\n", outside);
+
+	int bad = np - icount[innermost];
+	if (bad) {
+		printf(" %d not inside mesh %d class %d:", bad,
+		       lmesh[innermost], lcls[innermost]);
+		for (int n = 0, c = 0; n < np && c < 20; n++) {
+			if (inner[n] == innermost)
+				continue;
+			printf(" %d", n);
+			if (++c == 20 && c < bad)
+				printf(" ...");
+		}
+		printf("\n");
+	}
+
+	for (int l = 0; l < nl; l++)
+		delete layers[l];
+
+	return 0;
+}
+
 void
 ShowMeshWindow::glIdle(void)
 {
@@ -1587,12 +2075,19 @@ ShowMeshWindow::glIdle(void)
 		post=1;
 	}
 
+	if (dplay) {
+		int t = m_dset.getFrame() + 1;
+		m_dset.setFrame(t < m_dset.numFrames() ? t : 0);
+		post = 1;
+	}
+
 	post += command_loop(this);
 
    	if(post)
 		redraw();
 
-	if (numiter == 0 && ani == 0 && numcorrect == 0 && command_need_loop() == 0) {
+	if (numiter == 0 && ani == 0 && !dplay && numcorrect == 0 &&
+	    command_need_loop() == 0) {
 #if 0
 		printf("REMOVE IDLE\n");
 #endif
@@ -1623,7 +2118,7 @@ ShowMeshWindow::glInit()
 
 	glClearColor(0, 0, 0.1, 1.0);
 	glResize(w(), h());
-	if (!idle && (ani || numiter || numcorrect || command_need_loop()))
+	if (!idle && (ani || dplay || numiter || numcorrect || command_need_loop()))
 		Fl::add_idle(ShowMeshWindow::glIdleCB, this);
 }
 
@@ -1719,6 +2214,10 @@ ShowMeshWindow::saveEPS(const char *fn, int sel)
 	if (sel)
 		options |= GL2PS_GRAY;
 
+	// gl2ps only sees vertex colors, not the colormap texture
+	for (int n = 0; n < num_meshes; n++)
+		meshes[n]->setFlag(MRF_VCOLOR);
+
 	while (state == GL2PS_OVERFLOW) {
 		buffsize += 1024*1024;
 		gl2psBeginPage ( fn, "ShowMesh",
@@ -1729,6 +2228,9 @@ ShowMeshWindow::saveEPS(const char *fn, int sel)
 		state = gl2psEndPage();
 	}
 
+	for (int n = 0; n < num_meshes; n++)
+		meshes[n]->clearFlag(MRF_VCOLOR);
+
 	text.epsOff();
 
 	fclose(fp);
@@ -1743,7 +2245,7 @@ ShowMeshWindow::draw()
 		// window size is in w() and h().
 		// valid() is turned on by FLTK after draw() returns
 		glInit();
-	} else if (!idle && (ani || numiter || numcorrect || command_need_loop()))
+	} else if (!idle && (ani || dplay || numiter || numcorrect || command_need_loop()))
 		Fl::add_idle(ShowMeshWindow::glIdleCB, this);
 
 	if (update) {
@@ -23,11 +23,17 @@
 #include <FL/Fl_Gl_Window.H>
 #include "meshrender.h"
 #include "glcapture.h"
+#include "glyphset.h"
+#include "dipoleset.h"
 
 #include "gluttext.h"
 
 #define MAX_MESHES 20
 
+class MeshGeodesic;
+class MeshMap;
+class MeshDiffusion;
+
 class DInfo {
 public:
 	DInfo() : Color(1, 1, 1),scale(1),show(false) {}
@@ -60,8 +66,12 @@ public:
 	int save_mesh(const char *fn, int mn, int fc = -1);
 	int load_node_fn(const char *fn, int mn);
 	int load_node_background_fn(const char *fn, int mn);
+	int transfer_node_fn(int ma, int mb, const vector<const char *> &files);
+	int smooth_node_fn(int iter, double lambda, int mn);
 	int set_node_range(double rmin, double rmax, int mn);
 	int set_node_auto(int zero, int mn);
+	int set_colormap(const char *name, int mn);
+	int flip_colormap(int mn);
 	int extract_class(int mn, int fc);
 	int set_background_alpha(double alpha, int mn);
 
@@ -86,7 +96,18 @@ public:
 	int split_mesh(int mn, double thresh);
 	int split_intersecting(int mn);
 	int process_intersecting(int mn, int fix);
-	int process_sharp_edges(int mn, int fix);
+	int process_sharp_edges(int mn, int fix, double kfactor = 0);
+	int check_inside(int dip);
+	int snapshot_mesh(int mn);
+	int mesh_deviation(int m1, int m2 = -1);
+	int decimate_mesh(int mn, int target, int perclass = 0,
+	    double clearance = 0, double curvature = 0);
+	int remesh_mesh(int mn, double len, int iter = 5);
+	int subdivide_mesh(int mn, int levels, int scheme);
+	int mesh_quality(int mn, const char *metric = NULL, int nbins = 10);
+	int mesh_curvature(int mn, const char *field = NULL);
+	int mesh_geodesic(int mn, const vector<unsigned int> &src,
+	    int march = 0);
 
 	int mark_elem(int mn, int idx, bool nbrs);
 	int mark_node(int mn, int idx, bool nbrs);
@@ -191,20 +212,47 @@ public:
 
 	void setDipole(int d, double x, double y, double z,
 		       double px, double py, double pz, bool show = true) {
-		m_dip.resize(d+1);
+		if (d < 0)
+			return;
+		if ((size_t) d >= m_dip.size())
+			m_dip.resize(d+1);
 		m_dip[d].D.setCoord(x - m_mx, y - m_my, z - m_mz);
 		m_dip[d].J.setCoord(px, py, pz);
 		m_dip[d].show = show;
+		m_dip_valid = false;
 	}
 	void setDipoleColor(int d, double x, double y, double z) {
-		if (d < 0 || d >= m_dip.size())
+		if (d < 0 || (size_t) d >= m_dip.size())
 		    return;
 		m_dip[d].Color.setCoord(x, y, z);
+		m_dip_valid = false;
 	}
 	void setDipoleScale(int d, double s) {
-		if (d < 0 || d >= m_dip.size())
+		if (d < 0 || (size_t) d >= m_dip.size())
 			return;
 		m_dip[d].scale = s;
+		m_dip_valid = false;
+	}
+
+	int loadDipoleSet(const char *fn) {
+		dplay = false;
+		return m_dset.load(fn, getMeshOffset());
+	}
+	void clearDipoleSet(void) {
+		dplay = false;
+		m_dset.clear();
+	}
+	int setDipoleFrame(int t) {
+		if (t < 0 || t >= m_dset.numFrames())
+			return 1;
+		m_dset.setFrame(t);
+		return 0;
+	}
+	void setDipoleSetScale(double s) {
+		m_dset.setScale(s);
+	}
+	void playDipoleSet(bool play) {
+		dplay = play && m_dset.numFrames() > 1;
 	}
 
 	void setPOffset(double x, double y, double z) {
@@ -216,15 +264,16 @@ public:
 	void setPScale(double x, double y, double z) {
 		pf_scale.setCoord(x, y, z);
 	}
+	void setPStyle(int mode) {
+		pf_glyphs.setMode(mode);
+	}
 
 	void setClip(double x0, double y0, double z0,
 		     double x1, double y1, double z1);
 	void setClip(bool on);
 
 
-	void drawArrow(Point3 dc, Point3 dn, double s);
-	void drawDipole(const DInfo &dip);
-	void drawNode(const Point3 &nd, double s = 1);
+	void drawDipoles(void);
 	int drawPointField(void);
 	void drawAxis(void);
 	int loadPointField(const char *fname);
@@ -254,14 +303,19 @@ private:
 		((ShowMeshWindow *)obj)->glIdle();
 	}
 
+	Point3 pfTransform(const Point3 &p) const;
+	void pfUpdate(void);
+
 	double *loadPotFile(TriMeshLin *msh, FILE *f);
 	double * loadFSCurvFile(TriMeshLin *msh, FILE *f);
 	double * loadFSWFile(TriMeshLin *msh, FILE *f);
+	double *loadNodeField(TriMeshLin *msh, const char *fn);
 
 	Point3 eye;
 	Point3 rot;
 	bool idle;
 	bool ani;	// animate?
+	bool dplay;	// step through the dipole set frames?
 	bool capture;	// capture
 	bool filter;
 	bool glcull;	// gl culling?
@@ -281,6 +335,10 @@ private:
 	GLfloat     m_light_pos[4];
 
 	MeshRender *meshes[MAX_MESHES];
+	TriMeshLin *snapshots[MAX_MESHES];
+	MeshGeodesic *geodesics[MAX_MESHES];
+	MeshMap *nodemaps[MAX_MESHES];	// node field maps onto each mesh
+	MeshDiffusion *diffusions[MAX_MESHES];	// node field smoothing
 
 	int num_meshes;
 	int numiter;
@@ -292,6 +350,9 @@ private:
 
 	int num_pf;
 	vector<Point3> pfield;
+	vector<GLubyte> pf_color;	// RGBA8 per point, if loaded
+	vector<float> pf_size;		// relative size per point, if loaded
+	GlyphSet pf_glyphs;
 	Point3 pf_off, pf_rot, pf_scale;
 
 	double m_delsc;
@@ -303,6 +364,10 @@ private:
 	int m_x, m_y, m_btn;
 
 	vector<DInfo> m_dip;
+	GlyphSet m_dnodes, m_darrows;
+	bool m_dip_valid;	// the glyphs are up to date with m_dip
+
+	DipoleSet m_dset;
 };
 
 #endif
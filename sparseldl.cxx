@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2014 Can Erkin Acar
+ * Copyright (C) 2014 Zeynep Akalin Acar
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include <algorithm>
+#include "sparseldl.h"
+
+#define ND_LEAF		64	// parts are not split below this size
+
+//---------------------------------------------------------------------------
+void
+SparseLDL::clear(void)
+{
+	m_n = 0;
+	m_perm.clear();
+	m_iperm.clear();
+	m_lp.clear();
+	m_li.clear();
+	m_lx.clear();
+	m_d.clear();
+}
+//---------------------------------------------------------------------------
+int
+SparseLDL::factor(int n, const vector<unsigned int> &start,
+		  const vector<unsigned int> &col, const vector<double> &val,
+		  const vector<int> &perm)
+{
+	vector<int> parent(n), flag(n), lnz(n), pattern(n);
+	vector<double> y(n, 0.0);
+
+	clear();
+	m_n = n;
+	m_perm = perm;
+	m_iperm.resize(n);
+	for (int k = 0; k < n; k++)
+		m_iperm[perm[k]] = k;
+
+	// elimination tree and column counts
+	for (int k = 0; k < n; k++) {
+		int r = perm[k];
+
+		parent[k] = -1;
+		flag[k] = k;
+		lnz[k] = 0;
+		for (unsigned int p = start[r]; p < start[r + 1]; p++) {
+			int i = m_iperm[col[p]];
+			if (i >= k)
+				continue;
+			for (; flag[i] != k; i = parent[i]) {
+				if (parent[i] == -1)
+					parent[i] = k;
+				lnz[i]++;
+				flag[i] = k;
+			}
+		}
+	}
+
+	m_lp.resize(n + 1);
+	m_lp[0] = 0;
+	for (int k = 0; k < n; k++)
+		m_lp[k + 1] = m_lp[k] + lnz[k];
+	m_li.resize(m_lp[n]);
+	m_lx.resize(m_lp[n]);
+	m_d.resize(n);
+
+	// row k of L from a sparse triangular solve with the pattern
+	// given by the elimination tree
+	for (int k = 0; k < n; k++) {
+		int r = perm[k], top = n;
+
+		flag[k] = k;
+		lnz[k] = 0;
+		for (unsigned int p = start[r]; p < start[r + 1]; p++) {
+			int i = m_iperm[col[p]];
+			if (i > k)
+				continue;
+			y[i] += val[p];
+			int len = 0;
+			for (; flag[i] != k; i = parent[i]) {
+				pattern[len++] = i;
+				flag[i] = k;
+			}
+			while (len > 0)
+				pattern[--top] = pattern[--len];
+		}
+
+		double d = y[k];
+		y[k] = 0;
+		for (; top < n; top++) {
+			int i = pattern[top];
+			double yi = y[i];
+			size_t p, p2 = m_lp[i] + lnz[i];
+
+			y[i] = 0;
+			for (p = m_lp[i]; p < p2; p++)
+				y[m_li[p]] -= m_lx[p] * yi;
+			double l = yi / m_d[i];
+			d -= l * yi;
+			m_li[p] = k;
+			m_lx[p] = l;
+			lnz[i]++;
+		}
+
+		if (d == 0) {
+			clear();
+			return k + 1;
+		}
+		m_d[k] = d;
+	}
+
+	return 0;
+}
+//---------------------------------------------------------------------------
+void
+SparseLDL::solve(double *x) const
+{
+	vector<double> y(m_n);
+
+	for (int k = 0; k < m_n; k++)
+		y[k] = x[m_perm[k]];
+
+	for (int j = 0; j < m_n; j++) {
+		double yj = y[j];
+		for (size_t p = m_lp[j]; p < m_lp[j + 1]; p++)
+			y[m_li[p]] -= m_lx[p] * yj;
+	}
+	for (int j = 0; j < m_n; j++)
+		y[j] /= m_d[j];
+	for (int j = m_n - 1; j >= 0; j--) {
+		double yj = y[j];
+		for (size_t p = m_lp[j]; p < m_lp[j + 1]; p++)
+			yj -= m_lx[p] * y[m_li[p]];
+		y[j] = yj;
+	}
+
+	for (int k = 0; k < m_n; k++)
+		x[m_perm[k]] = y[k];
+}
+//---------------------------------------------------------------------------
+// the parts are kept as ranges of nodes, split into the two halves
+// followed by the separator, so the final node array is the order
+void
+SparseLDL::orderNested(int n, const double *xyz,
+		       const vector<unsigned int> &start,
+		       const vector<unsigned int> &col, vector<int> &perm)
+{
+	vector<int> mark(n, -1);
+	vector<pair<int, int> > stack;	// start and size of the parts
+	vector<pair<double, int> > key;
+	int stamp = 0;
+
+	perm.resize(n);
+	for (int v = 0; v < n; v++)
+		perm[v] = v;
+	stack.push_back(make_pair(0, n));
+
+	while (stack.size()) {
+		int lo = stack.back().first, cnt = stack.back().second;
+		stack.pop_back();
+		if (cnt <= ND_LEAF)
+			continue;
+
+		double min[3], max[3];
+		for (int k = 0; k < 3; k++)
+			min[k] = max[k] = xyz[3 * perm[lo] + k];
+		for (int i = lo + 1; i < lo + cnt; i++) {
+			const double *p = &xyz[3 * perm[i]];
+			for (int k = 0; k < 3; k++) {
+				if (p[k] < min[k])
+					min[k] = p[k];
+				if (p[k] > max[k])
+					max[k] = p[k];
+			}
+		}
+		int ax = 0;
+		for (int k = 1; k < 3; k++)
+			if (max[k] - min[k] > max[ax] - min[ax])
+				ax = k;
+
+		key.resize(cnt);
+		for (int i = 0; i < cnt; i++)
+			key[i] = make_pair(xyz[3 * perm[lo + i] + ax],
+					   perm[lo + i]);
+		int half = cnt / 2;
+		nth_element(key.begin(), key.begin() + half, key.end());
+
+		// the lower half is marked, upper half nodes next to it
+		// are the separator
+		int sa = stamp++, ss = stamp++;
+		for (int i = 0; i < half; i++)
+			mark[key[i].second] = sa;
+		int nsep = 0;
+		for (int i = half; i < cnt; i++) {
+			int v = key[i].second;
+			for (unsigned int p = start[v]; p < start[v + 1]; p++) {
+				if (mark[col[p]] == sa) {
+					mark[v] = ss;
+					nsep++;
+					break;
+				}
+			}
+		}
+
+		int na = 0, nb = half, ns = cnt - nsep;
+		for (int i = 0; i < cnt; i++) {
+			int v = key[i].second;
+			if (mark[v] == sa)
+				perm[lo + na++] = v;
+			else if (mark[v] == ss)
+				perm[lo + ns++] = v;
+			else
+				perm[lo + nb++] = v;
+		}
+
+		stack.push_back(make_pair(lo, half));
+		stack.push_back(make_pair(lo + half, cnt - half - nsep));
+	}
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2014 Can Erkin Acar
+ * Copyright (C) 2014 Zeynep Akalin Acar
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef _SPARSELDL_H_
+#define _SPARSELDL_H_
+
+#include <vector>
+
+using namespace std;
+
+// LDL' factorization of a sparse symmetric positive (semi)definite
+// matrix, up-looking along the elimination tree (after T. Davis' LDL).
+// The matrix is given in compressed rows with both triangles stored,
+// row r in col/val[start[r] .. start[r+1]], and is factored in the
+// order of a fill reducing permutation: perm[k] is the row eliminated
+// k-th. Once factored, each solve is a pair of triangular sweeps.
+class SparseLDL {
+public:
+	SparseLDL(void) : m_n(0) {};
+	~SparseLDL(void) {};
+
+	// returns 0 on success, k + 1 if the k-th pivot is zero
+	int factor(int n, const vector<unsigned int> &start,
+		   const vector<unsigned int> &col, const vector<double> &val,
+		   const vector<int> &perm);
+	// solves in place, x has n values
+	void solve(double *x) const;
+	void clear(void);
+
+	inline int size(void) const
+		{ return m_n; }
+	inline size_t nonzeros(void) const
+		{ return m_lx.size(); }
+
+	// nested dissection order of a graph embedded in 3D (xyz has 3
+	// coordinates per node): each part is split at the median of its
+	// longest extent and the nodes adjacent to the other side are
+	// eliminated last.
+	static void orderNested(int n, const double *xyz,
+				const vector<unsigned int> &start,
+				const vector<unsigned int> &col,
+				vector<int> &perm);
+
+protected:
+	int m_n;
+	vector<int> m_perm;		// row eliminated k-th
+	vector<int> m_iperm;		// elimination step of a row
+	vector<size_t> m_lp;		// column k of L is
+	vector<int> m_li;		// m_li/m_lx[m_lp[k] .. m_lp[k+1]]
+	vector<double> m_lx;
+	vector<double> m_d;
+};
+
+#endif